@@ -0,0 +1,51 @@
+#include "Audio.h"
+
+#include <algorithm>
+#include <bit>
+
+AudioRing::AudioRing(size_t maxBuffered)
+	: mMaxBuffered(maxBuffered)
+{
+	const size_t size = std::bit_ceil(maxBuffered < 2 ? size_t(2) : maxBuffered);
+	mSamples.resize(size);
+	mMask = size - 1;
+}
+
+size_t AudioRing::Push(const int16_t* samples, size_t count)
+{
+	const uint64_t head = mHead.load(std::memory_order_relaxed);
+	const size_t buffered = static_cast<size_t>(head - mTail.load(std::memory_order_acquire));
+	const size_t room = buffered < mMaxBuffered ? mMaxBuffered - buffered : 0;
+	const size_t pushed = std::min(count, room);
+	if (pushed < count)
+	{
+		mOverruns.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	for (size_t i = 0; i < pushed; ++i)
+	{
+		mSamples[(head + i) & mMask] = samples[i];
+	}
+
+	mHead.store(head + pushed, std::memory_order_release);
+	return pushed;
+}
+
+void AudioRing::Pop(int16_t* samples, size_t count)
+{
+	const uint64_t tail = mTail.load(std::memory_order_relaxed);
+	const uint64_t available = mHead.load(std::memory_order_acquire) - tail;
+	const size_t popped = available < count ? static_cast<size_t>(available) : count;
+	if (popped < count)
+	{
+		mUnderruns.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	for (size_t i = 0; i < popped; ++i)
+	{
+		samples[i] = mSamples[(tail + i) & mMask];
+	}
+	std::fill(samples + popped, samples + count, int16_t(0));
+
+	mTail.store(tail + popped, std::memory_order_release);
+}
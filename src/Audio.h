@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Rate the core renders the beeper at, mono signed 16-bit samples
+constexpr uint32_t gAudioSampleRate = 48000;
+// Most audio the ring holds on top of the frame being pushed, which bounds how late a beep can start
+constexpr uint32_t gAudioLatencyMilliseconds = 10;
+
+// Single producer, single consumer ring of samples between the emulation loop and the audio device. Neither side
+// ever blocks or takes a lock: the producer drops what doesn't fit and the consumer plays silence for what isn't
+// there yet, and both are counted.
+class AudioRing {
+public:
+	// Push() never lets the ring hold more than maxBuffered samples. The storage is rounded up to a power of two.
+	explicit AudioRing(size_t maxBuffered);
+
+	// Called by the producer, returns how many samples fit
+	size_t Push(const int16_t* samples, size_t count);
+	// Called by the consumer. Always fills all count samples, padding with silence once the ring runs dry.
+	void Pop(int16_t* samples, size_t count);
+
+	inline size_t GetBuffered() const { return static_cast<size_t>(mHead.load(std::memory_order_acquire) - mTail.load(std::memory_order_acquire)); }
+	// Pop() calls that ran out of samples, e.g. while the emulator is paused or falling behind
+	inline uint64_t GetUnderruns() const { return mUnderruns.load(std::memory_order_relaxed); }
+	// Push() calls that had to drop samples, e.g. in turbo or while the device isn't playing
+	inline uint64_t GetOverruns() const { return mOverruns.load(std::memory_order_relaxed); }
+
+private:
+	std::vector<int16_t> mSamples;
+	size_t mMask = 0;
+	size_t mMaxBuffered = 0;
+
+	// Each index lives on its own cache line so the producer and consumer don't keep stealing it from each other
+	alignas(64) std::atomic<uint64_t> mHead = 0;	// Next sample to write, only the producer stores it
+	alignas(64) std::atomic<uint64_t> mTail = 0;	// Next sample to read, only the consumer stores it
+	alignas(64) std::atomic<uint64_t> mUnderruns = 0;
+	std::atomic<uint64_t> mOverruns = 0;
+};
@@ -0,0 +1,59 @@
+#include "AudioDevice.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+namespace {
+
+	// Device period requested from SDL, small enough that it adds about 5 ms on top of the ring
+	constexpr const char* gDeviceSampleFrames = "256";
+}
+
+bool AudioDevice::Startup(AudioRing& ring)
+{
+	SDL_SetHint(SDL_HINT_AUDIO_DEVICE_SAMPLE_FRAMES, gDeviceSampleFrames);
+	if (!SDL_InitSubSystem(SDL_INIT_AUDIO))
+	{
+		return false;
+	}
+
+	const SDL_AudioSpec spec = { SDL_AUDIO_S16, 1, static_cast<int>(gAudioSampleRate) };
+	mRing = &ring;
+	mStream = SDL_OpenAudioDeviceStream(SDL_AUDIO_DEVICE_DEFAULT_PLAYBACK, &spec, &AudioDevice::Feed, this);
+	if (mStream == nullptr)
+	{
+		SDL_QuitSubSystem(SDL_INIT_AUDIO);
+		return false;
+	}
+
+	// Streams opened this way start paused
+	SDL_ResumeAudioStreamDevice(mStream);
+	return true;
+}
+
+void AudioDevice::Shutdown()
+{
+	if (mStream == nullptr)
+	{
+		return;
+	}
+
+	SDL_DestroyAudioStream(mStream);
+	SDL_QuitSubSystem(SDL_INIT_AUDIO);
+	mStream = nullptr;
+}
+
+void AudioDevice::Feed(void* userdata, SDL_AudioStream* stream, int additionalAmount, int /*totalAmount*/)
+{
+	// Runs on SDL's audio thread. Only what the device asked for is handed over, so nothing queues up inside SDL.
+	AudioDevice* device = static_cast<AudioDevice*>(userdata);
+	std::array<int16_t, 512> samples;
+	for (size_t remaining = additionalAmount / sizeof(int16_t); remaining > 0;)
+	{
+		const size_t count = std::min(remaining, samples.size());
+		device->mRing->Pop(samples.data(), count);
+		SDL_PutAudioStreamData(stream, samples.data(), static_cast<int>(count * sizeof(int16_t)));
+		remaining -= count;
+	}
+}
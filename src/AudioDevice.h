@@ -0,0 +1,21 @@
+#pragma once
+
+#include <SDL3/SDL.h>
+
+#include "Audio.h"
+
+// Plays an AudioRing on the default SDL playback device. SDL calls back on its own audio thread whenever the device
+// needs more, and the callback only ever pops from the ring, so the emulation loop never waits on it.
+// Works with any SDL audio driver, SDL_AUDIO_DRIVER=dummy included.
+class AudioDevice {
+public:
+	// False, leaving the emulator silent, if no playback device could be opened
+	bool Startup(AudioRing& ring);
+	void Shutdown();
+
+private:
+	static void Feed(void* userdata, SDL_AudioStream* stream, int additionalAmount, int totalAmount);
+
+	SDL_AudioStream* mStream = nullptr;
+	AudioRing* mRing = nullptr;
+};
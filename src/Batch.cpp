@@ -0,0 +1,196 @@
+#include "BatchRunner.h"
+#include "RomLibrary.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+// Runs a list of ROM jobs across every core and reports per-job and aggregate throughput with final framebuffer hashes
+
+namespace {
+
+	constexpr uint64_t gDefaultLibraryCycles = 1000000;
+
+	void PrintUsage()
+	{
+		std::fprintf(stderr,
+			"usage: chip8-batch <jobs> [--threads N] [--engine hashmap|switch|predecoded|jit] [--quirks vip|chip48|schip|xochip] [--seed N]\n"
+			"       chip8-batch --library INDEX [--cycles N] [--threads N] [--engine hashmap|switch|predecoded|jit] [--seed N]\n"
+			"  jobs       text file with one \"ROM CYCLES [INPUT_SCRIPT]\" line per job, # starts a comment\n"
+			"  --library  run every ROM in a chip8-library index instead, each with its own speed and quirks\n"
+			"  --cycles   instructions each library ROM runs for (default %llu)\n"
+			"  --threads  worker threads (default one per hardware thread)\n"
+			"  --engine   interpreter core every job uses (default predecoded)\n"
+			"  --quirks   interpreter every job's ROM was written for (default vip)\n"
+			"  --seed     make the run repeatable, each job's CXNN gets its own stream derived from N (hex)\n",
+			static_cast<unsigned long long>(gDefaultLibraryCycles));
+	}
+
+	bool LoadJobs(const char* path, ExecutionEngine engine, QuirkProfile quirks, std::vector<BatchJob>& jobs)
+	{
+		std::ifstream file(path);
+		if (!file)
+		{
+			std::fprintf(stderr, "chip8-batch: can't open %s\n", path);
+			return false;
+		}
+
+		std::string line;
+		for (int lineNumber = 1; std::getline(file, line); ++lineNumber)
+		{
+			if (line.empty() || line[0] == '#')
+			{
+				continue;
+			}
+
+			std::istringstream fields(line);
+			BatchJob job;
+			job.engine = engine;
+			job.quirks = quirks;
+			if (!(fields >> job.romPath >> job.cycleBudget))
+			{
+				std::fprintf(stderr, "chip8-batch: %s:%d: expected \"ROM CYCLES [INPUT_SCRIPT]\"\n", path, lineNumber);
+				return false;
+			}
+			fields >> job.inputScriptPath;
+			jobs.push_back(job);
+		}
+
+		return true;
+	}
+
+	bool LoadLibraryJobs(const char* path, uint64_t cycleBudget, ExecutionEngine engine, std::vector<BatchJob>& jobs)
+	{
+		const RomLibrary library(path);
+		if (!library.IsValid())
+		{
+			std::fprintf(stderr, "chip8-batch: %s isn't a ROM index from this version\n", path);
+			return false;
+		}
+
+		for (size_t i = 0; i < library.GetCount(); ++i)
+		{
+			const RomIndexEntry& entry = library.GetEntry(i);
+			const RomSettings settings = RomLibrary::GetSettings(entry);
+			BatchJob job;
+			job.romPath = library.GetPath(entry);
+			job.cycleBudget = cycleBudget;
+			job.cyclesPerSecond = settings.cyclesPerSecond;
+			job.engine = engine;
+			job.quirks = settings.quirks;
+			jobs.push_back(job);
+		}
+
+		return true;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const char* jobsPath = nullptr;
+	const char* libraryPath = nullptr;
+	uint64_t libraryCycles = gDefaultLibraryCycles;
+	unsigned threads = 0;
+	ExecutionEngine engine = ExecutionEngine::Predecoded;
+	QuirkProfile quirks = QuirkProfile::CosmacVip;
+	bool hasRandomSeed = false;
+	uint64_t randomSeed = 0;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const bool hasValue = i + 1 < argc;
+		if (std::strcmp(argv[i], "--threads") == 0 && hasValue)
+		{
+			threads = static_cast<unsigned>(std::strtoul(argv[++i], nullptr, 10));
+		}
+		else if (std::strcmp(argv[i], "--seed") == 0 && hasValue)
+		{
+			randomSeed = std::strtoull(argv[++i], nullptr, 16);
+			hasRandomSeed = true;
+		}
+		else if (std::strcmp(argv[i], "--library") == 0 && hasValue)
+		{
+			libraryPath = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--cycles") == 0 && hasValue)
+		{
+			libraryCycles = std::strtoull(argv[++i], nullptr, 10);
+		}
+		else if (std::strcmp(argv[i], "--engine") == 0 && hasValue)
+		{
+			if (!ParseExecutionEngine(argv[++i], engine))
+			{
+				PrintUsage();
+				return 1;
+			}
+		}
+		else if (std::strcmp(argv[i], "--quirks") == 0 && hasValue)
+		{
+			if (!ParseQuirkProfile(argv[++i], quirks))
+			{
+				PrintUsage();
+				return 1;
+			}
+		}
+		else if (argv[i][0] != '-' && jobsPath == nullptr)
+		{
+			jobsPath = argv[i];
+		}
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	std::vector<BatchJob> jobs;
+	if ((jobsPath == nullptr) == (libraryPath == nullptr))
+	{
+		PrintUsage();
+		return 1;
+	}
+	if (jobsPath != nullptr ? !LoadJobs(jobsPath, engine, quirks, jobs) : !LoadLibraryJobs(libraryPath, libraryCycles, engine, jobs))
+	{
+		return 1;
+	}
+
+	// Seeds depend only on the job's position, not on which thread runs it or when
+	for (size_t i = 0; i < jobs.size() && hasRandomSeed; ++i)
+	{
+		jobs[i].hasRandomSeed = true;
+		jobs[i].randomSeed = GetStreamSeed(randomSeed, i);
+	}
+
+	BatchRunner runner(threads);
+	const std::vector<BatchResult> results = runner.Run(jobs);
+
+	uint64_t totalInstructions = 0;
+	int failed = 0;
+	std::printf("%-40s %14s %16s %18s %6s\n", "rom", "instructions", "instructions/sec", "framebuffer hash", "thread");
+	for (size_t i = 0; i < jobs.size(); ++i)
+	{
+		const BatchResult& result = results[i];
+		if (!result.succeeded)
+		{
+			std::printf("%-40s failed to load\n", jobs[i].romPath.c_str());
+			++failed;
+			continue;
+		}
+
+		totalInstructions += result.instructions;
+		std::printf("%-40s %14llu %16.0f   %016llx %6u\n", jobs[i].romPath.c_str(),
+			static_cast<unsigned long long>(result.instructions), result.GetInstructionsPerSecond(),
+			static_cast<unsigned long long>(result.framebufferHash), result.worker);
+	}
+
+	const double seconds = runner.GetLastRunSeconds();
+	std::printf("jobs: %zu (%d failed) on %u threads\n", jobs.size(), failed, runner.GetThreadCount());
+	std::printf("instructions: %llu\n", static_cast<unsigned long long>(totalInstructions));
+	std::printf("seconds: %.3f\n", seconds);
+	std::printf("instructions/sec: %.0f\n", seconds > 0 ? totalInstructions / seconds : 0.0);
+
+	return failed > 0 ? 1 : 0;
+}
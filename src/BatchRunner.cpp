@@ -0,0 +1,210 @@
+#include "BatchRunner.h"
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <thread>
+
+namespace {
+
+	constexpr size_t gCacheLineSize = 64;
+
+	struct KeyEvent
+	{
+		uint64_t frame = 0;
+		uint8_t key = 0;
+		bool pressed = false;
+	};
+
+	// Every instance starts on its own cache lines and is padded out to a whole number of them, so two threads
+	// stepping neighbouring instances never write to the same line
+	struct alignas(gCacheLineSize) IsolatedChip
+	{
+		CHIP chip;
+	};
+
+	// Result slots are written once per job by whichever thread ran it, padded for the same reason
+	struct alignas(gCacheLineSize) ResultSlot
+	{
+		BatchResult result;
+	};
+
+	// The owning thread takes from the back, thieves take from the front, so they only meet on the last job.
+	// Jobs are whole ROM runs, so a mutex per queue is nowhere near contended.
+	struct alignas(gCacheLineSize) WorkQueue
+	{
+		std::optional<size_t> PopBack()
+		{
+			std::lock_guard lock(mutex);
+			if (jobs.empty())
+			{
+				return std::nullopt;
+			}
+			const size_t job = jobs.back();
+			jobs.pop_back();
+			return job;
+		}
+
+		std::optional<size_t> StealFront()
+		{
+			std::lock_guard lock(mutex);
+			if (jobs.empty())
+			{
+				return std::nullopt;
+			}
+			const size_t job = jobs.front();
+			jobs.pop_front();
+			return job;
+		}
+
+		std::mutex mutex;
+		std::deque<size_t> jobs;
+	};
+
+	bool LoadInputScript(const std::string& path, std::vector<KeyEvent>& events)
+	{
+		std::ifstream script(path);
+		if (!script)
+		{
+			return false;
+		}
+
+		std::string line;
+		while (std::getline(script, line))
+		{
+			if (line.empty() || line[0] == '#')
+			{
+				continue;
+			}
+
+			std::istringstream fields(line);
+			KeyEvent event;
+			unsigned key = 0;
+			int pressed = 0;
+			if (!(fields >> event.frame >> std::hex >> key >> std::dec >> pressed) || key > 0xF)
+			{
+				return false;
+			}
+			event.key = static_cast<uint8_t>(key);
+			event.pressed = pressed != 0;
+			events.push_back(event);
+		}
+
+		std::stable_sort(events.begin(), events.end(), [](const KeyEvent& a, const KeyEvent& b) { return a.frame < b.frame; });
+		return true;
+	}
+
+	BatchResult RunJob(const BatchJob& job)
+	{
+		BatchResult result;
+
+		std::vector<KeyEvent> events;
+		if (!job.inputScriptPath.empty() && !LoadInputScript(job.inputScriptPath, events))
+		{
+			return result;
+		}
+
+		std::unique_ptr<IsolatedChip> instance = std::make_unique<IsolatedChip>();
+		CHIP& chip = instance->chip;
+		chip.SetExecutionEngine(job.engine);
+		if (job.hasRandomSeed)
+		{
+			chip.SetRandomSeed(job.randomSeed);
+		}
+		if (!chip.LoadROM(job.romPath.c_str(), job.cyclesPerSecond, job.quirks))
+		{
+			return result;
+		}
+#ifdef DEBUG
+		chip.SetPaused(false);
+#endif
+
+		using Clock = std::chrono::steady_clock;
+		const Clock::time_point start = Clock::now();
+
+		bool* keypad = chip.GetKeypad();
+		size_t nextEvent = 0;
+		while (chip.GetCycleCount() < job.cycleBudget)
+		{
+			for (; nextEvent < events.size() && events[nextEvent].frame <= chip.GetFrameCount(); ++nextEvent)
+			{
+				keypad[events[nextEvent].key] = events[nextEvent].pressed;
+			}
+			chip.RunFrame();
+		}
+
+		result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+		result.succeeded = true;
+		result.instructions = chip.GetCycleCount();
+		result.frames = chip.GetFrameCount();
+		result.framebufferHash = chip.GetDisplayHash();
+		return result;
+	}
+}
+
+BatchRunner::BatchRunner(unsigned threadCount)
+	: mThreadCount(threadCount > 0 ? threadCount : std::max(1u, std::thread::hardware_concurrency()))
+{
+}
+
+std::vector<BatchResult> BatchRunner::Run(const std::vector<BatchJob>& jobs)
+{
+	const unsigned threadCount = static_cast<unsigned>(std::min<size_t>(mThreadCount, std::max<size_t>(jobs.size(), 1)));
+
+	std::unique_ptr<WorkQueue[]> queues = std::make_unique<WorkQueue[]>(threadCount);
+	for (size_t i = 0; i < jobs.size(); ++i)
+	{
+		queues[i % threadCount].jobs.push_back(i);
+	}
+
+	std::unique_ptr<ResultSlot[]> slots = std::make_unique<ResultSlot[]>(jobs.size());
+
+	auto worker = [&](unsigned self)
+	{
+		while (true)
+		{
+			std::optional<size_t> job = queues[self].PopBack();
+			for (unsigned offset = 1; !job && offset < threadCount; ++offset)
+			{
+				job = queues[(self + offset) % threadCount].StealFront();
+			}
+
+			// Nothing is ever queued after the start, so once every queue is empty the batch is done
+			if (!job)
+			{
+				return;
+			}
+
+			slots[*job].result = RunJob(jobs[*job]);
+			slots[*job].result.worker = self;
+		}
+	};
+
+	using Clock = std::chrono::steady_clock;
+	const Clock::time_point start = Clock::now();
+
+	std::vector<std::thread> threads;
+	threads.reserve(threadCount);
+	for (unsigned i = 0; i < threadCount; ++i)
+	{
+		threads.emplace_back(worker, i);
+	}
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+
+	mLastRunSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+	std::vector<BatchResult> results(jobs.size());
+	for (size_t i = 0; i < jobs.size(); ++i)
+	{
+		results[i] = slots[i].result;
+	}
+	return results;
+}
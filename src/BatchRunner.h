@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Chip8.h"
+
+// One ROM run in a batch
+struct BatchJob
+{
+	std::string romPath;
+	// Optional keypad script, one "FRAME KEY STATE" line per change (e.g. "120 5 1" presses key 5 before frame 120)
+	std::string inputScriptPath;
+	uint64_t cycleBudget = 0;
+	uint16_t cyclesPerSecond = 700;
+	ExecutionEngine engine = ExecutionEngine::Predecoded;
+	QuirkProfile quirks = QuirkProfile::CosmacVip;
+	bool hasRandomSeed = false;		// Otherwise CXNN is seeded randomly
+	uint64_t randomSeed = 0;
+};
+
+struct BatchResult
+{
+	bool succeeded = false;			// False when the ROM or input script couldn't be loaded
+	uint64_t instructions = 0;
+	uint64_t frames = 0;
+	double seconds = 0;
+	uint64_t framebufferHash = 0;
+	unsigned worker = 0;			// Thread the job ran on, to see how the stealing balanced out
+
+	inline double GetInstructionsPerSecond() const { return seconds > 0 ? instructions / seconds : 0.0; }
+};
+
+// Runs independent CHIP instances across a pool of threads at full host speed.
+// Jobs are dealt out round-robin to per-thread queues; a thread that runs dry steals from the front of another's.
+class BatchRunner {
+public:
+	// 0 threads means one per hardware thread
+	explicit BatchRunner(unsigned threadCount = 0);
+
+	// Blocks until every job has finished, results are in the same order as jobs
+	std::vector<BatchResult> Run(const std::vector<BatchJob>& jobs);
+
+	// Wall-clock time of the last Run(), for the aggregate instructions/sec
+	inline double GetLastRunSeconds() const { return mLastRunSeconds; }
+	inline unsigned GetThreadCount() const { return mThreadCount; }
+
+private:
+	unsigned mThreadCount = 1;
+	double mLastRunSeconds = 0;
+};
@@ -0,0 +1,447 @@
+#include "Chip8.h"
+#include "Phosphor.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Microbenchmarks for the interpreter's hot paths, printed as a table, CSV or JSON so results can be tracked across releases
+
+namespace {
+
+	enum class Format
+	{
+		Text,
+		Csv,
+		Json,
+	};
+
+	struct Options
+	{
+		Format format = Format::Text;
+		const char* romDirectory = "roms";
+		const char* filter = nullptr;	// Only run benchmarks whose group/name contains this
+		double minSeconds = 0.1;		// Each repetition runs at least this long
+		int repetitions = 5;			// The median repetition is reported
+	};
+
+	struct Result
+	{
+		std::string group;
+		std::string name;
+		uint64_t operations = 0;	// Per repetition
+		double seconds = 0;			// Median repetition
+
+		inline double GetNanosecondsPerOperation() const { return operations > 0 ? seconds * 1e9 / operations : 0.0; }
+		inline double GetOperationsPerSecond() const { return seconds > 0 ? operations / seconds : 0.0; }
+	};
+
+	// Runs count operations and returns how many actually ran, which can be fewer for whole-ROM runs
+	using Body = std::function<uint64_t(uint64_t count)>;
+
+	// Anything written here can't be optimised away
+	volatile uint64_t gSink = 0;
+
+	void PrintUsage()
+	{
+		std::fprintf(stderr,
+			"usage: chip8-bench [--format text|csv|json] [--roms DIR] [--filter TEXT] [--min-time S] [--repetitions N]\n"
+			"  --format       output format (default text)\n"
+			"  --roms         directory whose .ch8 files get whole-ROM runs (default roms)\n"
+			"  --filter       only run benchmarks whose \"group/name\" contains TEXT\n"
+			"  --min-time     seconds each repetition runs for at least (default 0.1)\n"
+			"  --repetitions  repetitions per benchmark, the median is reported (default 5)\n");
+	}
+
+	bool ParseOptions(int argc, char** argv, Options& options)
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			const char* arg = argv[i];
+			const bool hasValue = i + 1 < argc;
+
+			if (std::strcmp(arg, "--format") == 0 && hasValue)
+			{
+				const char* format = argv[++i];
+				if (std::strcmp(format, "text") == 0) { options.format = Format::Text; }
+				else if (std::strcmp(format, "csv") == 0) { options.format = Format::Csv; }
+				else if (std::strcmp(format, "json") == 0) { options.format = Format::Json; }
+				else { return false; }
+			}
+			else if (std::strcmp(arg, "--roms") == 0 && hasValue)
+			{
+				options.romDirectory = argv[++i];
+			}
+			else if (std::strcmp(arg, "--filter") == 0 && hasValue)
+			{
+				options.filter = argv[++i];
+			}
+			else if (std::strcmp(arg, "--min-time") == 0 && hasValue)
+			{
+				options.minSeconds = std::strtod(argv[++i], nullptr);
+			}
+			else if (std::strcmp(arg, "--repetitions") == 0 && hasValue)
+			{
+				options.repetitions = std::max(1, std::atoi(argv[++i]));
+			}
+			else
+			{
+				return false;
+			}
+		}
+
+		return options.minSeconds > 0;
+	}
+
+	class Bench {
+	public:
+		explicit Bench(const Options& options) : mOptions(options) {}
+
+		void Run(const std::string& group, const std::string& name, const Body& body)
+		{
+			if (mOptions.filter != nullptr && (group + "/" + name).find(mOptions.filter) == std::string::npos)
+			{
+				return;
+			}
+
+			using Clock = std::chrono::steady_clock;
+			const auto time = [&](uint64_t count, uint64_t& ran) {
+				const Clock::time_point start = Clock::now();
+				ran = body(count);
+				return std::chrono::duration<double>(Clock::now() - start).count();
+			};
+
+			// Double the batch until one takes long enough for the clock's resolution not to matter
+			uint64_t count = 1024;
+			uint64_t ran = 0;
+			while (time(count, ran) < mOptions.minSeconds && count < (1ull << 40))
+			{
+				count *= 2;
+			}
+
+			std::vector<double> seconds;
+			for (int i = 0; i < mOptions.repetitions; ++i)
+			{
+				seconds.push_back(time(count, ran));
+			}
+			std::nth_element(seconds.begin(), seconds.begin() + seconds.size() / 2, seconds.end());
+
+			Result result;
+			result.group = group;
+			result.name = name;
+			result.operations = ran;
+			result.seconds = seconds[seconds.size() / 2];
+			mResults.push_back(result);
+
+			if (mOptions.format == Format::Text)
+			{
+				std::printf("%-10s %-32s %10.2f ns/op %14.0f op/s\n", group.c_str(), name.c_str(), result.GetNanosecondsPerOperation(), result.GetOperationsPerSecond());
+			}
+		}
+
+		void Print() const
+		{
+			if (mOptions.format == Format::Csv)
+			{
+				std::printf("group,name,operations,seconds,ns_per_op,ops_per_sec\n");
+				for (const Result& result : mResults)
+				{
+					std::printf("%s,%s,%llu,%.9f,%.3f,%.0f\n", result.group.c_str(), result.name.c_str(), static_cast<unsigned long long>(result.operations),
+						result.seconds, result.GetNanosecondsPerOperation(), result.GetOperationsPerSecond());
+				}
+			}
+			else if (mOptions.format == Format::Json)
+			{
+				std::printf("{\n  \"benchmarks\": [\n");
+				for (size_t i = 0; i < mResults.size(); ++i)
+				{
+					const Result& result = mResults[i];
+					std::printf("    {\"group\": \"%s\", \"name\": \"%s\", \"operations\": %llu, \"seconds\": %.9f, \"ns_per_op\": %.3f, \"ops_per_sec\": %.0f}%s\n",
+						result.group.c_str(), result.name.c_str(), static_cast<unsigned long long>(result.operations), result.seconds,
+						result.GetNanosecondsPerOperation(), result.GetOperationsPerSecond(), i + 1 < mResults.size() ? "," : "");
+				}
+				std::printf("  ]\n}\n");
+			}
+		}
+
+	private:
+		const Options& mOptions;
+		std::vector<Result> mResults;
+	};
+
+	// A fresh machine with I pointing at the font and every register at 0, so no instruction below strays out of memory
+	std::unique_ptr<CHIP> MakeChip()
+	{
+		std::unique_ptr<CHIP> chip = std::make_unique<CHIP>();
+		chip->Execute(0xA000, 0xA000 | gDefaultFontStartAddress);
+#ifdef DEBUG
+		chip->SetPaused(false);
+#endif
+		return chip;
+	}
+
+	// Runs one instruction over and over through CHIP::Execute(), the opcode lookup the HashMap engine uses
+	Body ExecuteBody(CHIP& chip, uint16_t instruction)
+	{
+		const uint16_t opcode = chip.Decode(instruction);
+		return [&chip, opcode, instruction](uint64_t count) {
+			for (uint64_t i = 0; i < count; ++i)
+			{
+				chip.Execute(opcode, instruction);
+			}
+			return count;
+		};
+	}
+
+	void RunExecuteBenchmarks(Bench& bench)
+	{
+		struct Case
+		{
+			const char* name;
+			uint16_t instruction;
+		};
+
+		// Operands stay on registers that are 0 and addresses inside memory, see MakeChip()
+		static const Case cases[] = {
+			{ "00E0", 0x00E0 }, { "1NNN", 0x1200 }, { "3XNN", 0x3A00 }, { "4XNN", 0x4A00 }, { "5XY0", 0x5AB0 },
+			{ "6XNN", 0x6A42 }, { "7XNN", 0x7A01 }, { "8XY0", 0x8AB0 }, { "8XY1", 0x8AB1 }, { "8XY2", 0x8AB2 },
+			{ "8XY3", 0x8AB3 }, { "8XY4", 0x8AB4 }, { "8XY5", 0x8AB5 }, { "8XY6", 0x8AB6 }, { "8XY7", 0x8AB7 },
+			{ "8XYE", 0x8ABE }, { "9XY0", 0x9AB0 }, { "ANNN", 0xA050 }, { "BNNN", 0xB200 }, { "EX9E", 0xEA9E },
+			{ "EXA1", 0xEAA1 }, { "FX07", 0xFA07 }, { "FX0A", 0xFA0A }, { "FX15", 0xFA15 }, { "FX18", 0xFA18 },
+			{ "FX1E", 0xFA1E }, { "FX29", 0xFA29 }, { "FX33", 0xFA33 }, { "FX55", 0xFF55 }, { "FX65", 0xFF65 },
+		};
+
+		for (const Case& test : cases)
+		{
+			std::unique_ptr<CHIP> chip = MakeChip();
+			bench.Run("execute", test.name, ExecuteBody(*chip, test.instruction));
+		}
+
+		// A call can't run on its own without overflowing the stack, so it's timed together with its return
+		std::unique_ptr<CHIP> chip = MakeChip();
+		bench.Run("execute", "2NNN+00EE", [&chip](uint64_t count) {
+			for (uint64_t i = 0; i < count; ++i)
+			{
+				chip->Execute(0x2000, 0x2300);
+				chip->Execute(0x00EE, 0x00EE);
+			}
+			return count;
+		});
+	}
+
+	void RunDecodeBenchmarks(Bench& bench)
+	{
+		// Fetch walks a kilobyte of program, jumping back to the start every 1024 fetches so it never runs off memory
+		std::unique_ptr<CHIP> chip = MakeChip();
+		bench.Run("decode", "Fetch", [&chip](uint64_t count) {
+			uint64_t sum = 0;
+			for (uint64_t i = 0; i < count; ++i)
+			{
+				if ((i & 1023) == 0)
+				{
+					chip->Execute(0x1000, 0x1200);
+				}
+				sum += chip->Fetch();
+			}
+			gSink = sum;
+			return count;
+		});
+
+		// One instruction from every family, so the nibble lookups see a realistic mix
+		static const uint16_t instructions[] = {
+			0x00E0, 0x00EE, 0x1200, 0x2300, 0x3A00, 0x4A00, 0x5AB0, 0x6A42, 0x7A01, 0x8AB0, 0x8AB4, 0x8ABE,
+			0x9AB0, 0xA050, 0xB200, 0xCA0F, 0xDAB5, 0xEA9E, 0xEAA1, 0xFA07, 0xFA15, 0xFA1E, 0xFA33, 0xFF65,
+		};
+		constexpr size_t instructionCount = sizeof(instructions) / sizeof(instructions[0]);
+		bench.Run("decode", "Decode", [&chip](uint64_t count) {
+			uint64_t sum = 0;
+			for (uint64_t i = 0; i < count; ++i)
+			{
+				sum += chip->Decode(instructions[i % instructionCount]);
+			}
+			gSink = sum;
+			return count;
+		});
+	}
+
+	void RunDisplayBenchmarks(Bench& bench)
+	{
+		struct Case
+		{
+			const char* name;
+			uint8_t x;
+			uint8_t y;
+			uint8_t height;
+		};
+
+		// Byte aligned, unaligned across two bytes, clipped at the right and bottom edges, and coordinates past the
+		// edge of the screen that wrap back onto it
+		static const Case cases[] = {
+			{ "DXY1 aligned", 8, 4, 1 },
+			{ "DXY5 aligned", 8, 4, 5 },
+			{ "DXYF aligned", 8, 4, 15 },
+			{ "DXY5 unaligned", 13, 4, 5 },
+			{ "DXYF unaligned", 13, 4, 15 },
+			{ "DXY5 right edge", 60, 4, 5 },
+			{ "DXYF bottom edge", 13, 24, 15 },
+			{ "DXY5 wrapped", 64 + 13, 32 + 4, 5 },
+		};
+
+		for (const Case& test : cases)
+		{
+			std::unique_ptr<CHIP> chip = MakeChip();
+			chip->Execute(0x6000, 0x6000 | test.x);
+			chip->Execute(0x6000, 0x6100 | test.y);
+			bench.Run("display", test.name, ExecuteBody(*chip, 0xD010 | test.height));
+		}
+	}
+
+	void RunScrollBenchmarks(Bench& bench)
+	{
+		// The SUPER-CHIP kernels straight on a half-lit high-resolution plane, scrolling it back and forth keeps it from
+		// emptying out. 16x16 sprites are drawn through the same kernel DXY0 uses.
+		DisplayPlane plane = {};
+		for (size_t word = 0; word < plane.size(); word += 2)
+		{
+			plane[word] = 0xF0F0F0F0F0F0F0F0ull;
+		}
+
+		bench.Run("scroll", "00C4+00D4", [&plane](uint64_t count) {
+			for (uint64_t i = 0; i < count; ++i)
+			{
+				ScrollDown(plane, true, 4);
+				ScrollUp(plane, true, 4);
+			}
+			return count * 2;
+		});
+		bench.Run("scroll", "00FB+00FC", [&plane](uint64_t count) {
+			for (uint64_t i = 0; i < count; ++i)
+			{
+				ScrollRight(plane, true, 4);
+				ScrollLeft(plane, true, 4);
+			}
+			return count * 2;
+		});
+		bench.Run("scroll", "DXY0 unaligned", [&plane](uint64_t count) {
+			bool collided = false;
+			uint64_t rows = 0;
+			for (uint64_t i = 0; i < count; ++i)
+			{
+				rows |= DrawSprite(plane, true, 61, 20, gBigFont.data(), 16, true, false, collided);
+			}
+			gSink = rows;
+			return count;
+		});
+	}
+
+	void RunPhosphorBenchmarks(Bench& bench)
+	{
+		// A flickering high-resolution display: every other frame half the pixels go out and the rest come on, so every
+		// row is both redrawn and fading each frame, the worst case for the filter
+		DisplayPlanes planes = {};
+		for (size_t word = 0; word < planes[0].size(); ++word)
+		{
+			planes[0][word] = 0xF0F0F0F0F0F0F0F0ull;
+		}
+
+		static const uint32_t scales[] = { 1, 4, 8, 16 };
+		for (const uint32_t scale : scales)
+		{
+			PhosphorSettings settings;
+			settings.scale = scale;
+			PhosphorFilter filter;
+			filter.SetSettings(settings);
+			bench.Run("phosphor", "128x64 frame x" + std::to_string(scale), [&planes, &filter](uint64_t count) {
+				uint64_t rows = 0;
+				for (uint64_t i = 0; i < count; ++i)
+				{
+					for (uint64_t& word : planes[0])
+					{
+						word = ~word;
+					}
+					rows |= filter.Process(planes[0].data(), planes[1].data(), gHiResDisplayWidth, gHiResDisplayHeight, gAllDisplayRows);
+				}
+				gSink = rows;
+				return count;
+			});
+		}
+	}
+
+	void RunRandomBenchmarks(Bench& bench)
+	{
+		std::unique_ptr<CHIP> chip = MakeChip();
+		bench.Run("random", "CXNN", ExecuteBody(*chip, 0xCAFF));
+	}
+
+	void RunRomBenchmarks(Bench& bench, const Options& options)
+	{
+		std::error_code error;
+		std::vector<std::filesystem::path> roms;
+		for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(options.romDirectory, error))
+		{
+			// Anything too big to load would just benchmark an empty machine
+			if (entry.path().extension() == ".ch8" && entry.file_size(error) <= gMaxRomSize)
+			{
+				roms.push_back(entry.path());
+			}
+		}
+		std::sort(roms.begin(), roms.end());
+
+		static const std::pair<const char*, ExecutionEngine> engines[] = {
+			{ "hashmap", ExecutionEngine::HashMap },
+			{ "switch", ExecutionEngine::Switch },
+			{ "predecoded", ExecutionEngine::Predecoded },
+			{ "jit", ExecutionEngine::Jit },
+		};
+
+		// As many cycles per frame as a frame allows, so the timers keep ticking and ROMs waiting on them make progress
+		constexpr uint16_t cyclesPerSecond = 60000;
+		for (const std::filesystem::path& rom : roms)
+		{
+			for (const auto& [engineName, engine] : engines)
+			{
+				const std::string path = rom.string();
+				bench.Run("rom", rom.filename().string() + " " + engineName, [engine, &path](uint64_t count) {
+					// Every repetition starts from power-on, not from wherever the previous one left the machine
+					std::unique_ptr<CHIP> chip = MakeChip();
+					chip->SetExecutionEngine(engine);
+					chip->LoadROM(path.c_str(), cyclesPerSecond);
+					while (chip->GetCycleCount() < count)
+					{
+						chip->RunFrame();
+					}
+					return chip->GetCycleCount();
+				});
+			}
+		}
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if (!ParseOptions(argc, argv, options))
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	Bench bench(options);
+	RunExecuteBenchmarks(bench);
+	RunDecodeBenchmarks(bench);
+	RunDisplayBenchmarks(bench);
+	RunScrollBenchmarks(bench);
+	RunPhosphorBenchmarks(bench);
+	RunRandomBenchmarks(bench);
+	RunRomBenchmarks(bench, options);
+	bench.Print();
+
+	return 0;
+}
@@ -0,0 +1,345 @@
+#include "Capture.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+namespace {
+
+	// How long the encoder sleeps when the queue is empty
+	constexpr auto gIdleSleep = std::chrono::milliseconds(1);
+	// Payloads are padded to this, so every header and the index stay 8 byte aligned in a mapping
+	constexpr uint64_t gPayloadAlignment = 8;
+
+	inline uint64_t AlignPayload(uint64_t size)
+	{
+		return (size + gPayloadAlignment - 1) & ~(gPayloadAlignment - 1);
+	}
+
+	// Bytes of one frame's visible planes before compression
+	inline size_t GetFrameBytes(uint8_t width, uint8_t height)
+	{
+		return gDisplayPlanes * height * (width / 64) * sizeof(uint64_t);
+	}
+
+	// PackBits: a header byte h below 128 is followed by h + 1 literal bytes, above 128 by one byte repeated 257 - h
+	// times. XOR deltas are mostly zeros, an unchanged 128x64 frame packs into 32 bytes.
+	void PackBits(const uint8_t* data, size_t size, std::vector<uint8_t>& packed)
+	{
+		size_t i = 0;
+		while (i < size)
+		{
+			size_t run = 1;
+			while (i + run < size && run < 128 && data[i + run] == data[i])
+			{
+				++run;
+			}
+			if (run >= 2)
+			{
+				packed.push_back(static_cast<uint8_t>(257 - run));
+				packed.push_back(data[i]);
+				i += run;
+				continue;
+			}
+
+			// Literals up to where the next run starts
+			const size_t start = i;
+			while (i < size && i - start < 128 && (i + 1 >= size || data[i] != data[i + 1]))
+			{
+				++i;
+			}
+			packed.push_back(static_cast<uint8_t>(i - start - 1));
+			packed.insert(packed.end(), data + start, data + i);
+		}
+	}
+
+	// False if packed doesn't unpack to exactly size bytes
+	bool UnpackBits(const uint8_t* packed, size_t packedSize, uint8_t* data, size_t size)
+	{
+		size_t in = 0;
+		size_t out = 0;
+		while (in < packedSize)
+		{
+			const uint8_t header = packed[in++];
+			if (header < 128)
+			{
+				const size_t count = header + 1u;
+				if (in + count > packedSize || out + count > size)
+				{
+					return false;
+				}
+				std::memcpy(data + out, packed + in, count);
+				in += count;
+				out += count;
+			}
+			else if (header > 128)
+			{
+				const size_t count = 257u - header;
+				if (in >= packedSize || out + count > size)
+				{
+					return false;
+				}
+				std::memset(data + out, packed[in++], count);
+				out += count;
+			}
+		}
+		return out == size;
+	}
+}
+
+CaptureWriter::CaptureWriter(const char* path, CaptureOverflow overflow /* = CaptureOverflow::Drop */, uint16_t keyframeInterval /* = 60 */)
+	: mQueue(std::make_unique<SpscQueue<CaptureImage, gQueueFrames>>())
+	, mFile(std::fopen(path, "wb"))
+	, mOverflow(overflow)
+	, mKeyframeInterval(std::max<uint16_t>(keyframeInterval, 1))
+{
+	if (mFile == nullptr)
+	{
+		return;
+	}
+
+	CaptureFileHeader header;
+	header.keyframeInterval = mKeyframeInterval;
+	std::fwrite(&header, sizeof(header), 1, mFile);
+	mOffset = sizeof(header);
+
+	mThread = std::thread(&CaptureWriter::Run, this);
+}
+
+CaptureWriter::~CaptureWriter()
+{
+	if (mFile == nullptr)
+	{
+		return;
+	}
+
+	mStopping.store(true, std::memory_order_release);
+	mThread.join();
+
+	CaptureFileFooter footer;
+	footer.indexOffset = mOffset;
+	footer.keyframeCount = static_cast<uint32_t>(mIndex.size());
+	footer.maxWidth = mMaxWidth;
+	footer.maxHeight = mMaxHeight;
+	footer.frameCount = mNextFrame;
+	footer.dropped = GetDropped();
+	std::fwrite(mIndex.data(), sizeof(CaptureIndexEntry), mIndex.size(), mFile);
+	std::fwrite(&footer, sizeof(footer), 1, mFile);
+	std::fclose(mFile);
+}
+
+void CaptureWriter::Push(const DisplayPlanes& planes, uint8_t width, uint8_t height)
+{
+	if (mFile == nullptr)
+	{
+		return;
+	}
+
+	CaptureImage image;
+	image.frame = mNextFrame++;
+	image.width = width;
+	image.height = height;
+	image.planes = planes;
+	while (!mQueue->Push(image))
+	{
+		if (mOverflow == CaptureOverflow::Drop)
+		{
+			mDropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		std::this_thread::yield();
+	}
+}
+
+void CaptureWriter::Run()
+{
+	CaptureImage image;
+	while (!mStopping.load(std::memory_order_acquire))
+	{
+		if (!mQueue->Pop(image))
+		{
+			std::this_thread::sleep_for(gIdleSleep);
+			continue;
+		}
+		Encode(image);
+	}
+
+	// The producer has stopped by now, take whatever it left behind
+	while (mQueue->Pop(image))
+	{
+		Encode(image);
+	}
+}
+
+void CaptureWriter::Encode(const CaptureImage& image)
+{
+	// Dropped frames don't matter here, the delta is always against the last frame actually written
+	const bool keyframe = !mHasPrevious || image.width != mPrevious.width || image.height != mPrevious.height
+		|| image.frame - mLastKeyframe >= mKeyframeInterval;
+
+	const size_t rowWords = image.width / 64;
+	mBytes.resize(GetFrameBytes(image.width, image.height));
+	uint8_t* bytes = mBytes.data();
+	for (size_t plane = 0; plane < gDisplayPlanes; ++plane)
+	{
+		for (size_t y = 0; y < image.height; ++y)
+		{
+			for (size_t word = 0; word < rowWords; ++word)
+			{
+				const size_t index = y * gDisplayRowWords + word;
+				const uint64_t value = keyframe ? image.planes[plane][index] : image.planes[plane][index] ^ mPrevious.planes[plane][index];
+				std::memcpy(bytes, &value, sizeof(value));
+				bytes += sizeof(value);
+			}
+		}
+	}
+
+	mPayload.clear();
+	PackBits(mBytes.data(), mBytes.size(), mPayload);
+	const size_t payloadSize = mPayload.size();
+	mPayload.resize(AlignPayload(payloadSize), 0);
+
+	CaptureFrameHeader header;
+	header.frame = image.frame;
+	header.size = static_cast<uint32_t>(payloadSize);
+	header.width = image.width;
+	header.height = image.height;
+	header.flags = keyframe ? gCaptureKeyframe : 0;
+
+	if (keyframe)
+	{
+		CaptureIndexEntry entry;
+		entry.frame = image.frame;
+		entry.offset = mOffset;
+		mIndex.push_back(entry);
+		mLastKeyframe = image.frame;
+	}
+
+	std::fwrite(&header, sizeof(header), 1, mFile);
+	std::fwrite(mPayload.data(), 1, mPayload.size(), mFile);
+	mOffset += sizeof(header) + mPayload.size();
+
+	mPrevious = image;
+	mHasPrevious = true;
+	mMaxWidth = std::max(mMaxWidth, image.width);
+	mMaxHeight = std::max(mMaxHeight, image.height);
+}
+
+CaptureReader::CaptureReader(const char* path)
+	: mFile(path)
+{
+	if (mFile.Size() < sizeof(CaptureFileHeader) + sizeof(CaptureFileFooter))
+	{
+		return;
+	}
+
+	CaptureFileHeader header;
+	std::memcpy(&header, mFile.Data(), sizeof(header));
+	const CaptureFileHeader expectedHeader;
+	if (std::memcmp(header.magic, expectedHeader.magic, sizeof(header.magic)) != 0 || header.version != expectedHeader.version)
+	{
+		return;
+	}
+
+	// A capture that was never closed has no footer, and so no index to seek with
+	std::memcpy(&mFooter, mFile.Data() + mFile.Size() - sizeof(CaptureFileFooter), sizeof(mFooter));
+	const CaptureFileFooter expectedFooter;
+	const uint64_t indexSize = static_cast<uint64_t>(mFooter.keyframeCount) * sizeof(CaptureIndexEntry);
+	if (std::memcmp(mFooter.magic, expectedFooter.magic, sizeof(mFooter.magic)) != 0 || mFooter.indexOffset < sizeof(CaptureFileHeader)
+		|| mFooter.indexOffset % gPayloadAlignment != 0 || mFooter.indexOffset + indexSize + sizeof(CaptureFileFooter) != mFile.Size())
+	{
+		return;
+	}
+
+	mIndex = reinterpret_cast<const CaptureIndexEntry*>(mFile.Data() + mFooter.indexOffset);
+	mCursor = sizeof(CaptureFileHeader);
+	mIsValid = true;
+}
+
+const CaptureImage* CaptureReader::Seek(uint64_t frame)
+{
+	if (!mIsValid)
+	{
+		return nullptr;
+	}
+
+	// Last keyframe at or before frame
+	const CaptureIndexEntry* end = mIndex + mFooter.keyframeCount;
+	const CaptureIndexEntry* keyframe = std::upper_bound(mIndex, end, frame,
+		[](uint64_t frame, const CaptureIndexEntry& entry) { return frame < entry.frame; });
+	if (keyframe == mIndex)
+	{
+		return nullptr;
+	}
+	--keyframe;
+
+	mCursor = keyframe->offset;
+	mHasImage = false;
+	const CaptureImage* image = DecodeNext();
+	for (const CaptureFrameHeader* next = GetNextHeader(); image != nullptr && next != nullptr && next->frame <= frame; next = GetNextHeader())
+	{
+		image = DecodeNext();
+	}
+	return image;
+}
+
+const CaptureImage* CaptureReader::Next()
+{
+	return mIsValid ? DecodeNext() : nullptr;
+}
+
+const CaptureFrameHeader* CaptureReader::GetNextHeader() const
+{
+	if (mCursor + sizeof(CaptureFrameHeader) > mFooter.indexOffset)
+	{
+		return nullptr;
+	}
+
+	const CaptureFrameHeader* header = reinterpret_cast<const CaptureFrameHeader*>(mFile.Data() + mCursor);
+	return mCursor + sizeof(CaptureFrameHeader) + AlignPayload(header->size) <= mFooter.indexOffset ? header : nullptr;
+}
+
+const CaptureImage* CaptureReader::DecodeNext()
+{
+	const CaptureFrameHeader* header = GetNextHeader();
+	const bool keyframe = header != nullptr && (header->flags & gCaptureKeyframe) != 0;
+	if (header == nullptr || (!keyframe && !mHasImage) || (header->width != 64 && header->width != 128) || header->height > gHiResDisplayHeight)
+	{
+		return nullptr;
+	}
+
+	const uint8_t* payload = mFile.Data() + mCursor + sizeof(CaptureFrameHeader);
+	mBytes.resize(GetFrameBytes(header->width, header->height));
+	if (!UnpackBits(payload, header->size, mBytes.data(), mBytes.size()))
+	{
+		return nullptr;
+	}
+
+	if (keyframe)
+	{
+		mImage.planes = {};
+	}
+
+	const size_t rowWords = header->width / 64;
+	const uint8_t* bytes = mBytes.data();
+	for (size_t plane = 0; plane < gDisplayPlanes; ++plane)
+	{
+		for (size_t y = 0; y < header->height; ++y)
+		{
+			for (size_t word = 0; word < rowWords; ++word)
+			{
+				uint64_t value;
+				std::memcpy(&value, bytes, sizeof(value));
+				mImage.planes[plane][y * gDisplayRowWords + word] ^= value;
+				bytes += sizeof(value);
+			}
+		}
+	}
+
+	mImage.frame = header->frame;
+	mImage.width = header->width;
+	mImage.height = header->height;
+	mHasImage = true;
+	mCursor += sizeof(CaptureFrameHeader) + AlignPayload(header->size);
+	return &mImage;
+}
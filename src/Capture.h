@@ -0,0 +1,162 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "Framebuffer.h"
+#include "MappedFile.h"
+#include "SpscQueue.h"
+
+// Capture files are this header followed by one CaptureFrameHeader and its payload per captured frame, then the
+// keyframe index and a CaptureFileFooter. A payload is the visible part of both planes (every row of the first plane,
+// then of the second, 8 bytes per 64 pixels), XORed with the previous frame's unless it's a keyframe, then PackBits
+// run-length encoded and zero padded to a multiple of 8 bytes.
+struct CaptureFileHeader
+{
+	char magic[4] = { 'C', '8', 'C', 'V' };
+	uint16_t version = 1;
+	uint16_t keyframeInterval = 0;	// Frames between keyframes, a resolution change also starts one
+	uint64_t reserved = 0;
+};
+static_assert(sizeof(CaptureFileHeader) == 16, "Capture file header layout is part of the file format");
+
+// Flags of a CaptureFrameHeader
+constexpr uint8_t gCaptureKeyframe = 1;
+
+struct CaptureFrameHeader
+{
+	uint64_t frame = 0;		// Frames since capturing started, ones the encoder dropped leave a gap
+	uint32_t size = 0;		// Payload bytes that follow
+	uint8_t width = 0;
+	uint8_t height = 0;
+	uint8_t flags = 0;
+	uint8_t reserved = 0;
+};
+static_assert(sizeof(CaptureFrameHeader) == 16, "Capture frame header layout is part of the file format");
+
+// One per keyframe, in frame order
+struct CaptureIndexEntry
+{
+	uint64_t frame = 0;
+	uint64_t offset = 0;	// File offset of the keyframe's CaptureFrameHeader
+};
+static_assert(sizeof(CaptureIndexEntry) == 16, "Capture index layout is part of the file format");
+
+// Last thing in the file, written when the capture is closed
+struct CaptureFileFooter
+{
+	uint64_t indexOffset = 0;
+	uint32_t keyframeCount = 0;
+	uint8_t maxWidth = 0;		// Largest resolution of any frame, for exporting at a fixed size
+	uint8_t maxHeight = 0;
+	uint16_t reserved = 0;
+	uint64_t frameCount = 0;	// Frames captured, dropped ones included
+	uint64_t dropped = 0;
+	char magic[4] = { 'C', '8', 'C', 'I' };
+	uint32_t reserved2 = 0;
+};
+static_assert(sizeof(CaptureFileFooter) == 40, "Capture footer layout is part of the file format");
+
+// What CaptureWriter::Push() does when the encoder has fallen a whole queue behind
+enum class CaptureOverflow : uint8_t
+{
+	Drop,	// Count the frame as dropped, for the interactive frontend which must never stall
+	Wait,	// Wait for the encoder, for chip8-headless --capture-wait runs that want every frame however fast they go
+};
+
+// A decoded frame
+struct CaptureImage
+{
+	uint64_t frame = 0;
+	uint8_t width = DISPLAY_WIDTH;
+	uint8_t height = DISPLAY_HEIGHT;
+	DisplayPlanes planes = {};
+};
+
+// Records the display to a capture file on a background encoder thread.
+// Push() only copies the planes into a fixed queue. With CaptureOverflow::Drop capturing never blocks the emulation:
+// when the encoder falls behind, frames are dropped and counted instead.
+class CaptureWriter {
+public:
+	CaptureWriter(const char* path, CaptureOverflow overflow = CaptureOverflow::Drop, uint16_t keyframeInterval = 60);
+	// Encodes what's still queued, then writes the index
+	~CaptureWriter();
+
+	CaptureWriter(const CaptureWriter&) = delete;
+	CaptureWriter& operator=(const CaptureWriter&) = delete;
+
+	inline bool IsOpen() const { return mFile != nullptr; }
+
+	// Producer side, called once per frame. width and height are the resolution the planes are shown at.
+	void Push(const DisplayPlanes& planes, uint8_t width, uint8_t height);
+
+	inline uint64_t GetDropped() const { return mDropped.load(std::memory_order_relaxed); }
+
+private:
+	// Frames the encoder can fall behind by before they get dropped, a second's worth
+	static constexpr size_t gQueueFrames = 64;
+
+	void Run();
+	void Encode(const CaptureImage& image);
+
+	// Heap allocated, the queue holds 2 KB per frame
+	std::unique_ptr<SpscQueue<CaptureImage, gQueueFrames>> mQueue;
+	FILE* mFile = nullptr;
+	std::thread mThread;
+	std::atomic<bool> mStopping = false;
+	CaptureOverflow mOverflow = CaptureOverflow::Drop;
+	uint64_t mNextFrame = 0;	// Only the producer touches it
+	alignas(64) std::atomic<uint64_t> mDropped = 0;
+
+	// Encoder thread state
+	uint16_t mKeyframeInterval = 0;
+	uint64_t mOffset = 0;
+	uint64_t mLastKeyframe = 0;
+	bool mHasPrevious = false;
+	CaptureImage mPrevious;
+	uint8_t mMaxWidth = 0;
+	uint8_t mMaxHeight = 0;
+	std::vector<uint8_t> mBytes;
+	std::vector<uint8_t> mPayload;
+	std::vector<CaptureIndexEntry> mIndex;
+};
+
+// Maps a capture file for playback and export. Seek() starts from the closest keyframe at or before the frame asked for.
+class CaptureReader {
+public:
+	explicit CaptureReader(const char* path);
+
+	// False if the file is missing, wasn't closed properly or is from another format version
+	inline bool IsValid() const { return mIsValid; }
+
+	inline uint64_t GetFrameCount() const { return mFooter.frameCount; }
+	inline uint64_t GetDropped() const { return mFooter.dropped; }
+	inline uint32_t GetKeyframeCount() const { return mFooter.keyframeCount; }
+
+	inline uint8_t GetMaxWidth() const { return mFooter.maxWidth; }
+	inline uint8_t GetMaxHeight() const { return mFooter.maxHeight; }
+
+	// Decodes the last captured frame at or before frame, nullptr if there's none
+	const CaptureImage* Seek(uint64_t frame);
+	// Decodes the captured frame after the one last decoded, or the first one. nullptr at the end of the capture.
+	const CaptureImage* Next();
+
+private:
+	// Header of the frame at mCursor, nullptr past the last one or if it runs into the index
+	const CaptureFrameHeader* GetNextHeader() const;
+	// Decodes the frame at mCursor on top of mImage and moves past it, nullptr if it's broken
+	const CaptureImage* DecodeNext();
+
+	MappedFile mFile;
+	CaptureFileFooter mFooter;
+	bool mIsValid = false;
+	const CaptureIndexEntry* mIndex = nullptr;
+	uint64_t mCursor = 0;			// Offset of the next frame's header
+	bool mHasImage = false;
+	CaptureImage mImage;			// The frame last decoded, which the next delta applies to
+	std::vector<uint8_t> mBytes;
+};
@@ -0,0 +1,216 @@
+#include "Capture.h"
+#include "Chip8.h"
+#include "Gif.h"
+#include "MappedFile.h"
+#include "Phosphor.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// Describes a capture written by CHIP8 --capture or chip8-headless --capture, and exports a range of it as a GIF
+
+namespace {
+
+	constexpr uint32_t gDefaultScale = 4;
+	// GIF delays are in hundredths of a second and most viewers slow anything shorter than this down
+	constexpr uint32_t gMinGifDelay = 2;
+
+	void PrintUsage()
+	{
+		std::fprintf(stderr,
+			"usage: chip8-capture <capture> [--gif FILE] [--from FRAME] [--to FRAME] [--scale N]\n"
+			"  --gif    export the frames as an animated GIF, at most 50 a second\n"
+			"  --from   first frame to export (default the first)\n"
+			"  --to     last frame to export (default the last)\n"
+			"  --scale  pixels per display pixel in the GIF, 1 to %u (default %u)\n",
+			gMaxPhosphorScale, gDefaultScale);
+	}
+
+	// Hundredths of a second into the capture that frame starts at
+	inline uint64_t GetFrameTime(uint64_t frame)
+	{
+		return frame * 100 / gFrameRate;
+	}
+
+	// Palette indices of a decoded frame at the capture's largest resolution, low-resolution frames of a capture that
+	// switches resolution are doubled up to fill it
+	void Rasterise(const CaptureImage& image, int width, int height, std::vector<uint8_t>& pixels)
+	{
+		const int factor = std::max(1, width / image.width);
+		pixels.resize(static_cast<size_t>(width) * height);
+		for (int y = 0; y < height; ++y)
+		{
+			const int row = y / factor;
+			for (int x = 0; x < width; ++x)
+			{
+				const int column = x / factor;
+				const size_t word = row * gDisplayRowWords + column / 64;
+				const int shift = 63 - column % 64;
+				const bool inside = row < image.height && column < image.width;
+				const uint8_t first = inside ? (image.planes[0][word] >> shift) & 1 : 0;
+				const uint8_t second = inside ? (image.planes[1][word] >> shift) & 1 : 0;
+				pixels[static_cast<size_t>(y) * width + x] = first | (second << 1);
+			}
+		}
+	}
+
+	void WriteScaled(GifWriter& gif, const std::vector<uint8_t>& pixels, int width, int height, uint32_t scale, uint64_t delay,
+		std::vector<uint8_t>& scaled)
+	{
+		const size_t scaledWidth = static_cast<size_t>(width) * scale;
+		scaled.resize(scaledWidth * height * scale);
+		for (int y = 0; y < height; ++y)
+		{
+			uint8_t* out = scaled.data() + y * scale * scaledWidth;
+			for (int x = 0; x < width; ++x)
+			{
+				std::fill_n(out + x * scale, scale, pixels[static_cast<size_t>(y) * width + x]);
+			}
+			for (uint32_t copy = 1; copy < scale; ++copy)
+			{
+				std::memcpy(out + copy * scaledWidth, out, scaledWidth);
+			}
+		}
+		gif.AddFrame(scaled.data(), static_cast<uint16_t>(std::min<uint64_t>(delay, UINT16_MAX)));
+	}
+
+	// Each GIF frame shows a displayed image for as long as it stayed up. Images that were up for less than
+	// gMinGifDelay, like the half-drawn frames of XOR flicker, give way to the next one.
+	int ExportGif(CaptureReader& capture, const char* path, uint64_t from, uint64_t to, uint32_t scale)
+	{
+		if (from >= capture.GetFrameCount())
+		{
+			std::fprintf(stderr, "chip8-capture: the capture ends at frame %llu\n", static_cast<unsigned long long>(capture.GetFrameCount()));
+			return 1;
+		}
+
+		const int width = capture.GetMaxWidth();
+		const int height = capture.GetMaxHeight();
+		std::vector<uint32_t> palette;
+		for (const uint32_t colour : gDefaultPalette)
+		{
+			palette.push_back(colour >> 8);
+		}
+
+		GifWriter gif(path, static_cast<uint16_t>(width * scale), static_cast<uint16_t>(height * scale), palette);
+		if (!gif.IsOpen())
+		{
+			std::fprintf(stderr, "chip8-capture: can't write %s\n", path);
+			return 1;
+		}
+
+		std::vector<uint8_t> shown;
+		std::vector<uint8_t> pixels;
+		std::vector<uint8_t> scaled;
+		uint64_t shownSince = 0;
+		uint64_t lastFrame = from;
+		uint64_t gifFrames = 0;
+		bool hasShown = false;
+		for (const CaptureImage* image = capture.Seek(from); image != nullptr && image->frame <= to; image = capture.Next())
+		{
+			// Seek() can land on an earlier frame that was still up at from
+			const uint64_t frame = std::max(image->frame, from);
+			lastFrame = frame;
+			Rasterise(*image, width, height, pixels);
+			if (!hasShown)
+			{
+				shown.swap(pixels);
+				shownSince = GetFrameTime(frame);
+				hasShown = true;
+				continue;
+			}
+			if (pixels == shown)
+			{
+				continue;
+			}
+
+			const uint64_t now = GetFrameTime(frame);
+			if (now - shownSince >= gMinGifDelay)
+			{
+				WriteScaled(gif, shown, width, height, scale, now - shownSince, scaled);
+				++gifFrames;
+				shownSince = now;
+			}
+			shown.swap(pixels);
+		}
+
+		if (!hasShown)
+		{
+			std::fprintf(stderr, "chip8-capture: no frames between %llu and %llu\n", static_cast<unsigned long long>(from), static_cast<unsigned long long>(to));
+			return 1;
+		}
+
+		// The last image stays up until the end of its frame
+		WriteScaled(gif, shown, width, height, scale, std::max<uint64_t>(GetFrameTime(lastFrame + 1) - shownSince, gMinGifDelay), scaled);
+		++gifFrames;
+		std::printf("gif: %llu frames, %dx%d\n", static_cast<unsigned long long>(gifFrames), width * static_cast<int>(scale), height * static_cast<int>(scale));
+		return 0;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const char* path = nullptr;
+	const char* gifPath = nullptr;
+	uint64_t from = 0;
+	uint64_t to = UINT64_MAX;
+	uint32_t scale = gDefaultScale;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const bool hasValue = i + 1 < argc;
+		if (std::strcmp(argv[i], "--gif") == 0 && hasValue)
+		{
+			gifPath = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--from") == 0 && hasValue)
+		{
+			from = std::strtoull(argv[++i], nullptr, 10);
+		}
+		else if (std::strcmp(argv[i], "--to") == 0 && hasValue)
+		{
+			to = std::strtoull(argv[++i], nullptr, 10);
+		}
+		else if (std::strcmp(argv[i], "--scale") == 0 && hasValue)
+		{
+			scale = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+			if (scale < 1 || scale > gMaxPhosphorScale)
+			{
+				PrintUsage();
+				return 1;
+			}
+		}
+		else if (argv[i][0] != '-' && path == nullptr)
+		{
+			path = argv[i];
+		}
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	if (path == nullptr || from > to)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	CaptureReader capture(path);
+	if (!capture.IsValid())
+	{
+		std::fprintf(stderr, "chip8-capture: %s is not a finished capture file\n", path);
+		return 1;
+	}
+
+	std::printf("frames: %llu (%llu dropped)\n", static_cast<unsigned long long>(capture.GetFrameCount()), static_cast<unsigned long long>(capture.GetDropped()));
+	std::printf("keyframes: %u\n", capture.GetKeyframeCount());
+	std::printf("largest resolution: %ux%u\n", capture.GetMaxWidth(), capture.GetMaxHeight());
+	std::printf("bytes: %llu\n", static_cast<unsigned long long>(MappedFile(path).Size()));
+
+	return gifPath != nullptr ? ExportGif(capture, gifPath, from, to, scale) : 0;
+}
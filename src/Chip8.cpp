@@ -1,21 +1,21 @@
 #include "Chip8.h"
-#include <iostream>
+#include "Hash.h"
+#include "MappedFile.h"
+#include "Rewind.h"
+#include "SaveState.h"
 
 #include <vector>
 
-#include <fstream>
 #include <algorithm>
-#include <sstream>
+#include <bit>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
 
 #include <cassert>
+#include <chrono>
 #include <random>
 
-#ifdef DEBUG
-#include <imgui.h>
-#include <backends/imgui_impl_sdl3.h>
-#include <backends/imgui_impl_sdlrenderer3.h>
-#endif
-
 
 // TODO: Use DREAM-6800 font, as it was an Australian CHIP-8 console
 const std::array<uint8_t, 80> gDefaultFont =
@@ -37,76 +37,411 @@ const std::array<uint8_t, 80> gDefaultFont =
 	0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
 	0xF0, 0x80, 0xF0, 0x80, 0x80  // F
 };
-constexpr uint8_t gDefaultFontStartAddress = 0x50;
-constexpr uint8_t gDefaultFontHeight = 5;
+
+// SUPER-CHIP 1.1's digits, with the hex letters XO-CHIP added
+const std::array<uint8_t, 160> gBigFont =
+{
+	0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, // 0
+	0x18, 0x78, 0x78, 0x18, 0x18, 0x18, 0x18, 0x18, 0xFF, 0xFF, // 1
+	0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // 2
+	0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 3
+	0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0x03, 0x03, // 4
+	0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 5
+	0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 6
+	0xFF, 0xFF, 0x03, 0x03, 0x06, 0x0C, 0x18, 0x18, 0x18, 0x18, // 7
+	0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 8
+	0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 9
+	0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, // A
+	0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, // B
+	0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C, // C
+	0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC, // D
+	0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // E
+	0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0  // F
+};
+
+// Guest instructions covered by each fusion, indexed by Fusion
+constexpr std::array<uint8_t, static_cast<size_t>(Fusion::Count)> gFusionLength = { 1, 4, 3, 3 };
 
 std::unordered_map<uint8_t, uint16_t> gOpcodeLookup =
 {
+	{0x5, 0xF00F},
 	{0x8, 0xF00F},
 	{0xF, 0xF0FF},
 	{0xE, 0xF0FF},
 	{0x0, 0xFFFF},
 };
 
+bool ParseExecutionEngine(const char* name, ExecutionEngine& engine)
+{
+	if (std::strcmp(name, "hashmap") == 0) { engine = ExecutionEngine::HashMap; return true; }
+	if (std::strcmp(name, "switch") == 0) { engine = ExecutionEngine::Switch; return true; }
+	if (std::strcmp(name, "predecoded") == 0) { engine = ExecutionEngine::Predecoded; return true; }
+	if (std::strcmp(name, "jit") == 0) { engine = ExecutionEngine::Jit; return true; }
+	return false;
+}
+
+namespace {
+	// Indexed by QuirkProfile
+	const char* const gQuirkProfileNames[static_cast<size_t>(QuirkProfile::Count)] = { "vip", "chip48", "schip", "xochip" };
+}
+
+bool ParseQuirkProfile(const char* name, QuirkProfile& profile)
+{
+	for (size_t i = 0; i < std::size(gQuirkProfileNames); ++i)
+	{
+		if (std::strcmp(name, gQuirkProfileNames[i]) == 0)
+		{
+			profile = static_cast<QuirkProfile>(i);
+			return true;
+		}
+	}
+	return false;
+}
+
+const char* GetQuirkProfileName(QuirkProfile profile)
+{
+	return profile < QuirkProfile::Count ? gQuirkProfileNames[static_cast<size_t>(profile)] : "unknown";
+}
+
 CHIP::CHIP()
 	: mInstructions {
-		{0x00E0, [this](const uint16_t opcode) { OpCode_ClearScreen(opcode); }},		// 00E0
-		{0x1000, [this](const uint16_t opcode) { OpCode_Jump(opcode); }},				// 1NNN
-		{0x6000, [this](const uint16_t opcode) { OpCode_SetVxToNn(opcode); }},			// 6XNN
-		{0xA000, [this](const uint16_t opcode) { OpCode_SetIndexRegister(opcode); }},	// ANNN
-		{0x7000, [this](const uint16_t opcode) { OpCode_AddNnToVx(opcode); }},			// 7XNN
-		{0xD000, [this](const uint16_t opcode) { OpCode_Display(opcode); }},			// DXYN
-
-		{0x2000, [this](const uint16_t opcode) { OpCode_PushSubroutine(opcode); }},		// 2NNN
-		{0x00EE, [this](const uint16_t opcode) { OpCode_PopSubroutine(opcode); }},		// 00EE
-		{0x3000, [this](const uint16_t opcode) { OpCode_SkipIfVxNn(opcode); }},			// 3XNN
-		{0x4000, [this](const uint16_t opcode) { OpCode_SkipIfVxNotNn(opcode); }},		// 4XNN
-		{0x5000, [this](const uint16_t opcode) { OpCode_SkipVxVyEqual(opcode); }},		// 5XY0
-		{0x9000, [this](const uint16_t opcode) { OpCode_SkipVxVyNotEqual(opcode); }},	// 9XY0
-		{0x7000, [this](const uint16_t opcode) { OpCode_Add(opcode); }},				// 7XNN
-
-		{0xB000, [this](const uint16_t opcode) { OpCode_JumpWithOffset(opcode); }},		// BNNN
-		{0xC000, [this](const uint16_t opcode) { OpCode_Random(opcode); }},				// CXNN
-
-		{0x8000, [this](const uint16_t opcode) { OpCode_Set(opcode); }},				// 8XY0
-		{0x8001, [this](const uint16_t opcode) { OpCode_BinaryOR(opcode); }},			// 8XY1
-		{0x8002, [this](const uint16_t opcode) { OpCode_BinaryAND(opcode); }},			// 8XY2
-		{0x8003, [this](const uint16_t opcode) { OpCode_LogicalXOR(opcode);	} },		// 8XY3
-		{0x8004, [this](const uint16_t opcode) { OpCode_AddWithCarry(opcode); }},		// 8XY4
-		{0x8005, [this](const uint16_t opcode) { OpCode_SubtractVyFromVx(opcode); }},	// 8XY5
-		{0x8007, [this](const uint16_t opcode) { OpCode_SubtractVxfromVy(opcode); }},	// 8XY7
-		{0x8006, [this](const uint16_t opcode) { OpCode_ShiftRight(opcode); }},			// 8XY6
-		{0x800E, [this](const uint16_t opcode) { OpCode_ShiftLeft(opcode); }},			// 8XYE
-
-		{0xE09E, [this](const uint16_t opcode) { OpCode_SkipIfKeyPressed(opcode); }},	// EX9E
-		{0xE0A1, [this](const uint16_t opcode) { OpCode_SkipIfKeyNotPressed(opcode); }},// EXA1
-
-		{0xF007, [this](const uint16_t opcode) { OpCode_CacheDelayTimer(opcode); }},	// FX07
-		{0xF015, [this](const uint16_t opcode) { OpCode_SetDelayTimer(opcode); }},		// FX15
-		{0xF018, [this](const uint16_t opcode) { OpCode_SetSoundTimer(opcode); }},		// FX18
-
-		{0xF01E, [this](const uint16_t opcode) { OpCode_AddToIndexRegister(opcode); }},	// FX1E
-		{0xF00A, [this](const uint16_t opcode) { OpCode_GetKey(opcode); }},				// FX0A
-		{0xF029, [this](const uint16_t opcode) { OpCode_SetFontCharacter(opcode); }},	// FX29
-		{0xF033, [this](const uint16_t opcode) { OpCode_BinaryToDecimal(opcode); }},	// FX33
-		
-		{0xF055, [this](const uint16_t opcode) { OpCode_StoreMemory(opcode); }},		// FX55
-		{0xF065, [this](const uint16_t opcode) { OpCode_LoadMemory(opcode); }},			// FX65
+		{0x1000, [this](const Operands& operands) { OpCode_Jump(operands); }},					// 1NNN
+		{0x6000, [this](const Operands& operands) { OpCode_SetVxToNn(operands); }},				// 6XNN
+		{0xA000, [this](const Operands& operands) { OpCode_SetIndexRegister(operands); }},		// ANNN
+		{0x7000, [this](const Operands& operands) { OpCode_AddNnToVx(operands); }},				// 7XNN
+
+		{0x2000, [this](const Operands& operands) { OpCode_PushSubroutine(operands); }},		// 2NNN
+		{0x00EE, [this](const Operands& operands) { OpCode_PopSubroutine(operands); }},			// 00EE
+		{0x7000, [this](const Operands& operands) { OpCode_Add(operands); }},					// 7XNN
+
+		{0xC000, [this](const Operands& operands) { OpCode_Random(operands); }},				// CXNN
+
+		{0x8000, [this](const Operands& operands) { OpCode_Set(operands); }},					// 8XY0
+		{0x8004, [this](const Operands& operands) { OpCode_AddWithCarry(operands); }},			// 8XY4
+		{0x8005, [this](const Operands& operands) { OpCode_SubtractVyFromVx(operands); }},		// 8XY5
+		{0x8007, [this](const Operands& operands) { OpCode_SubtractVxfromVy(operands); }},		// 8XY7
+
+		{0xF007, [this](const Operands& operands) { OpCode_CacheDelayTimer(operands); }},		// FX07
+		{0xF015, [this](const Operands& operands) { OpCode_SetDelayTimer(operands); }},			// FX15
+		{0xF018, [this](const Operands& operands) { OpCode_SetSoundTimer(operands); }},			// FX18
+
+		{0xF01E, [this](const Operands& operands) { OpCode_AddToIndexRegister(operands); }},	// FX1E
+		{0xF00A, [this](const Operands& operands) { OpCode_GetKey(operands); }},				// FX0A
+		{0xF029, [this](const Operands& operands) { OpCode_SetFontCharacter(operands); }},		// FX29
+		{0xF033, [this](const Operands& operands) { OpCode_BinaryToDecimal(operands); }},		// FX33
+
+		// 00E0, DXYN, BNNN, the skips, 8XY1, 8XY2, 8XY3, 8XY6, 8XYE, FX55, FX65 and the SUPER-CHIP and XO-CHIP
+		// instructions depend on the quirk profile, see BindQuirkyInstructions()
 	}
 {
 	memcpy(&mMemory[gDefaultFontStartAddress], &gDefaultFont, sizeof(gDefaultFont));
+	memcpy(&mMemory[gBigFontStartAddress], &gBigFont, sizeof(gBigFont));
+	SetQuirkProfile(mQuirkProfile);
+
+	std::random_device seed;
+	SetRandomSeed((static_cast<uint64_t>(seed()) << 32) | seed());
+}
+
+CHIP::~CHIP() = default;
+
+void CHIP::SetExecutionEngine(ExecutionEngine engine)
+{
+#if !CHIP8_JIT_SUPPORTED
+	// No recompiler for this host, the predecoded interpreter is the next best thing
+	if (engine == ExecutionEngine::Jit)
+	{
+		engine = ExecutionEngine::Predecoded;
+	}
+#endif
+
+	mEngine = engine;
+
+	// Compiled blocks may be stale by the time the JIT is picked again, so it's rebuilt from scratch each time
+	mJit.reset();
+	if (mEngine == ExecutionEngine::Jit)
+	{
+		mJit = std::make_unique<Jit>(*this);
+	}
+}
+
+bool CHIP::LoadROM(const char* romPath, uint16_t cyclesPerSecond /* = 700 */, QuirkProfile quirks /* = QuirkProfile::CosmacVip */)
+{
+	// Mapped rather than streamed in, the only copy is the one into guest memory
+	const MappedFile rom(romPath);
+	return rom.IsOpen() && LoadROM(rom.Data(), rom.Size(), cyclesPerSecond, quirks);
 }
 
-void CHIP::LoadROM(const char* romPath, uint16_t cyclesPerSecond /* = 700 */)
+bool CHIP::LoadROM(const uint8_t* rom, size_t size, uint16_t cyclesPerSecond /* = 700 */, QuirkProfile quirks /* = QuirkProfile::CosmacVip */)
 {
-	mSecondsPerCycle = 1.0 / cyclesPerSecond;
+	assert(cyclesPerSecond > 0 && "The program has to make some progress each second");
+	if (size > gMaxRomSize)
+	{
+		return false;
+	}
+
+	mCyclesPerSecond = cyclesPerSecond;
+	mFrameCycleRemainder = 0;
+	mFrameTimer = 0;
 
 	mProgramCounter = mStartingProgramCounter;
-	std::ifstream rom(romPath, std::ios::binary);
-	assert(!rom.fail(), "Filepath invalid");
-	rom.read(reinterpret_cast<char*>(mMemory.data() + mProgramCounter), sizeof(mMemory) - mProgramCounter);
-	mRomSize = rom.gcount();
-	rom.close();
+	// Whatever the previous program left past the end of this one would make runs depend on what ran before
+	std::memcpy(mMemory.data() + mStartingProgramCounter, rom, size);
+	std::fill(mMemory.begin() + mStartingProgramCounter + size, mMemory.end(), 0);
+	mRomSize = static_cast<uint16_t>(size);
+	mCycleCount = 0;
+	mFrameStartCycle = 0;
+	mFrameCount = 0;
+	mKeyEvents.clear();
+	SetRandomSeed(mRandomSeed);
+	SetQuirkProfile(quirks);
+
+	// Every program starts out on a blank low-resolution display, drawing to the first plane
+	mHighResolution = false;
+	mPlaneMask = 1;
+	for (DisplayPlane& plane : mDisplay)
+	{
+		plane.fill(0);
+	}
+	mAudioPattern.fill(0);
+	mPitch = 64;
+
+	// Whatever was presented, decoded or recorded before belongs to the previous program
+	OnMachineReplaced();
+	if (mRewind)
+	{
+		mRewind->Clear();
+	}
+
+	return true;
+}
+
+void CHIP::OnMachineReplaced()
+{
+	MarkRowsDirty(gAllDisplayRows);
+	mWrittenPages.set();
+
+	// Slots and blocks fill lazily as the program runs
+	InvalidateDecodeCache();
+	if (mJit)
+	{
+		mJit->Reset();
+	}
+
+	FuseSuperinstructions();
+}
+
+void CHIP::SetQuirkProfile(QuirkProfile profile)
+{
+	// Decoded slots and compiled blocks bake in the old profile's handlers, callers replace the machine right after
+	mQuirkProfile = profile;
+	switch (profile)
+	{
+	case QuirkProfile::CosmacVip: BindQuirkyInstructions<QuirkProfile::CosmacVip>(); break;
+	case QuirkProfile::Chip48: BindQuirkyInstructions<QuirkProfile::Chip48>(); break;
+	case QuirkProfile::SuperChip: BindQuirkyInstructions<QuirkProfile::SuperChip>(); break;
+	case QuirkProfile::XoChip: BindQuirkyInstructions<QuirkProfile::XoChip>(); break;
+	default: assert(false && "Unknown quirk profile."); break;
+	}
+}
+
+template<QuirkProfile Profile>
+void CHIP::BindQuirkyInstructions()
+{
+	constexpr InstructionSet instructions = GetQuirks(Profile).instructions;
+
+	mInstructions[0x00E0] = [this](const Operands& operands) { OpCode_ClearScreen<Profile>(operands); };		// 00E0
+	mInstructions[0x3000] = [this](const Operands& operands) { OpCode_SkipIfVxNn<Profile>(operands); };		// 3XNN
+	mInstructions[0x4000] = [this](const Operands& operands) { OpCode_SkipIfVxNotNn<Profile>(operands); };		// 4XNN
+	mInstructions[0x9000] = [this](const Operands& operands) { OpCode_SkipVxVyNotEqual<Profile>(operands); };	// 9XY0
+	mInstructions[0xE09E] = [this](const Operands& operands) { OpCode_SkipIfKeyPressed<Profile>(operands); };	// EX9E
+	mInstructions[0xE0A1] = [this](const Operands& operands) { OpCode_SkipIfKeyNotPressed<Profile>(operands); };	// EXA1
+	mInstructions[0xD000] = [this](const Operands& operands) { OpCode_Display<Profile>(operands); };			// DXYN
+	mInstructions[0xB000] = [this](const Operands& operands) { OpCode_JumpWithOffset<Profile>(operands); };	// BNNN
+	mInstructions[0x8001] = [this](const Operands& operands) { OpCode_BinaryOR<Profile>(operands); };			// 8XY1
+	mInstructions[0x8002] = [this](const Operands& operands) { OpCode_BinaryAND<Profile>(operands); };			// 8XY2
+	mInstructions[0x8003] = [this](const Operands& operands) { OpCode_LogicalXOR<Profile>(operands); };		// 8XY3
+	mInstructions[0x8006] = [this](const Operands& operands) { OpCode_ShiftRight<Profile>(operands); };		// 8XY6
+	mInstructions[0x800E] = [this](const Operands& operands) { OpCode_ShiftLeft<Profile>(operands); };			// 8XYE
+	mInstructions[0xF055] = [this](const Operands& operands) { OpCode_StoreMemory<Profile>(operands); };		// FX55
+	mInstructions[0xF065] = [this](const Operands& operands) { OpCode_LoadMemory<Profile>(operands); };		// FX65
+
+	// 5XY0 is looked up by its last nibble too, to tell it from 5XY2 and 5XY3. Elsewhere 5XYN is always a skip.
+	for (uint16_t n = 0; n <= 0xF; ++n)
+	{
+		mInstructions[0x5000 | n] = [this](const Operands& operands) { OpCode_SkipVxVyEqual<Profile>(operands); };	// 5XY0
+	}
+
+	// Whatever the previous profile added on top of CHIP-8 goes, then this one's extensions are added back
+	for (uint16_t n = 0; n <= 0xF; ++n)
+	{
+		mInstructions.erase(0x00C0 | n);
+		mInstructions.erase(0x00D0 | n);
+	}
+	for (uint16_t opcode : { 0x00FB, 0x00FC, 0x00FD, 0x00FE, 0x00FF, 0xF030, 0xF075, 0xF085, 0xF000, 0xF001, 0xF002, 0xF03A })
+	{
+		mInstructions.erase(opcode);
+	}
+
+	if constexpr (instructions != InstructionSet::Chip8)
+	{
+		for (uint16_t n = 0; n <= 0xF; ++n)
+		{
+			mInstructions[0x00C0 | n] = [this](const Operands& operands) { OpCode_ScrollDown<Profile>(operands); };	// 00CN
+		}
+		mInstructions[0x00FB] = [this](const Operands& operands) { OpCode_ScrollRight<Profile>(operands); };		// 00FB
+		mInstructions[0x00FC] = [this](const Operands& operands) { OpCode_ScrollLeft<Profile>(operands); };		// 00FC
+		mInstructions[0x00FD] = [this](const Operands& operands) { OpCode_Exit(operands); };						// 00FD
+		mInstructions[0x00FE] = [this](const Operands& operands) { OpCode_LowResolution(operands); };				// 00FE
+		mInstructions[0x00FF] = [this](const Operands& operands) { OpCode_HighResolution(operands); };				// 00FF
+		mInstructions[0xF030] = [this](const Operands& operands) { OpCode_SetBigFontCharacter(operands); };		// FX30
+		mInstructions[0xF075] = [this](const Operands& operands) { OpCode_StoreFlags(operands); };					// FX75
+		mInstructions[0xF085] = [this](const Operands& operands) { OpCode_LoadFlags(operands); };					// FX85
+	}
+
+	if constexpr (instructions == InstructionSet::XoChip)
+	{
+		for (uint16_t n = 0; n <= 0xF; ++n)
+		{
+			mInstructions[0x00D0 | n] = [this](const Operands& operands) { OpCode_ScrollUp<Profile>(operands); };		// 00DN
+		}
+		mInstructions[0x5002] = [this](const Operands& operands) { OpCode_StoreRange(operands); };					// 5XY2
+		mInstructions[0x5003] = [this](const Operands& operands) { OpCode_LoadRange(operands); };					// 5XY3
+		mInstructions[0xF000] = [this](const Operands& operands) { OpCode_SetLongIndexRegister(operands); };		// F000 NNNN
+		mInstructions[0xF001] = [this](const Operands& operands) { OpCode_SelectPlanes(operands); };				// FN01
+		mInstructions[0xF002] = [this](const Operands& operands) { OpCode_LoadAudioPattern(operands); };			// F002
+		mInstructions[0xF03A] = [this](const Operands& operands) { OpCode_SetPitch(operands); };					// FX3A
+	}
+}
+
+void CHIP::SetKeypad(uint16_t keys)
+{
+	for (size_t i = 0; i < mKeypad.size(); ++i)
+	{
+		mKeypad[i] = (keys >> i) & 1;
+	}
+}
+
+uint64_t CHIP::QueueKeyEvent(uint64_t cycle, uint8_t key, bool pressed)
+{
+	KeyEvent event;
+	event.cycle = IsPaused() ? mCycleCount : std::clamp(cycle, mCycleCount, GetFrameEndCycle());
+	event.key = key & 0xF;
+	event.pressed = pressed;
+
+	// Usually lands at the back, events arrive in the order they happened
+	const auto position = std::upper_bound(mKeyEvents.begin(), mKeyEvents.end(), event.cycle,
+		[](uint64_t cycle, const KeyEvent& queued) { return cycle < queued.cycle; });
+	mKeyEvents.insert(position, event);
+	return event.cycle;
+}
+
+void CHIP::ApplyKeyEvents(uint64_t cycle)
+{
+	size_t applied = 0;
+	for (; applied < mKeyEvents.size() && mKeyEvents[applied].cycle <= cycle; ++applied)
+	{
+		mKeypad[mKeyEvents[applied].key] = mKeyEvents[applied].pressed;
+	}
+	mKeyEvents.erase(mKeyEvents.begin(), mKeyEvents.begin() + applied);
+}
+
+void CHIP::SetRandomSeed(uint64_t seed)
+{
+	mRandomSeed = seed;
+	mRandom.Seed(seed);
+}
+
+void CHIP::EnableRewind(uint32_t seconds)
+{
+	mRewind.reset();
+	mIsRewinding = false;
+	if (seconds > 0)
+	{
+		const size_t frames = static_cast<size_t>(seconds) * gFrameRate;
+		mRewind = std::make_unique<RewindBuffer>(frames, frames * gRewindBytesPerFrame);
+	}
+}
+
+void CHIP::SaveState(MachineState& state)
+{
+	state.header = SaveStateHeader();
+	state.header.stateSize = sizeof(MachineState);
+	SaveCpuState(state.cpu);
+	state.memory = mMemory;
+	state.display = mDisplay;
+}
+
+void CHIP::SaveCpuState(CpuState& cpu)
+{
+	cpu = CpuState();
+	cpu.variableRegisters = mVariableRegisters;
+	cpu.addressStack = mAddressStack;
+	cpu.stackSize = mStackSize;
+	cpu.indexRegister = mIndexRegister;
+	cpu.programCounter = mProgramCounter;
+	cpu.delayTimer = mDelayTimer;
+	cpu.soundTimer = mSoundTimer;
+	for (size_t i = 0; i < mKeypad.size(); ++i)
+	{
+		cpu.keypad |= mKeypad[i] ? 1 << i : 0;
+	}
+	cpu.cyclesPerSecond = mCyclesPerSecond;
+	cpu.frameCycleRemainder = mFrameCycleRemainder;
+	cpu.romSize = mRomSize;
+	cpu.quirkProfile = static_cast<uint8_t>(mQuirkProfile);
+	cpu.highResolution = mHighResolution;
+	cpu.planeMask = mPlaneMask;
+	cpu.pitch = mPitch;
+	cpu.cycleCount = mCycleCount;
+	cpu.frameCount = mFrameCount;
+	cpu.flagRegisters = mFlagRegisters;
+	cpu.audioPattern = mAudioPattern;
+	cpu.randomState = mRandom.GetState();
+}
+
+bool CHIP::LoadState(const MachineState& state)
+{
+	if (ValidateState(reinterpret_cast<const uint8_t*>(&state), sizeof(state)) == nullptr)
+	{
+		return false;
+	}
+
+	LoadCpuState(state.cpu);
+	mFrameTimer = 0;
+	mMemory = state.memory;
+	mDisplay = state.display;
+	OnMachineReplaced();
+
+	return true;
+}
+
+void CHIP::LoadCpuState(const CpuState& cpu)
+{
+	mVariableRegisters = cpu.variableRegisters;
+	mAddressStack = cpu.addressStack;
+	mStackSize = std::min<uint8_t>(cpu.stackSize, gStackDepth);
+	mIndexRegister = cpu.indexRegister;
+	mProgramCounter = cpu.programCounter;
+	mDelayTimer = cpu.delayTimer;
+	mSoundTimer = cpu.soundTimer;
+	for (size_t i = 0; i < mKeypad.size(); ++i)
+	{
+		mKeypad[i] = (cpu.keypad >> i) & 1;
+	}
+	mCyclesPerSecond = cpu.cyclesPerSecond;
+	mFrameCycleRemainder = cpu.frameCycleRemainder;
+	mRomSize = static_cast<uint16_t>(std::min<uint32_t>(cpu.romSize, gMaxRomSize));
+	SetQuirkProfile(cpu.quirkProfile < static_cast<uint8_t>(QuirkProfile::Count) ? static_cast<QuirkProfile>(cpu.quirkProfile) : QuirkProfile::CosmacVip);
+	mHighResolution = cpu.highResolution != 0;
+	mPlaneMask = cpu.planeMask & 0x3;
+	mPitch = cpu.pitch;
+	mCycleCount = cpu.cycleCount;
+	mFrameStartCycle = mCycleCount;
+	mKeyEvents.clear();
+	mFrameCount = cpu.frameCount;
+	mFlagRegisters = cpu.flagRegisters;
+	mAudioPattern = cpu.audioPattern;
+	mRandom.SetState(cpu.randomState);
 }
 
 void CHIP::Update(const double deltaTime)
@@ -116,50 +451,532 @@ void CHIP::Update(const double deltaTime)
 		return;
 	}
 
-	mTimer += deltaTime;
-	mCycleTimer += deltaTime;
+	// Wall-clock time only decides how many whole frames are due, everything inside a frame is counted in cycles.
+	// Anything beyond a few frames behind (a breakpoint, a dragged window) is dropped rather than run in one burst.
+	mFrameTimer = std::min(mFrameTimer + deltaTime, static_cast<double>(gMaxCatchUpFrames) / gFrameRate);
+	while (mFrameTimer >= 1.0 / gFrameRate)
+	{
+		mFrameTimer -= 1.0 / gFrameRate;
+		RunFrame();
+	}
+}
+
+void CHIP::RunFrame()
+{
+	if (IsPaused())
+	{
+		ApplyKeyEvents(UINT64_MAX);
+		return;
+	}
+
+	if (mRewind && mIsRewinding)
+	{
+		ApplyKeyEvents(UINT64_MAX);
+		mRewind->StepBack(*this);
+		return;
+	}
+
+	// Spread the per-second budget over the frames without drifting, e.g. 700/s alternates 11 and 12 cycles a frame
+	const uint32_t frameCycles = mCyclesPerSecond + mFrameCycleRemainder;
+	mFrameCycleRemainder = frameCycles % gFrameRate;
+	// Counted from where the frame started rather than mCycleCount, so instructions stepped by hand while paused use up
+	// its budget instead of moving every later frame boundary
+	const uint64_t frameEnd = mFrameStartCycle + frameCycles / gFrameRate;
+	mFrameStartCycle = frameEnd;
+
+	// The frame is cut short of each queued key event, without any it's still a single run
+	while (mCycleCount < frameEnd)
+	{
+		ApplyKeyEvents(mCycleCount);
+		const uint64_t runTo = mKeyEvents.empty() ? frameEnd : std::min(mKeyEvents.front().cycle, frameEnd);
+		RunCycles(static_cast<uint32_t>(runTo - mCycleCount));
+	}
+	ApplyKeyEvents(UINT64_MAX);
+
+	// Before the sound timer ticks, so even a single frame of FX18 is heard
+	if (mAudioOutput)
+	{
+		RenderAudio();
+	}
+
+	// Both timers count down at 60 Hz, once per frame
+	if (mDelayTimer > 0)
+	{
+		--mDelayTimer;
+	}
+	if (mSoundTimer > 0)
+	{
+		--mSoundTimer;
+	}
+
+	if (mCapture)
+	{
+		mCapture->Push(mDisplay, GetDisplayWidth(), GetDisplayHeight());
+	}
+
+	++mFrameCount;
+
+	if (mRewind)
+	{
+		mRewind->Record(*this);
+	}
+}
+
+void CHIP::RenderAudio()
+{
+	// Without an XO-CHIP pattern the beeper is a square wave, played as a pattern of half ones and half zeros
+	static constexpr std::array<uint8_t, 16> squarePattern = { 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF };
+	constexpr double squareFrequency = 440.0;
+	constexpr double patternBits = 128.0;
+	constexpr int16_t amplitude = 4096;
+
+	std::array<int16_t, gAudioFrameSamples> samples;
+	if (mSoundTimer == 0)
+	{
+		samples.fill(0);
+		mAudioPhase = 0;
+		mAudioOutput->Push(samples.data(), samples.size());
+		return;
+	}
 
-	// Timers need to be decremented by 1 every second
-	const int timerDecrement = static_cast<int>(std::floor(mTimer));
-	// Clamp to avoid conditionals
-	mDelayTimer = std::clamp(mDelayTimer - timerDecrement, 0, 255);
-	mSoundTimer = std::clamp(mSoundTimer - timerDecrement, 0, 255);
-	mTimer -= timerDecrement;
+	const bool hasPattern = mQuirkProfile == QuirkProfile::XoChip && mAudioPattern != std::array<uint8_t, 16>();
+	const std::array<uint8_t, 16>& pattern = hasPattern ? mAudioPattern : squarePattern;
+	// XO-CHIP plays 4000 bits a second at pitch 64, an octave up or down for every 48 steps
+	const double bitsPerSecond = hasPattern ? 4000.0 * std::exp2((mPitch - 64) / 48.0) : squareFrequency * patternBits;
+	const double step = bitsPerSecond / gAudioSampleRate;
 
-	// Ensure no missed instructions between updates.
-	const int cyclesToRun = static_cast<int>(mCycleTimer / mSecondsPerCycle);
-	for (int i = 0; i < cyclesToRun; ++i)
+	for (int16_t& sample : samples)
 	{
-		Process();
+		const size_t bit = static_cast<size_t>(mAudioPhase);
+		sample = (pattern[bit / 8] >> (7 - bit % 8)) & 1 ? amplitude : -amplitude;
+		mAudioPhase += step;
+		if (mAudioPhase >= patternBits)
+		{
+			mAudioPhase -= patternBits;
+		}
 	}
+	mAudioOutput->Push(samples.data(), samples.size());
+}
 
-	// Only subtract time used, to ensure no lost time between updates.
-	mCycleTimer -= cyclesToRun * mSecondsPerCycle;
+void CHIP::Process()
+{
+	switch (mQuirkProfile)
+	{
+	case QuirkProfile::CosmacVip: Process<QuirkProfile::CosmacVip>(); break;
+	case QuirkProfile::Chip48: Process<QuirkProfile::Chip48>(); break;
+	case QuirkProfile::SuperChip: Process<QuirkProfile::SuperChip>(); break;
+	case QuirkProfile::XoChip: Process<QuirkProfile::XoChip>(); break;
+	default: assert(false && "Unknown quirk profile."); break;
+	}
 }
 
+template<QuirkProfile Profile>
 void CHIP::Process()
 {
-	const uint16_t instruction = Fetch();
-	const uint16_t opcode = Decode(instruction);
-	Execute(opcode, instruction);
+	switch (mEngine)
+	{
+	case ExecutionEngine::HashMap:
+	{
+		const uint16_t instruction = Fetch();
+		Execute(Decode(instruction), instruction);
+		break;
+	}
+	case ExecutionEngine::Switch:
+	{
+		const uint16_t instruction = Fetch();
+		(this->*LookupHandler<Profile>(instruction))(Operands(instruction));
+		break;
+	}
+	case ExecutionEngine::Predecoded:
+	case ExecutionEngine::Jit:
+	{
+		// Steady state never touches Fetch() or Decode(), the slot already holds the handler and its operands
+		const CachedInstruction& cached = FetchCached<Profile>();
+		(this->*cached.handler)(cached.operands);
+		break;
+	}
+	}
+}
+
+uint32_t CHIP::RunCycles(uint32_t cycles)
+{
+#if CHIP8_TRACE
+	if (mTrace)
+	{
+		return RunInstrumentedCycles(cycles);
+	}
+#endif
+#if CHIP8_PROFILE
+	if (mProfiler)
+	{
+		return RunInstrumentedCycles(cycles);
+	}
+#endif
+
+	uint32_t executed = 0;
+
+	if (mJit)
+	{
+		// Whole blocks run at once, the JIT interprets single instructions itself when a block wouldn't fit the budget
+		while (executed < cycles)
+		{
+			executed += mJit->Step(cycles - executed);
+		}
+		mCycleCount += executed;
+		return executed;
+	}
+
+	// The only time the profile gets branched on, from here on every quirk is a compile-time constant
+	switch (mQuirkProfile)
+	{
+	case QuirkProfile::CosmacVip: return RunCycles<QuirkProfile::CosmacVip>(cycles);
+	case QuirkProfile::Chip48: return RunCycles<QuirkProfile::Chip48>(cycles);
+	case QuirkProfile::SuperChip: return RunCycles<QuirkProfile::SuperChip>(cycles);
+	case QuirkProfile::XoChip: return RunCycles<QuirkProfile::XoChip>(cycles);
+	default: break;
+	}
+
+	assert(false && "Unknown quirk profile.");
+	return 0;
+}
+
+template<QuirkProfile Profile>
+uint32_t CHIP::RunCycles(uint32_t cycles)
+{
+	uint32_t executed = 0;
+
+	if (mEngine == ExecutionEngine::Predecoded)
+	{
+		while (executed < cycles)
+		{
+			const uint32_t cyclesLeft = cycles - executed;
+			const Fusion fusion = (mProgramCounter & 1) == 0 && mProgramCounter < gCachedCodeSize ? mFusions[mProgramCounter >> 1] : Fusion::None;
+
+			// A fusion only runs when all of it fits the budget, otherwise its instructions go through one at a time
+			if (fusion != Fusion::None && gFusionLength[static_cast<size_t>(fusion)] <= cyclesLeft)
+			{
+				executed += ExecuteFusion<Profile>(fusion, cyclesLeft);
+			}
+			else
+			{
+				Process<Profile>();
+				++executed;
+			}
+		}
+		mCycleCount += executed;
+		return executed;
+	}
+
+	for (; executed < cycles; ++executed)
+	{
+		Process<Profile>();
+	}
+	mCycleCount += executed;
+	return executed;
+}
+
+#if CHIP8_TRACE || CHIP8_PROFILE
+uint32_t CHIP::RunInstrumentedCycles(uint32_t cycles)
+{
+	// Fused idioms and compiled blocks retire several instructions at once, so tracing and profiling always go one
+	// instruction at a time. Both share this loop, so either still sees every instruction when the other is on too.
+	uint32_t executed = 0;
+	for (; executed < cycles; ++executed)
+	{
+		const uint16_t pc = mProgramCounter;
+		const uint16_t instruction = pc + 1u < mMemory.size() ? (mMemory[pc] << 8) | mMemory[pc + 1] : 0;
+#if CHIP8_TRACE
+		const std::array<uint8_t, 16> registers = mVariableRegisters;
+#endif
+
+#if CHIP8_PROFILE
+		if (mProfiler && (instruction >> 12) == 0xD)
+		{
+			const auto start = std::chrono::steady_clock::now();
+			Process();
+			mProfiler->AddDrawTime(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+		}
+		else
+#endif
+		{
+			Process();
+		}
+
+#if CHIP8_PROFILE
+		if (mProfiler)
+		{
+			mProfiler->Count(pc, instruction, mProgramCounter);
+		}
+#endif
+#if CHIP8_TRACE
+		if (mTrace)
+		{
+			TraceRecord record;
+			record.cycle = mCycleCount + executed;
+			record.pc = pc;
+			record.instruction = instruction;
+			record.index = mIndexRegister;
+			for (uint8_t i = 0; i < registers.size(); ++i)
+			{
+				if (registers[i] != mVariableRegisters[i])
+				{
+					record.reg = i;
+					record.value = mVariableRegisters[i];
+					break;
+				}
+			}
+			mTrace->Push(record);
+		}
+#endif
+	}
+	mCycleCount += executed;
+	return executed;
 }
+#endif
 
 uint16_t CHIP::Fetch()
 {
 	// Each instruction is two bytes, we want to shift the first byte to the most-significant slot, so we can fit in the second byte.
-	const uint16_t instruction = (static_cast<uint16_t>(mMemory[mProgramCounter]) << 8) ^ static_cast<uint16_t>(mMemory[mProgramCounter + 1]);
+	const uint16_t instruction = (static_cast<uint16_t>(mMemory[mProgramCounter]) << 8) ^ static_cast<uint16_t>(mMemory[static_cast<uint16_t>(mProgramCounter + 1)]);
 
 	// Read two successive bytes and combine into one 16-bit instruction
 	mProgramCounter += 2;
 
 #ifdef DEBUG
 	mPreviousInstruction = instruction;
-	mNextInstruction = (static_cast<uint16_t>(mMemory[mProgramCounter]) << 8) ^ static_cast<uint16_t>(mMemory[mProgramCounter + 1]);
+	mNextInstruction = (static_cast<uint16_t>(mMemory[mProgramCounter]) << 8) ^ static_cast<uint16_t>(mMemory[static_cast<uint16_t>(mProgramCounter + 1)]);
 #endif
 
 	return instruction;
 }
 
+template<QuirkProfile Profile>
+const CHIP::CachedInstruction& CHIP::FetchCached()
+{
+	// Instructions only get a slot when they sit on an even address in the first 4 KB, jumps to odd addresses are rare
+	// enough to decode every time
+	CachedInstruction& cached = (mProgramCounter & 1) || mProgramCounter >= gCachedCodeSize ? mUncachedInstruction : mDecodeCache[mProgramCounter >> 1];
+	if (cached.handler == nullptr || &cached == &mUncachedInstruction)
+	{
+		const uint16_t instruction = Fetch();
+		cached.handler = LookupHandler<Profile>(instruction);
+		cached.operands = Operands(instruction);
+		return cached;
+	}
+
+	mProgramCounter += 2;
+
+#ifdef DEBUG
+	mPreviousInstruction = cached.operands.instruction;
+	mNextInstruction = (static_cast<uint16_t>(mMemory[mProgramCounter]) << 8) ^ static_cast<uint16_t>(mMemory[static_cast<uint16_t>(mProgramCounter + 1)]);
+#endif
+
+	return cached;
+}
+
+void CHIP::WriteMemory(uint16_t address, uint8_t value)
+{
+	mMemory[address] = value;
+	mWrittenPages[address / gMemoryPageSize] = true;
+	if (address >= gCachedCodeSize)
+	{
+		// Nothing up here was ever decoded or compiled
+		return;
+	}
+
+	// The slot decoded from the instruction covering this byte is now stale, it will be re-decoded next time it's reached
+	const uint16_t slot = address >> 1;
+	mDecodeCache[slot].handler = nullptr;
+
+	// So is any fusion spanning it, which will just run as individual instructions from now on
+	for (uint16_t start = slot >= 3 ? slot - 3 : 0; start <= slot; ++start)
+	{
+		if (start + gFusionLength[static_cast<size_t>(mFusions[start])] > slot)
+		{
+			mFusions[start] = Fusion::None;
+		}
+	}
+	if (mJit)
+	{
+		mJit->Invalidate(address);
+	}
+}
+
+uint64_t CHIP::GetDisplayHash()
+{
+	return HashDisplay(mDisplay, mHighResolution, mQuirkProfile == QuirkProfile::XoChip ? gDisplayPlanes : 1, gHashSeed);
+}
+
+uint64_t CHIP::GetFrameHash(uint64_t seed)
+{
+	uint64_t hash = HashDisplay(mDisplay, mHighResolution, mQuirkProfile == QuirkProfile::XoChip ? gDisplayPlanes : 1, seed);
+	hash = HashBytes(mVariableRegisters.data(), sizeof(mVariableRegisters), hash);
+	hash = HashBytes(&mIndexRegister, sizeof(mIndexRegister), hash);
+	return HashBytes(&mProgramCounter, sizeof(mProgramCounter), hash);
+}
+
+uint64_t CHIP::TakeDirtyRows()
+{
+	const uint64_t dirtyRows = mDirtyRows;
+	mDirtyRows = 0;
+	return dirtyRows;
+}
+
+void CHIP::MarkRowsDirty(uint64_t rows)
+{
+	if (rows != 0)
+	{
+		mDirtyRows |= rows;
+		mChangedRows |= rows;
+		++mDisplayGeneration;
+	}
+}
+
+template<QuirkProfile Profile>
+uint8_t CHIP::GetSelectedPlanes() const
+{
+	if constexpr (GetQuirks(Profile).instructions == InstructionSet::XoChip)
+	{
+		return mPlaneMask;
+	}
+	return 1;
+}
+
+template<QuirkProfile Profile>
+void CHIP::SkipInstruction()
+{
+	// Read straight from memory rather than through the decode cache, the instruction being skipped may never have run
+	if constexpr (GetQuirks(Profile).instructions == InstructionSet::XoChip)
+	{
+		if (mMemory[mProgramCounter] == 0xF0 && mMemory[static_cast<uint16_t>(mProgramCounter + 1)] == 0x00)
+		{
+			mProgramCounter += 4;
+			return;
+		}
+	}
+	mProgramCounter += 2;
+}
+
+void CHIP::InvalidateDecodeCache()
+{
+	for (CachedInstruction& cached : mDecodeCache)
+	{
+		cached.handler = nullptr;
+	}
+
+	mFusions.fill(Fusion::None);
+}
+
+void CHIP::FuseSuperinstructions()
+{
+	mFusionsFired.fill(0);
+
+	// Data can match a pattern just as well as code, that's harmless as fusions behave exactly like the instructions they replace
+	for (uint16_t address = mStartingProgramCounter; static_cast<size_t>(address) + 8 <= gCachedCodeSize; address += 2)
+	{
+		std::array<uint16_t, 4> window;
+		for (size_t i = 0; i < window.size(); ++i)
+		{
+			window[i] = (static_cast<uint16_t>(mMemory[address + i * 2]) << 8) | mMemory[address + i * 2 + 1];
+		}
+
+		const uint8_t x = (window[0] & 0x0F00) >> 8;
+		Fusion fusion = Fusion::None;
+
+		if ((window[0] & 0xF000) == 0x6000 && (window[1] & 0xF000) == 0x6000 && (window[2] & 0xF000) == 0xA000 && (window[3] & 0xF000) == 0xD000)
+		{
+			fusion = Fusion::LoadAndDraw;
+		}
+		else if ((window[0] & 0xF0FF) == 0xF007 && window[1] == (0x3000 | (x << 8)) && window[2] == (0x1000 | address))
+		{
+			fusion = Fusion::WaitForDelay;
+		}
+		else if ((window[0] & 0xF000) == 0x7000 && (window[1] & 0xFF00) == (0x3000 | (x << 8)) && window[2] == (0x1000 | address))
+		{
+			fusion = Fusion::CountedLoop;
+		}
+
+		if (fusion == Fusion::None)
+		{
+			continue;
+		}
+
+		// Fusions read their operands straight out of the decode cache, so their slots are filled up-front
+		const uint16_t slot = address >> 1;
+		for (uint8_t i = 0; i < gFusionLength[static_cast<size_t>(fusion)]; ++i)
+		{
+			mDecodeCache[slot + i].handler = LookupHandler(mQuirkProfile, window[i]);
+			mDecodeCache[slot + i].operands = Operands(window[i]);
+		}
+		mFusions[slot] = fusion;
+	}
+}
+
+template<QuirkProfile Profile>
+uint32_t CHIP::ExecuteFusion(Fusion fusion, uint32_t cyclesLeft)
+{
+	const uint16_t address = mProgramCounter;
+	const CachedInstruction* slots = &mDecodeCache[address >> 1];
+	++mFusionsFired[static_cast<size_t>(fusion)];
+
+	switch (fusion)
+	{
+	case Fusion::LoadAndDraw:
+	{
+		OpCode_SetVxToNn(slots[0].operands);
+		OpCode_SetVxToNn(slots[1].operands);
+		OpCode_SetIndexRegister(slots[2].operands);
+		mProgramCounter = address + 8;
+		OpCode_Display<Profile>(slots[3].operands);
+		return 4;
+	}
+	case Fusion::WaitForDelay:
+	{
+		// The delay timer can't change while cycles are running, so the loop either falls straight through or spins for the whole budget
+		const uint8_t x = slots[0].operands.x;
+		mVariableRegisters[x] = mDelayTimer;
+		if (mDelayTimer == 0)
+		{
+			mProgramCounter = address + 6;
+			return 2;
+		}
+
+		mProgramCounter = address;
+		return cyclesLeft - cyclesLeft % 3;
+	}
+	case Fusion::CountedLoop:
+	{
+		// Iterate natively until VX hits the target, or the budget can't fit another pass
+		const uint8_t x = slots[0].operands.x;
+		const uint8_t step = slots[0].operands.nn;
+		const uint8_t target = slots[1].operands.nn;
+		uint8_t vx = mVariableRegisters[x];
+		uint32_t executed = 0;
+
+		while (cyclesLeft - executed >= 3)
+		{
+			vx += step;
+			if (vx == target)
+			{
+				mVariableRegisters[x] = vx;
+				mProgramCounter = address + 6;
+				return executed + 2;
+			}
+			executed += 3;
+		}
+
+		mVariableRegisters[x] = vx;
+		mProgramCounter = address;
+		return executed;
+	}
+	default:
+		break;
+	}
+
+	assert(false && "Unknown fusion.");
+	return 0;
+}
+
 uint16_t CHIP::Decode(uint16_t instruction)
 {
 	// Grab the first nibble and determine the opcode
@@ -171,9 +988,123 @@ uint16_t CHIP::Decode(uint16_t instruction)
 
 void CHIP::Execute(uint16_t opcode, uint16_t instruction)
 {
-	assert(mInstructions.contains(opcode), "Opcode not found in instruction set.");
+	assert(mInstructions.contains(opcode) && "Opcode not found in instruction set.");
 	auto& func = mInstructions.at(opcode);
-	func(instruction);
+	func(Operands(instruction));
+}
+
+CHIP::OpCodeHandler CHIP::LookupHandler(QuirkProfile profile, uint16_t instruction)
+{
+	switch (profile)
+	{
+	case QuirkProfile::CosmacVip: return LookupHandler<QuirkProfile::CosmacVip>(instruction);
+	case QuirkProfile::Chip48: return LookupHandler<QuirkProfile::Chip48>(instruction);
+	case QuirkProfile::SuperChip: return LookupHandler<QuirkProfile::SuperChip>(instruction);
+	case QuirkProfile::XoChip: return LookupHandler<QuirkProfile::XoChip>(instruction);
+	default: break;
+	}
+
+	assert(false && "Unknown quirk profile.");
+	return &CHIP::OpCode_Invalid;
+}
+
+template<QuirkProfile Profile>
+CHIP::OpCodeHandler CHIP::LookupHandler(uint16_t instruction)
+{
+	constexpr InstructionSet instructions = GetQuirks(Profile).instructions;
+	constexpr bool superChip = instructions != InstructionSet::Chip8;
+	constexpr bool xoChip = instructions == InstructionSet::XoChip;
+
+	// The first nibble picks the instruction family, only 0, 5, 8, E and F need to look any further.
+	// Compilers lower these dense switches to jump tables, so this is a couple of indexed loads.
+	switch (instruction >> 12)
+	{
+	case 0x0:
+		switch (instruction)
+		{
+		case 0x00E0: return &CHIP::OpCode_ClearScreen<Profile>;
+		case 0x00EE: return &CHIP::OpCode_PopSubroutine;
+		case 0x00FB: if constexpr (superChip) { return &CHIP::OpCode_ScrollRight<Profile>; } break;
+		case 0x00FC: if constexpr (superChip) { return &CHIP::OpCode_ScrollLeft<Profile>; } break;
+		case 0x00FD: if constexpr (superChip) { return &CHIP::OpCode_Exit; } break;
+		case 0x00FE: if constexpr (superChip) { return &CHIP::OpCode_LowResolution; } break;
+		case 0x00FF: if constexpr (superChip) { return &CHIP::OpCode_HighResolution; } break;
+		}
+		if ((instruction & 0xFFF0) == 0x00C0 && superChip)
+		{
+			return &CHIP::OpCode_ScrollDown<Profile>;
+		}
+		if ((instruction & 0xFFF0) == 0x00D0 && xoChip)
+		{
+			return &CHIP::OpCode_ScrollUp<Profile>;
+		}
+		break;
+	case 0x1: return &CHIP::OpCode_Jump;
+	case 0x2: return &CHIP::OpCode_PushSubroutine;
+	case 0x3: return &CHIP::OpCode_SkipIfVxNn<Profile>;
+	case 0x4: return &CHIP::OpCode_SkipIfVxNotNn<Profile>;
+	case 0x5:
+		if constexpr (xoChip)
+		{
+			switch (instruction & 0x000F)
+			{
+			case 0x2: return &CHIP::OpCode_StoreRange;
+			case 0x3: return &CHIP::OpCode_LoadRange;
+			}
+		}
+		return &CHIP::OpCode_SkipVxVyEqual<Profile>;
+	case 0x6: return &CHIP::OpCode_SetVxToNn;
+	case 0x7: return &CHIP::OpCode_AddNnToVx;
+	case 0x8:
+		switch (instruction & 0x000F)
+		{
+		case 0x0: return &CHIP::OpCode_Set;
+		case 0x1: return &CHIP::OpCode_BinaryOR<Profile>;
+		case 0x2: return &CHIP::OpCode_BinaryAND<Profile>;
+		case 0x3: return &CHIP::OpCode_LogicalXOR<Profile>;
+		case 0x4: return &CHIP::OpCode_AddWithCarry;
+		case 0x5: return &CHIP::OpCode_SubtractVyFromVx;
+		case 0x6: return &CHIP::OpCode_ShiftRight<Profile>;
+		case 0x7: return &CHIP::OpCode_SubtractVxfromVy;
+		case 0xE: return &CHIP::OpCode_ShiftLeft<Profile>;
+		}
+		break;
+	case 0x9: return &CHIP::OpCode_SkipVxVyNotEqual<Profile>;
+	case 0xA: return &CHIP::OpCode_SetIndexRegister;
+	case 0xB: return &CHIP::OpCode_JumpWithOffset<Profile>;
+	case 0xC: return &CHIP::OpCode_Random;
+	case 0xD: return &CHIP::OpCode_Display<Profile>;
+	case 0xE:
+		switch (instruction & 0x00FF)
+		{
+		case 0x9E: return &CHIP::OpCode_SkipIfKeyPressed<Profile>;
+		case 0xA1: return &CHIP::OpCode_SkipIfKeyNotPressed<Profile>;
+		}
+		break;
+	case 0xF:
+		switch (instruction & 0x00FF)
+		{
+		case 0x07: return &CHIP::OpCode_CacheDelayTimer;
+		case 0x0A: return &CHIP::OpCode_GetKey;
+		case 0x15: return &CHIP::OpCode_SetDelayTimer;
+		case 0x18: return &CHIP::OpCode_SetSoundTimer;
+		case 0x1E: return &CHIP::OpCode_AddToIndexRegister;
+		case 0x29: return &CHIP::OpCode_SetFontCharacter;
+		case 0x33: return &CHIP::OpCode_BinaryToDecimal;
+		case 0x55: return &CHIP::OpCode_StoreMemory<Profile>;
+		case 0x65: return &CHIP::OpCode_LoadMemory<Profile>;
+		case 0x30: if constexpr (superChip) { return &CHIP::OpCode_SetBigFontCharacter; } break;
+		case 0x75: if constexpr (superChip) { return &CHIP::OpCode_StoreFlags; } break;
+		case 0x85: if constexpr (superChip) { return &CHIP::OpCode_LoadFlags; } break;
+		case 0x00: if constexpr (xoChip) { if (instruction == 0xF000) { return &CHIP::OpCode_SetLongIndexRegister; } } break;
+		case 0x01: if constexpr (xoChip) { return &CHIP::OpCode_SelectPlanes; } break;
+		case 0x02: if constexpr (xoChip) { return &CHIP::OpCode_LoadAudioPattern; } break;
+		case 0x3A: if constexpr (xoChip) { return &CHIP::OpCode_SetPitch; } break;
+		}
+		break;
+	}
+
+	return &CHIP::OpCode_Invalid;
 }
 
 // Used to lookup the variable register at this position
@@ -203,240 +1134,260 @@ uint16_t GetNNN(uint16_t instruction)
 	return instruction & 0x0FFF;
 }
 
-std::string GetHexString(uint16_t num)
+Operands::Operands(uint16_t instruction)
+	: instruction(instruction)
+	, nnn(GetNNN(instruction))
+	, x(GetX(instruction))
+	, y(GetY(instruction))
+	, n(GetN(instruction))
+	, nn(GetNN(instruction))
 {
-	std::stringstream output;
-	output << std::hex << num;
-	return output.str();
 }
 
-
-#ifdef DEBUG
-void CHIP::DrawDebug()
+template<QuirkProfile Profile>
+void CHIP::OpCode_ClearScreen(const Operands& operands)
 {
-	ImGui::Begin("CHIP-8 Debug Controls");
-	ImGui::Text("Last Instruction: %s", GetHexString(mPreviousInstruction).c_str());
-	ImGui::Text("Next Instruction: %s", GetHexString(mNextInstruction).c_str());
-	if (ImGui::Button("Process Next Instruction"))
+	// This is pretty simple: It should clear the display, turning all pixels off to 0. XO-CHIP only clears the selected planes.
+	// Rows that were already blank don't need uploading again.
+	const uint8_t planes = GetSelectedPlanes<Profile>();
+	uint64_t clearedRows = 0;
+	for (size_t plane = 0; plane < gDisplayPlanes; ++plane)
 	{
-		Process();
-	}
-
-	ImGui::Checkbox("Pause Emulation", &mIsPaused);
-	ImGui::End();
-
-	if (mRomSize > 0)
-	{
-		const size_t bytesPerRow = 8;
-		ImGui::Begin("ROM Viewer");
-
-		// Loop through rows
-		for (int i = 0; i < mRomSize; ++i)
+		if ((planes >> plane & 1) == 0)
 		{
-			const size_t romIndex = mStartingProgramCounter + i;
-			const bool isCurrentPC = mProgramCounter == romIndex;
-			if (i % bytesPerRow != 0)
-			{
-				ImGui::SameLine();
-			}
-
-			if (isCurrentPC)
-				ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(0.0f, 1.0f, 0.0f, 1.0f));
-
-			ImGui::Text("%s", GetHexString(mMemory[romIndex]).c_str());
-
-			if (isCurrentPC)
-				ImGui::PopStyleColor();
+			continue;
 		}
 
-		// End ImGui window
-		ImGui::End();
+		for (uint8_t row = 0; row < gHiResDisplayHeight; ++row)
+		{
+			const uint64_t* words = &mDisplay[plane][row * gDisplayRowWords];
+			clearedRows |= static_cast<uint64_t>((words[0] | words[1]) != 0) << row;
+		}
+		mDisplay[plane].fill(0);
 	}
-}
-#endif
-
 
-void CHIP::OpCode_ClearScreen(uint16_t instruction)
-{
-	std::cout << "=== Opcode 00E0: Clear Screen ===" << std::endl;
-	// This is pretty simple: It should clear the display, turning all pixels off to 0.
-	std::fill(mDisplay.begin(), mDisplay.end(), 0);
+	MarkRowsDirty(clearedRows);
 }
 
-void CHIP::OpCode_Jump(uint16_t instruction)
+void CHIP::OpCode_Jump(const Operands& operands)
 {
 	// This instruction should simply set PC to NNN, causing the program to jump to that memory location. Do not increment the PC afterwards, it jumps directly there.
-	mProgramCounter = GetNNN(instruction);
+	mProgramCounter = operands.nnn;
 }
 
-void CHIP::OpCode_SetVxToNn(uint16_t instruction)
+void CHIP::OpCode_SetVxToNn(const Operands& operands)
 {
-	std::cout << "=== Opcode 6XNN: Set VX to NN ===" << std::endl;
 	// Simply set the register VX to the value NN.
-	mVariableRegisters[GetX(instruction)] = GetNN(instruction);
+	mVariableRegisters[operands.x] = operands.nn;
 }
 
-void CHIP::OpCode_SetIndexRegister(uint16_t instruction)
+void CHIP::OpCode_SetIndexRegister(const Operands& operands)
 {
-	std::cout << "=== Opcode ANNN: Set Index Register ===" << std::endl;
-	mIndexRegister = GetNNN(instruction);
+	mIndexRegister = operands.nnn;
 }
 
-void CHIP::OpCode_AddNnToVx(uint16_t instruction)
+void CHIP::OpCode_AddNnToVx(const Operands& operands)
 {
 	// Add the value NN to VX.
-	mVariableRegisters[GetX(instruction)] += GetNN(instruction);
+	mVariableRegisters[operands.x] += operands.nn;
 }
 
-void CHIP::OpCode_Display(uint16_t instruction)
+template<QuirkProfile Profile>
+void CHIP::OpCode_Display(const Operands& operands)
 {
-	std::cout << "=== Opcode DXYN: Display ===" << std::endl;
-
-	const uint8_t xPos = mVariableRegisters[GetX(instruction)] % DISPLAY_WIDTH;
-	const uint8_t yPos = mVariableRegisters[GetY(instruction)] % DISPLAY_HEIGHT;
-	const uint8_t n = GetN(instruction);
-
-	for (uint8_t row = 0; row < n; ++row)
+	constexpr Quirks quirks = GetQuirks(Profile);
+	const uint8_t xPos = mVariableRegisters[operands.x] % GetDisplayWidth();
+	const uint8_t yPos = mVariableRegisters[operands.y] % GetDisplayHeight();
+
+	// DXY0 draws a 16x16 sprite, two bytes per row, on SUPER-CHIP and XO-CHIP. Each selected plane takes the next
+	// sprite's worth of bytes from I.
+	const bool wide = quirks.instructions != InstructionSet::Chip8 && operands.n == 0;
+	const uint8_t rows = wide ? 16 : operands.n;
+	const uint16_t spriteSize = wide ? 32 : rows;
+	const uint8_t planes = GetSelectedPlanes<Profile>();
+
+	uint16_t address = mIndexRegister;
+	bool collided = false;
+	uint64_t touchedRows = 0;
+	for (size_t plane = 0; plane < gDisplayPlanes; ++plane)
 	{
-		for (uint8_t col = 0; col < 8; ++col)
+		if ((planes >> plane & 1) == 0)
 		{
-			//If the current pixel in the sprite row is on and the pixel at coordinates X,Y on the screen is also on, turn off the pixel and set VF to 1
-			const uint8_t spritePixel = mMemory[mIndexRegister + row] & (0b10000000 >> col);
-			uint32_t* displayPixel = &mDisplay[(yPos + row) * DISPLAY_WIDTH + xPos + col];
-
-			// If it's non-zero, this will flip the result to 0, and then flip it again to 1; then negate it as -1 equates to 0xFFFFFFFF
-			const uint32_t spriteMask = -!!spritePixel;
-
-			// collision will either be 0x00000000 if either pixels are off, or 0xFFFFFFFF if both pixels are on
-			const uint32_t collision = spriteMask & *displayPixel;
-			
-			// by shifting collision to the right, we end up with 1 bit that is either 0 or 1
-			const uint8_t bothPixelsOn = (collision >> 31) & 1;
-
-			// Bitwise OR'ing it means VF will be set to 1 if VF is currently zero
-			mVariableRegisters[0xF] |= bothPixelsOn;
+			continue;
+		}
 
-			*displayPixel ^= spriteMask;
+		// Sprites running off the end of memory carry on from the start, like I does
+		const uint8_t* sprite = &mMemory[address];
+		std::array<uint8_t, 32> wrapped;
+		if (address + spriteSize > mMemory.size())
+		{
+			for (uint16_t i = 0; i < spriteSize; ++i)
+			{
+				wrapped[i] = mMemory[static_cast<uint16_t>(address + i)];
+			}
+			sprite = wrapped.data();
 		}
+
+		touchedRows |= DrawSprite(mDisplay[plane], mHighResolution, xPos, yPos, sprite, rows, wide, quirks.wrapsSprites, collided);
+		address += spriteSize;
 	}
+
+	// SUPER-CHIP 1.1 counted colliding rows in high resolution, like Octo this only ever sets VF to 1
+	mVariableRegisters[0xF] = collided;
+	MarkRowsDirty(touchedRows);
 }
 
-void CHIP::OpCode_PushSubroutine(uint16_t instruction)
+void CHIP::OpCode_PushSubroutine(const Operands& operands)
 {
 	// 2NNN calls the subroutine at memory location NNN. In other words, just like 1NNN, you should set PC to NNN. 
 	// However, the difference between a jump and a call is that this instruction should first push the current PC to the stack, so the subroutine can return later.
-	mAddressStack.push(mProgramCounter);
-	mProgramCounter = GetNNN(instruction);
+	// Recursing deeper than the stack is a bug in the ROM. Like 00FD the program stays on this instruction rather than
+	// writing past the stack.
+	if (mStackSize >= mAddressStack.size())
+	{
+		mProgramCounter -= 2;
+		return;
+	}
+	mAddressStack[mStackSize++] = mProgramCounter;
+	mProgramCounter = operands.nnn;
 }
 
-void CHIP::OpCode_PopSubroutine(uint16_t instruction)
+void CHIP::OpCode_PopSubroutine(const Operands& operands)
 {
 	// Returning from a subroutine is done with 00EE, and it does this by removing (popping) the last address from the stack and setting the PC to it.
-	mProgramCounter = mAddressStack.top();
-	mAddressStack.pop();
+	// So does returning with nothing to return to
+	if (mStackSize == 0)
+	{
+		mProgramCounter -= 2;
+		return;
+	}
+	mProgramCounter = mAddressStack[--mStackSize];
 }
 
-void CHIP::OpCode_SkipIfVxNn(uint16_t instruction)
+template<QuirkProfile Profile>
+void CHIP::OpCode_SkipIfVxNn(const Operands& operands)
 {
 	// 3XNN will skip one instruction if the value in VX is equal to NN
-	const uint8_t vx = mVariableRegisters[GetX(instruction)];
-	if (vx == GetNN(instruction))
+	const uint8_t vx = mVariableRegisters[operands.x];
+	if (vx == operands.nn)
 	{
-		mProgramCounter += 2;
+		SkipInstruction<Profile>();
 	}
 }
 
-void CHIP::OpCode_SkipIfVxNotNn(uint16_t instruction)
+template<QuirkProfile Profile>
+void CHIP::OpCode_SkipIfVxNotNn(const Operands& operands)
 {
 	// 4XNN will skip one instruction if the value in VX is NOT equal to NN
-	const uint8_t vx = mVariableRegisters[GetX(instruction)];
-	if (vx != GetNN(instruction))
+	const uint8_t vx = mVariableRegisters[operands.x];
+	if (vx != operands.nn)
 	{
-		mProgramCounter += 2;
+		SkipInstruction<Profile>();
 	}
 }
 
-void CHIP::OpCode_SkipVxVyEqual(uint16_t instruction)
+template<QuirkProfile Profile>
+void CHIP::OpCode_SkipVxVyEqual(const Operands& operands)
 {
 	// 5XY0 skips if the values in VX and VY are equal
-	const uint8_t vx = mVariableRegisters[GetX(instruction)];
-	const uint8_t vy = mVariableRegisters[GetY(instruction)];
+	const uint8_t vx = mVariableRegisters[operands.x];
+	const uint8_t vy = mVariableRegisters[operands.y];
 	if (vx == vy)
 	{
-		mProgramCounter += 2;
+		SkipInstruction<Profile>();
 	}
 }
 
-void CHIP::OpCode_SkipVxVyNotEqual(uint16_t instruction)
+template<QuirkProfile Profile>
+void CHIP::OpCode_SkipVxVyNotEqual(const Operands& operands)
 {
 	// 9XY0 skips if the values in VX and VY are not equal
-	const uint8_t vx = mVariableRegisters[GetX(instruction)];
-	const uint8_t vy = mVariableRegisters[GetY(instruction)];
+	const uint8_t vx = mVariableRegisters[operands.x];
+	const uint8_t vy = mVariableRegisters[operands.y];
 	if (vx != vy)
 	{
-		mProgramCounter += 2;
+		SkipInstruction<Profile>();
 	}
 }
 
-void CHIP::OpCode_Add(uint16_t instruction)
+void CHIP::OpCode_Add(const Operands& operands)
 {
 	// Add the value NN to VX.
-	mVariableRegisters[GetX(instruction)] = GetNN(instruction);
+	mVariableRegisters[operands.x] = operands.nn;
 }
 
-void CHIP::OpCode_JumpWithOffset(uint16_t instruction)
+template<QuirkProfile Profile>
+void CHIP::OpCode_JumpWithOffset(const Operands& operands)
 {
-	// TODO: Ambiguous instruction, add support for toggling quirk
-	mProgramCounter = GetNNN(instruction) + mVariableRegisters[0];
+	// BNNN jumps to NNN plus V0. CHIP-48 misread it as BXNN, adding VX where X is the top nibble of NNN.
+	const uint8_t offset = GetQuirks(Profile).jumpsWithVx ? operands.x : 0;
+	mProgramCounter = operands.nnn + mVariableRegisters[offset];
 }
 
-void CHIP::OpCode_Random(uint16_t instruction)
+void CHIP::OpCode_Random(const Operands& operands)
 {
 	// This instruction generates a random number, binary ANDs it with the value NN, and puts the result in VX.
-	std::random_device rd;  // a seed source for the random number engine
-	std::mt19937 gen(rd()); // mersenne_twister_engine seeded with rd()
-
-	const uint8_t randomNumber = gen();
-	mVariableRegisters[GetX(instruction)] = randomNumber & GetNN(instruction);;
+	mVariableRegisters[operands.x] = mRandom.NextByte() & operands.nn;
 }
 
-void CHIP::OpCode_Set(uint16_t instruction)
+void CHIP::OpCode_Set(const Operands& operands)
 {
 	// VX is set to the value of VY.
-	mVariableRegisters[GetX(instruction)] = mVariableRegisters[GetY(instruction)];
+	mVariableRegisters[operands.x] = mVariableRegisters[operands.y];
 }
 
-void CHIP::OpCode_BinaryOR(uint16_t instruction)
+template<QuirkProfile Profile>
+void CHIP::OpCode_BinaryOR(const Operands& operands)
 {
 	// VX is set to the bitwise/binary logical disjunction (OR) of VX and VY. VY is not affected.
-	const uint8_t vx = mVariableRegisters[GetX(instruction)];
-	const uint8_t vy = mVariableRegisters[GetY(instruction)];
-	mVariableRegisters[GetX(instruction)] = vx | vy;
+	const uint8_t vx = mVariableRegisters[operands.x];
+	const uint8_t vy = mVariableRegisters[operands.y];
+	mVariableRegisters[operands.x] = vx | vy;
+
+	// The COSMAC VIP ran these through an ALU routine that left VF clobbered
+	if constexpr (GetQuirks(Profile).resetsFlag)
+	{
+		mVariableRegisters[0xF] = 0;
+	}
 }
 
-void CHIP::OpCode_BinaryAND(uint16_t instruction)
+template<QuirkProfile Profile>
+void CHIP::OpCode_BinaryAND(const Operands& operands)
 {
 	// VX is set to the bitwise/binary logical conjunction (AND) of VX and VY. VY is not affected.
-	const uint8_t vx = mVariableRegisters[GetX(instruction)];
-	const uint8_t vy = mVariableRegisters[GetY(instruction)];
-	mVariableRegisters[GetX(instruction)] = vx & vy;
+	const uint8_t vx = mVariableRegisters[operands.x];
+	const uint8_t vy = mVariableRegisters[operands.y];
+	mVariableRegisters[operands.x] = vx & vy;
+
+	// The COSMAC VIP ran these through an ALU routine that left VF clobbered
+	if constexpr (GetQuirks(Profile).resetsFlag)
+	{
+		mVariableRegisters[0xF] = 0;
+	}
 }
 
-void CHIP::OpCode_LogicalXOR(uint16_t instruction)
+template<QuirkProfile Profile>
+void CHIP::OpCode_LogicalXOR(const Operands& operands)
 {
 	// VX is set to the bitwise/binary exclusive OR (XOR) of VX and VY. VY is not affected.
-	const uint8_t vx = mVariableRegisters[GetX(instruction)];
-	const uint8_t vy = mVariableRegisters[GetY(instruction)];
-	mVariableRegisters[GetX(instruction)] = vx ^ vy;
+	const uint8_t vx = mVariableRegisters[operands.x];
+	const uint8_t vy = mVariableRegisters[operands.y];
+	mVariableRegisters[operands.x] = vx ^ vy;
+
+	// The COSMAC VIP ran these through an ALU routine that left VF clobbered
+	if constexpr (GetQuirks(Profile).resetsFlag)
+	{
+		mVariableRegisters[0xF] = 0;
+	}
 }
 
-void CHIP::OpCode_AddWithCarry(uint16_t instruction)
+void CHIP::OpCode_AddWithCarry(const Operands& operands)
 {
 	// TODO: Remove conditional
 	// VX is set to the value of VX plus the value of VY. VY is not affected.
-	const uint8_t vx = mVariableRegisters[GetX(instruction)];
-	const uint8_t vy = mVariableRegisters[GetY(instruction)];
-	mVariableRegisters[GetX(instruction)] = vx + vy;
+	const uint8_t vx = mVariableRegisters[operands.x];
+	const uint8_t vy = mVariableRegisters[operands.y];
+	mVariableRegisters[operands.x] = vx + vy;
 
 	// Unlike 7XNN, this addition will affect the carry flag.
 	// If the result is larger than 255 (and thus overflows the 8-bit register VX), the flag register VF is set to 1.
@@ -444,12 +1395,12 @@ void CHIP::OpCode_AddWithCarry(uint16_t instruction)
 	mVariableRegisters[0xF] = vx + vy > 255 ? 1 : 0;
 }
 
-void CHIP::OpCode_SubtractVyFromVx(uint16_t instruction)
+void CHIP::OpCode_SubtractVyFromVx(const Operands& operands)
 {
 	// 8XY5 sets VX to the result of VX - VY.
-	const uint8_t vx = mVariableRegisters[GetX(instruction)];
-	const uint8_t vy = mVariableRegisters[GetY(instruction)];
-	mVariableRegisters[GetX(instruction)] = vx - vy;
+	const uint8_t vx = mVariableRegisters[operands.x];
+	const uint8_t vy = mVariableRegisters[operands.y];
+	mVariableRegisters[operands.x] = vx - vy;
 
 	//This subtraction will also affect the carry flag, but note that its opposite from what you might think.
 	// If the minuend (the first operand) is larger than the subtrahend (second operand), VF will be set to 1.
@@ -458,12 +1409,12 @@ void CHIP::OpCode_SubtractVyFromVx(uint16_t instruction)
 	mVariableRegisters[0xF] = vx > vy ? 1 : 0;
 }
 
-void CHIP::OpCode_SubtractVxfromVy(uint16_t instruction)
+void CHIP::OpCode_SubtractVxfromVy(const Operands& operands)
 {
 	// 8XY5 sets VX to the result of VY - VX.
-	const uint8_t vx = mVariableRegisters[GetX(instruction)];
-	const uint8_t vy = mVariableRegisters[GetY(instruction)];
-	mVariableRegisters[GetX(instruction)] = vy - vx;
+	const uint8_t vx = mVariableRegisters[operands.x];
+	const uint8_t vy = mVariableRegisters[operands.y];
+	mVariableRegisters[operands.x] = vy - vx;
 
 	//This subtraction will also affect the carry flag, but note that its opposite from what you might think.
 	// If the minuend (the first operand) is larger than the subtrahend (second operand), VF will be set to 1.
@@ -472,62 +1423,62 @@ void CHIP::OpCode_SubtractVxfromVy(uint16_t instruction)
 	mVariableRegisters[0xF] = vy > vx ? 1 : 0;
 }
 
-void CHIP::OpCode_ShiftRight(uint16_t instruction)
+template<QuirkProfile Profile>
+void CHIP::OpCode_ShiftRight(const Operands& operands)
 {
-	// TODO: Ambiguous instruction, add support for toggling quirk
-	const bool setVX = true;
-	if (setVX)
+	// The COSMAC VIP shifted VY into VX, CHIP-48 and SUPER-CHIP shift VX in place and ignore Y
+	if constexpr (GetQuirks(Profile).shiftsVy)
 	{
-		mVariableRegisters[GetX(instruction)] = mVariableRegisters[GetY(instruction)];
+		mVariableRegisters[operands.x] = mVariableRegisters[operands.y];
 	}
 
-	const uint8_t vx = mVariableRegisters[GetX(instruction)];
+	const uint8_t vx = mVariableRegisters[operands.x];
 
 	mVariableRegisters[0xF] = vx & 0b00000001;
-	mVariableRegisters[GetX(instruction)] >>= 1;
+	mVariableRegisters[operands.x] >>= 1;
 }
 
-void CHIP::OpCode_ShiftLeft(uint16_t instruction)
+template<QuirkProfile Profile>
+void CHIP::OpCode_ShiftLeft(const Operands& operands)
 {
-	// TODO: Ambiguous instruction, add support for toggling quirk
-	const bool setVX = true;
-	if (setVX)
+	// The COSMAC VIP shifted VY into VX, CHIP-48 and SUPER-CHIP shift VX in place and ignore Y
+	if constexpr (GetQuirks(Profile).shiftsVy)
 	{
-		mVariableRegisters[GetX(instruction)] = mVariableRegisters[GetY(instruction)];
+		mVariableRegisters[operands.x] = mVariableRegisters[operands.y];
 	}
 
-	const uint8_t vx = mVariableRegisters[GetX(instruction)];
+	const uint8_t vx = mVariableRegisters[operands.x];
 
 	mVariableRegisters[0xF] = vx & 0b10000000;
-	mVariableRegisters[GetX(instruction)] <<= 1;
+	mVariableRegisters[operands.x] <<= 1;
 }
 
-void CHIP::OpCode_CacheDelayTimer(uint16_t instruction)
+void CHIP::OpCode_CacheDelayTimer(const Operands& operands)
 {
 	// FX07 sets VX to the current value of the delay timer
-	mVariableRegisters[GetX(instruction)] = mDelayTimer;
+	mVariableRegisters[operands.x] = mDelayTimer;
 }
 
-void CHIP::OpCode_SetDelayTimer(uint16_t instruction)
+void CHIP::OpCode_SetDelayTimer(const Operands& operands)
 {
 	// FX15 sets the delay timer to the value in VX
-	mDelayTimer = mVariableRegisters[GetX(instruction)];
+	mDelayTimer = mVariableRegisters[operands.x];
 }
 
-void CHIP::OpCode_SetSoundTimer(uint16_t instruction)
+void CHIP::OpCode_SetSoundTimer(const Operands& operands)
 {
 	// FX18 sets the sound timer to the value in VX
-	mSoundTimer = mVariableRegisters[GetX(instruction)];
+	mSoundTimer = mVariableRegisters[operands.x];
 }
 
-void CHIP::OpCode_AddToIndexRegister(uint16_t instruction)
+void CHIP::OpCode_AddToIndexRegister(const Operands& operands)
 {
 	// The index register I will get the value in VX added to it.
-	// TODO: Handle overflow for Spaceflight 2091!
-	mIndexRegister += mVariableRegisters[GetX(instruction)];
+	// TODO: Handle overflow for Spaceflight 2091! None of the quirk profiles set VF here, only the Amiga interpreter did.
+	mIndexRegister += mVariableRegisters[operands.x];
 }
 
-void CHIP::OpCode_GetKey(uint16_t instruction)
+void CHIP::OpCode_GetKey(const Operands& operands)
 {
 	// This opcode will wait for a key to be pressed before incrementing the program counter
 	// As we already incremented the program counter in the Fetch step, we decrement it here first.
@@ -539,67 +1490,253 @@ void CHIP::OpCode_GetKey(uint16_t instruction)
 		if (mKeypad[i])
 		{
 			mProgramCounter += 2;
-			mVariableRegisters[GetX(instruction)] = i;
+			mVariableRegisters[operands.x] = i;
 		}
 	}
 }
 
-void CHIP::OpCode_SetFontCharacter(uint16_t instruction)
+void CHIP::OpCode_SetFontCharacter(const Operands& operands)
 {
 	// The index register I is set to the address of the hexadecimal character in VX.
-	const uint8_t fontIndex = mVariableRegisters[GetX(instruction)] * gDefaultFontHeight;
+	const uint8_t fontIndex = mVariableRegisters[operands.x] * gDefaultFontHeight;
 
 	mIndexRegister = mMemory[gDefaultFontStartAddress + fontIndex];
 }
 
-void CHIP::OpCode_BinaryToDecimal(uint16_t instruction)
+void CHIP::OpCode_BinaryToDecimal(const Operands& operands)
 {
 	// Takes the number in vx and converts it to three decimal digits, storing these digits in memory at the mIndexRegister.
-	uint8_t input = mVariableRegisters[GetX(instruction)];
+	uint8_t input = mVariableRegisters[operands.x];
 	uint8_t memIndex = mIndexRegister;
 
 	while (input > 0)
 	{
 		const uint8_t digit = input % 10;
-		mMemory[memIndex] = digit;
+		WriteMemory(memIndex, digit);
 
 		++memIndex;
 		input /= 10;
 	}
 }
 
-void CHIP::OpCode_StoreMemory(uint16_t instruction)
+template<QuirkProfile Profile>
+void CHIP::OpCode_StoreMemory(const Operands& operands)
+{
+	for (int i = 0; i <= operands.x; ++i)
+	{
+		WriteMemory(mIndexRegister + i, mVariableRegisters[i]);
+	}
+	AdvanceIndexRegister<Profile>(operands.x);
+}
+
+template<QuirkProfile Profile>
+void CHIP::OpCode_LoadMemory(const Operands& operands)
 {
-	for (int i = 0; i <= GetX(instruction); ++i)
+	for (int i = 0; i <= operands.x; ++i)
 	{
-		mMemory[mIndexRegister + i] = mVariableRegisters[i];
+		mVariableRegisters[i] = mMemory[static_cast<uint16_t>(mIndexRegister + i)];
 	}
+	AdvanceIndexRegister<Profile>(operands.x);
 }
 
-void CHIP::OpCode_LoadMemory(uint16_t instruction)
+template<QuirkProfile Profile>
+void CHIP::AdvanceIndexRegister(uint8_t x)
 {
-	for (int i = 0; i <= GetX(instruction); ++i)
+	// The COSMAC VIP walked I along as it copied, CHIP-48 was off by one and SUPER-CHIP 1.1 stopped moving it at all
+	constexpr IndexIncrement increment = GetQuirks(Profile).indexIncrement;
+	if constexpr (increment == IndexIncrement::X)
 	{
-		mVariableRegisters[i] = mMemory[mIndexRegister + i];
+		mIndexRegister += x;
+	}
+	else if constexpr (increment == IndexIncrement::XPlusOne)
+	{
+		mIndexRegister += x + 1;
 	}
 }
 
-void CHIP::OpCode_SkipIfKeyPressed(uint16_t instruction)
+template<QuirkProfile Profile>
+void CHIP::OpCode_SkipIfKeyPressed(const Operands& operands)
 {
 	// EX9E will skip one instruction (increment PC by 2) if the key corresponding to the value in VX is pressed.
-	const uint8_t key = mVariableRegisters[GetX(instruction)];
+	const uint8_t key = mVariableRegisters[operands.x];
 	if (mKeypad[key])
 	{
-		mProgramCounter += 2;
+		SkipInstruction<Profile>();
 	}
 }
 
-void CHIP::OpCode_SkipIfKeyNotPressed(uint16_t instruction)
+template<QuirkProfile Profile>
+void CHIP::OpCode_SkipIfKeyNotPressed(const Operands& operands)
 {
 	// EXA1 skips if the key corresponding to the value in VX is not pressed.
-	const uint8_t key = mVariableRegisters[GetX(instruction)];
+	const uint8_t key = mVariableRegisters[operands.x];
 	if (!mKeypad[key])
 	{
-		mProgramCounter += 2;
+		SkipInstruction<Profile>();
+	}
+}
+
+template<QuirkProfile Profile>
+void CHIP::OpCode_ScrollDown(const Operands& operands)
+{
+	// 00CN moves the selected planes down N pixels of the current resolution
+	const uint8_t planes = GetSelectedPlanes<Profile>();
+	uint64_t scrolledRows = 0;
+	for (size_t plane = 0; plane < gDisplayPlanes; ++plane)
+	{
+		if (planes >> plane & 1)
+		{
+			scrolledRows |= ScrollDown(mDisplay[plane], mHighResolution, operands.n);
+		}
+	}
+	MarkRowsDirty(scrolledRows);
+}
+
+template<QuirkProfile Profile>
+void CHIP::OpCode_ScrollUp(const Operands& operands)
+{
+	// 00DN is XO-CHIP's counterpart to 00CN
+	const uint8_t planes = GetSelectedPlanes<Profile>();
+	uint64_t scrolledRows = 0;
+	for (size_t plane = 0; plane < gDisplayPlanes; ++plane)
+	{
+		if (planes >> plane & 1)
+		{
+			scrolledRows |= ScrollUp(mDisplay[plane], mHighResolution, operands.n);
+		}
+	}
+	MarkRowsDirty(scrolledRows);
+}
+
+template<QuirkProfile Profile>
+void CHIP::OpCode_ScrollRight(const Operands& operands)
+{
+	// 00FB moves the selected planes 4 pixels right
+	const uint8_t planes = GetSelectedPlanes<Profile>();
+	uint64_t scrolledRows = 0;
+	for (size_t plane = 0; plane < gDisplayPlanes; ++plane)
+	{
+		if (planes >> plane & 1)
+		{
+			scrolledRows |= ScrollRight(mDisplay[plane], mHighResolution, 4);
+		}
+	}
+	MarkRowsDirty(scrolledRows);
+}
+
+template<QuirkProfile Profile>
+void CHIP::OpCode_ScrollLeft(const Operands& operands)
+{
+	// 00FC moves the selected planes 4 pixels left
+	const uint8_t planes = GetSelectedPlanes<Profile>();
+	uint64_t scrolledRows = 0;
+	for (size_t plane = 0; plane < gDisplayPlanes; ++plane)
+	{
+		if (planes >> plane & 1)
+		{
+			scrolledRows |= ScrollLeft(mDisplay[plane], mHighResolution, 4);
+		}
+	}
+	MarkRowsDirty(scrolledRows);
+}
+
+void CHIP::OpCode_Exit(const Operands& operands)
+{
+	// 00FD quit back to the HP 48. There's nothing to return to here, so the program just stays on this instruction.
+	mProgramCounter -= 2;
+}
+
+void CHIP::OpCode_LowResolution(const Operands& operands)
+{
+	// 00FE and 00FF switch resolution. Octo clears the display when they do, which every ROM written against it expects.
+	mHighResolution = false;
+	for (DisplayPlane& plane : mDisplay)
+	{
+		plane.fill(0);
+	}
+	MarkRowsDirty(gAllDisplayRows);
+}
+
+void CHIP::OpCode_HighResolution(const Operands& operands)
+{
+	mHighResolution = true;
+	for (DisplayPlane& plane : mDisplay)
+	{
+		plane.fill(0);
+	}
+	MarkRowsDirty(gAllDisplayRows);
+}
+
+void CHIP::OpCode_SetBigFontCharacter(const Operands& operands)
+{
+	// FX30 points I at the 8x10 digit in VX
+	mIndexRegister = gBigFontStartAddress + (mVariableRegisters[operands.x] & 0xF) * gBigFontHeight;
+}
+
+void CHIP::OpCode_StoreFlags(const Operands& operands)
+{
+	// FX75 saves V0 to VX in the calculator's flag registers, which outlive the program
+	std::copy_n(mVariableRegisters.begin(), operands.x + 1, mFlagRegisters.begin());
+}
+
+void CHIP::OpCode_LoadFlags(const Operands& operands)
+{
+	// FX85 reads them back into V0 to VX
+	std::copy_n(mFlagRegisters.begin(), operands.x + 1, mVariableRegisters.begin());
+}
+
+void CHIP::OpCode_StoreRange(const Operands& operands)
+{
+	// 5XY2 saves VX to VY, which may count down, to memory at I. Unlike FX55, I stays where it is.
+	const int step = operands.x <= operands.y ? 1 : -1;
+	const int count = std::abs(operands.y - operands.x) + 1;
+	for (int i = 0; i < count; ++i)
+	{
+		WriteMemory(static_cast<uint16_t>(mIndexRegister + i), mVariableRegisters[operands.x + i * step]);
 	}
+}
+
+void CHIP::OpCode_LoadRange(const Operands& operands)
+{
+	// 5XY3 loads VX to VY back from memory at I
+	const int step = operands.x <= operands.y ? 1 : -1;
+	const int count = std::abs(operands.y - operands.x) + 1;
+	for (int i = 0; i < count; ++i)
+	{
+		mVariableRegisters[operands.x + i * step] = mMemory[static_cast<uint16_t>(mIndexRegister + i)];
+	}
+}
+
+void CHIP::OpCode_SetLongIndexRegister(const Operands& operands)
+{
+	// F000 NNNN loads I from the 16-bit word after it, the only four byte instruction
+	mIndexRegister = (static_cast<uint16_t>(mMemory[mProgramCounter]) << 8) | mMemory[static_cast<uint16_t>(mProgramCounter + 1)];
+	mProgramCounter += 2;
+}
+
+void CHIP::OpCode_SelectPlanes(const Operands& operands)
+{
+	// FN01 picks which planes drawing, clearing and scrolling affect, N is a bitmask
+	mPlaneMask = operands.x & 0x3;
+}
+
+void CHIP::OpCode_LoadAudioPattern(const Operands& operands)
+{
+	// F002 loads the 128 1-bit samples played while the sound timer runs from memory at I
+	for (size_t i = 0; i < mAudioPattern.size(); ++i)
+	{
+		mAudioPattern[i] = mMemory[static_cast<uint16_t>(mIndexRegister + i)];
+	}
+}
+
+void CHIP::OpCode_SetPitch(const Operands& operands)
+{
+	// FX3A sets the pattern's playback rate, 4000 * 2 ^ ((VX - 64) / 48) samples per second
+	mPitch = mVariableRegisters[operands.x];
+}
+
+void CHIP::OpCode_Invalid(const Operands& operands)
+{
+	// Anything LookupHandler() doesn't recognise ends up here, e.g. 0NNN machine code routines
+	assert(false && "Opcode not found in instruction set.");
 }
\ No newline at end of file
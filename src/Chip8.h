@@ -1,21 +1,175 @@
 #pragma once
 
 #include <map>
+#include <unordered_map>
 #include <array>
-#include <stack>
+#include <bitset>
+#include <cstdint>
 #include <functional>
+#include <memory>
+#include <vector>
 
+#include "Audio.h"
+#include "Capture.h"
+#include "Framebuffer.h"
+#include "Jit.h"
+#include "Profiler.h"
+#include "Random.h"
+#include "Trace.h"
 
-constexpr uint8_t DISPLAY_WIDTH = 64;
-constexpr uint8_t DISPLAY_HEIGHT = 32;
+
+// Timers tick and frames are scheduled at this rate
+constexpr uint32_t gFrameRate = 60;
+// Most frames Update() will run to catch up with wall-clock time
+constexpr uint32_t gMaxCatchUpFrames = 4;
+// Samples RunFrame() renders per frame while an audio output is set
+constexpr size_t gAudioFrameSamples = gAudioSampleRate / gFrameRate;
+static_assert(gAudioSampleRate % gFrameRate == 0, "Every frame renders the same number of samples");
+
+// Hex digit sprites every machine starts with in memory
+extern const std::array<uint8_t, 80> gDefaultFont;
+constexpr uint8_t gDefaultFontStartAddress = 0x50;
+constexpr uint8_t gDefaultFontHeight = 5;
+// SUPER-CHIP's 8x10 digits for FX30, XO-CHIP adds A-F, stored right after the small font
+extern const std::array<uint8_t, 160> gBigFont;
+constexpr uint8_t gBigFontStartAddress = gDefaultFontStartAddress + sizeof(gDefaultFont);
+constexpr uint8_t gBigFontHeight = 10;
+
+// XO-CHIP's 64 KB address space. The other profiles only reach the first 4 KB through ANNN, but I can still be walked past it.
+constexpr size_t gMemorySize = 0x10000;
+// Decoded slots, fusions and compiled blocks only cover the first 4 KB, where every profile but XO-CHIP has to keep its
+// code and XO-CHIP programs keep theirs in practice. Anything above is decoded every time it runs.
+constexpr size_t gCachedCodeSize = 0x1000;
+
+// Programs are loaded at 0x200 and can fill the rest of memory
+constexpr size_t gMaxRomSize = gMemorySize - 0x200;
+
+// Nested subroutine calls 2NNN can make before 00EE has to unwind them
+constexpr size_t gStackDepth = 16;
+
+// Memory is tracked in pages of this size for rewinding, one bit per page
+constexpr size_t gMemoryPageSize = 256;
+using MemoryPages = std::bitset<gMemorySize / gMemoryPageSize>;
+
+// Fixed-layout snapshot of a CHIP, see SaveState.h
+struct MachineState;
+struct CpuState;
+class RewindBuffer;
+
+// Selects how Process() gets from a fetched instruction to its OpCode_* handler
+enum class ExecutionEngine : uint8_t
+{
+	HashMap,	// Original engine: opcode mask lookup, then a std::function lookup, kept for comparison
+	Switch,		// Switches on the instruction nibbles straight to the member function
+	Predecoded,	// Caches the handler and operands per address, only decoding on first visit or after a write
+	Jit,		// Recompiles guest basic blocks to x86-64, falling back to Predecoded for anything it can't translate
+};
+
+// Accepts the lowercase engine names used on the command line (hashmap, switch, predecoded, jit)
+bool ParseExecutionEngine(const char* name, ExecutionEngine& engine);
+
+// The interpreters CHIP-8 ROMs were written against disagree on a handful of instructions. Each profile is a template
+// argument of the interpreter loops, so its choices are folded in at compile time, see CHIP::RunCycles().
+enum class QuirkProfile : uint8_t
+{
+	CosmacVip,	// The original interpreter on the RCA COSMAC VIP
+	Chip48,		// CHIP-48 on the HP 48 calculators
+	SuperChip,	// SUPER-CHIP 1.1, also on the HP 48
+	XoChip,		// Octo's XO-CHIP
+	Count,
+};
+
+// Accepts the lowercase profile names used on the command line (vip, chip48, schip, xochip)
+bool ParseQuirkProfile(const char* name, QuirkProfile& profile);
+const char* GetQuirkProfileName(QuirkProfile profile);
+
+// How far FX55 and FX65 leave the index register past its starting point
+enum class IndexIncrement : uint8_t
+{
+	None,		// I is left alone
+	X,			// I += X
+	XPlusOne,	// I += X + 1, pointing right after the last register
+};
+
+// Instructions a profile understands on top of the original CHIP-8 ones, anything else is invalid
+enum class InstructionSet : uint8_t
+{
+	Chip8,
+	SuperChip,	// 00CN, 00FB-00FF scrolling and resolution switches, 16x16 DXY0 sprites, FX30 big digits, FX75/FX85 flags
+	XoChip,		// SUPER-CHIP's plus 00DN, 5XY2/5XY3, F000 NNNN, FN01 bit-planes and F002/FX3A audio
+};
+
+struct Quirks
+{
+	bool resetsFlag = false;		// 8XY1, 8XY2 and 8XY3 clear VF
+	bool shiftsVy = false;			// 8XY6 and 8XYE shift VY into VX, rather than shifting VX in place
+	bool jumpsWithVx = false;		// BXNN jumps to XNN + VX, rather than BNNN to NNN + V0
+	IndexIncrement indexIncrement = IndexIncrement::None;
+	bool wrapsSprites = false;		// DXYN wraps pixels past the edges around, rather than clipping them
+	InstructionSet instructions = InstructionSet::Chip8;
+};
+
+constexpr Quirks GetQuirks(QuirkProfile profile)
+{
+	switch (profile)
+	{
+	case QuirkProfile::CosmacVip: return { .resetsFlag = true, .shiftsVy = true, .indexIncrement = IndexIncrement::XPlusOne };
+	case QuirkProfile::Chip48: return { .jumpsWithVx = true, .indexIncrement = IndexIncrement::X };
+	case QuirkProfile::SuperChip: return { .jumpsWithVx = true, .instructions = InstructionSet::SuperChip };
+	case QuirkProfile::XoChip: return { .shiftsVy = true, .indexIncrement = IndexIncrement::XPlusOne, .wrapsSprites = true, .instructions = InstructionSet::XoChip };
+	default: return {};
+	}
+}
+
+// Common instruction idioms the Predecoded engine executes as a single step, see CHIP::FuseSuperinstructions()
+enum class Fusion : uint8_t
+{
+	None,
+	LoadAndDraw,	// 6XNN; 6YNN; ANNN; DXYN
+	WaitForDelay,	// FX07; 3X00; 1NNN back to the FX07
+	CountedLoop,	// 7XNN; 3XNN; 1NNN back to the 7XNN
+	Count,
+};
+
+// An instruction with its operand fields already pulled out, so handlers never have to re-mask the raw value
+struct Operands
+{
+	Operands() = default;
+	explicit Operands(uint16_t instruction);
+
+	uint16_t instruction = 0;
+	uint16_t nnn = 0;
+	uint8_t x = 0;
+	uint8_t y = 0;
+	uint8_t n = 0;
+	uint8_t nn = 0;
+};
+
+// A key going down or up at a point of the emulated timeline, see CHIP::QueueKeyEvent()
+struct KeyEvent
+{
+	uint64_t cycle = 0;
+	uint8_t key = 0;
+	bool pressed = false;
+};
 
 class CHIP {
 public:
 	CHIP();
+	~CHIP();
 
-	void LoadROM(const char* romPath, uint16_t cyclesPerSecond = 700);
+	// The quirk profile is part of the ROM's identity, it stays fixed until the next LoadROM() (or LoadState()).
+	// Returns false, leaving the machine alone, if the file can't be read or doesn't fit in memory above 0x200.
+	bool LoadROM(const char* romPath, uint16_t cyclesPerSecond = 700, QuirkProfile quirks = QuirkProfile::CosmacVip);
+	// Same, from a ROM image that's already in memory, e.g. mapped by a RomLibrary
+	bool LoadROM(const uint8_t* rom, size_t size, uint16_t cyclesPerSecond = 700, QuirkProfile quirks = QuirkProfile::CosmacVip);
+	// Runs however many whole frames deltaTime adds up to, for callers that don't schedule frames themselves
 	void Update(const double deltaTime);
+	// Runs one 60 Hz frame: the frame's share of the cycles per second, then one timer tick
+	void RunFrame();
 	void Process();
+	// Runs the given number of instructions with the selected engine and returns how many actually ran
+	uint32_t RunCycles(uint32_t cycles);
 	// Constructs a full instruction from the memory index of mProgramCounter
 	uint16_t Fetch();
 	// Constructs an opcode, based on the nibbles of the full instruction
@@ -25,83 +179,324 @@ public:
 
 #ifdef DEBUG
 	void DrawDebug();
+#if CHIP8_PROFILE
+	void DrawProfiler();
+#endif
 #endif
 
-	inline const uint32_t* GetDisplay() { return mDisplay.data(); }
-	inline const uint8_t GetDisplayWidth() { return DISPLAY_WIDTH; }
-	inline const uint8_t GetDisplayHeight() { return DISPLAY_HEIGHT; }
+	// gDisplayRowWords words per row, the most-significant bit of a row's first word is its leftmost pixel. Only XO-CHIP
+	// draws to the second plane. See ExpandFramebuffer() for turning them into pixels.
+	inline const uint64_t* GetDisplayPlane(size_t plane) { return mDisplay[plane].data(); }
+	// Fingerprint of the current display contents, for comparing runs
+	uint64_t GetDisplayHash();
+	// Fingerprint of the display, variable registers, index register and program counter, chained onto seed
+	uint64_t GetFrameHash(uint64_t seed);
+	// 64x32, or 128x64 after SUPER-CHIP and XO-CHIP's 00FF until the next 00FE
+	inline const uint8_t GetDisplayWidth() { return mHighResolution ? gHiResDisplayWidth : DISPLAY_WIDTH; }
+	inline const uint8_t GetDisplayHeight() { return mHighResolution ? gHiResDisplayHeight : DISPLAY_HEIGHT; }
 	inline bool* GetKeypad() { return mKeypad.data(); }
+	// One bit per key, bit 0 is key 0. For frontends that gather input on another thread as a single atomic mask.
+	void SetKeypad(uint16_t keys);
+	// Presses or releases key right before the instruction at cycle, so input lands where it happened on the emulated
+	// timeline instead of wherever the next frame starts. Clamped to the next RunFrame(): earlier cycles are due at its
+	// start, later ones at its end, and while paused everything is due right away. Returns the cycle it'll be applied at.
+	// Pending events aren't part of save states, the queue is always empty again once RunFrame() returns.
+	uint64_t QueueKeyEvent(uint64_t cycle, uint8_t key, bool pressed);
+
+	// Bumped every time the display contents change, cheap for any number of observers to poll
+	inline const uint64_t GetDisplayGeneration() { return mDisplayGeneration; }
+	// Returns a bit per display row changed since the last call (bit 0 is the top row) and clears them.
+	// Meant for the single consumer uploading the display, anyone else should compare generations.
+	uint64_t TakeDirtyRows();
 
 	inline const bool IsPaused() { return mIsPaused; }
+#ifdef DEBUG
+	inline void SetPaused(bool paused) { mIsPaused = paused; }
+#endif
+
+	// Instructions retired through RunCycles() since the ROM was loaded
+	inline const uint64_t GetCycleCount() { return mCycleCount; }
+	// Cycle count the next RunFrame() stops at
+	inline const uint64_t GetFrameEndCycle()
+	{
+		const uint64_t frameEnd = mFrameStartCycle + (mCyclesPerSecond + mFrameCycleRemainder) / gFrameRate;
+		return frameEnd > mCycleCount ? frameEnd : mCycleCount;
+	}
+	// Frames run through RunFrame() since the ROM was loaded
+	inline const uint64_t GetFrameCount() { return mFrameCount; }
+	inline const uint16_t GetCyclesPerSecond() { return mCyclesPerSecond; }
+	inline const QuirkProfile GetQuirkProfile() { return mQuirkProfile; }
+
+	// Copies the whole machine into state, which can then be written out with WriteStateFile() or a StatePackWriter
+	void SaveState(MachineState& state);
+	// Restores a state from SaveState(), e.g. one mapped straight from a file. Returns false, leaving the machine
+	// untouched, if the state is from another format version.
+	bool LoadState(const MachineState& state);
+
+	// Keeps a history of the last seconds of frames for SetRewinding() to step back through, 0 turns it off
+	void EnableRewind(uint32_t seconds);
+	// While set, each frame steps one frame back through the history instead of running, until it runs out
+	inline void SetRewinding(bool rewinding) { mIsRewinding = rewinding; }
+	inline const bool IsRewinding() { return mIsRewinding; }
+
+	// CXNN draws from a generator seeded with this, reseeded on every LoadROM() so a ROM, a seed and the inputs fully
+	// determine a run. Starts out random. Machines running side by side should each get their own GetStreamSeed().
+	void SetRandomSeed(uint64_t seed);
+	inline const uint64_t GetRandomSeed() { return mRandomSeed; }
+
+	void SetExecutionEngine(ExecutionEngine engine);
+	inline const ExecutionEngine GetExecutionEngine() { return mEngine; }
+
+	// How many times each fusion fired since the ROM was loaded
+	inline const uint64_t GetFusionCount(Fusion fusion) { return mFusionsFired[static_cast<size_t>(fusion)]; }
+
+	// While one is set, every frame pushes gAudioFrameSamples of the beeper into the ring: a square wave while the sound
+	// timer runs, or XO-CHIP's pattern at its pitch once F002 has loaded one. Pass nullptr to stop.
+	inline void SetAudioOutput(AudioRing* output) { mAudioOutput = output; }
+
+	// While one is set, the display is handed to it at the end of every frame RunFrame() runs. It only ever copies the
+	// planes into the writer's queue, frames the encoder has no room for are dropped. Pass nullptr to stop.
+	inline void SetCapture(CaptureWriter* capture) { mCapture = capture; }
+
+#if CHIP8_TRACE
+	// Every instruction RunCycles() executes is pushed to the ring while one is set, pass nullptr to stop tracing
+	inline void SetTrace(TraceRing* trace) { mTrace = trace; }
+#endif
+
+#if CHIP8_PROFILE
+	// Every instruction RunCycles() executes is counted while one is set, pass nullptr to stop profiling
+	inline void SetProfiler(Profiler* profiler) { mProfiler = profiler; }
+#endif
 
 private:
-	// Op Codes
-	void OpCode_ClearScreen(uint16_t instruction);			// 00E0
-	void OpCode_Jump(uint16_t instruction);					// 1NNN
-	void OpCode_SetVxToNn(uint16_t instruction);			// 6XNN
-	void OpCode_SetIndexRegister(uint16_t instruction);		// ANNN
-	void OpCode_AddNnToVx(uint16_t instruction);			// 7XNN
-	void OpCode_Display(uint16_t instruction);				// DXYN
-
-	void OpCode_PushSubroutine(uint16_t instruction);		// 2NNN
-	void OpCode_PopSubroutine(uint16_t instruction);		// 00EE
-	void OpCode_SkipIfVxNn(uint16_t instruction);			// 3XNN
-	void OpCode_SkipIfVxNotNn(uint16_t instruction);		// 4XNN
-	void OpCode_SkipVxVyEqual(uint16_t instruction);		// 5XY0
-	void OpCode_SkipVxVyNotEqual(uint16_t instruction);		// 9XY0
-	void OpCode_Add(uint16_t instruction);					// 7XNN
-
-	void OpCode_JumpWithOffset(uint16_t instruction);		// BNNN
-	void OpCode_Random(uint16_t instruction);				// CXNN
-
-	void OpCode_Set(uint16_t instruction);					// 8XY0
-	void OpCode_BinaryOR(uint16_t instruction);				// 8XY1
-	void OpCode_BinaryAND(uint16_t instruction);			// 8XY2
-	void OpCode_LogicalXOR(uint16_t instruction);			// 8XY3
-	void OpCode_AddWithCarry(uint16_t instruction);			// 8XY4
-	void OpCode_SubtractVyFromVx(uint16_t instruction);		// 8XY5
-	void OpCode_SubtractVxfromVy(uint16_t instruction);		// 8XY7
-	void OpCode_ShiftRight(uint16_t instruction);			// 8XY6
-	void OpCode_ShiftLeft(uint16_t instruction);			// 8XYE
-
-	void OpCode_SkipIfKeyPressed(uint16_t instruction);		// EX9E
-	void OpCode_SkipIfKeyNotPressed(uint16_t instruction);	// EXA1
-
-	void OpCode_CacheDelayTimer(uint16_t instruction);		// FX07
-	void OpCode_SetDelayTimer(uint16_t instruction);		// FX15
-	void OpCode_SetSoundTimer(uint16_t instruction);		// FX18
-
-	void OpCode_AddToIndexRegister(uint16_t instruction);	// FX1E
-	void OpCode_GetKey(uint16_t instruction);				// FX0A
-	void OpCode_SetFontCharacter(uint16_t instruction);		// FX29
-	void OpCode_BinaryToDecimal(uint16_t instruction);		// FX33
-
-	void OpCode_StoreMemory(uint16_t instruction);			// FX55
-	void OpCode_LoadMemory(uint16_t instruction);			// FX65
+	friend class Jit;
+	friend class RewindBuffer;
+
+	using OpCodeHandler = void (CHIP::*)(const Operands& operands);
+
+	struct CachedInstruction
+	{
+		OpCodeHandler handler = nullptr;	// nullptr until the slot is first executed
+		Operands operands;
+	};
+
+	// Maps an instruction to its handler purely from its nibbles, no hashing involved
+	template<QuirkProfile Profile>
+	static OpCodeHandler LookupHandler(uint16_t instruction);
+	// Same, for wherever the profile is only known at run time
+	static OpCodeHandler LookupHandler(QuirkProfile profile, uint16_t instruction);
+
+	// Process() and RunCycles() for one profile, the public ones just pick the instantiation
+	template<QuirkProfile Profile>
+	void Process();
+	template<QuirkProfile Profile>
+	uint32_t RunCycles(uint32_t cycles);
+	// Points the HashMap engine's entries for the ambiguous instructions at the profile's handlers
+	template<QuirkProfile Profile>
+	void BindQuirkyInstructions();
+	void SetQuirkProfile(QuirkProfile profile);
+
+	// Returns the predecoded slot for mProgramCounter, decoding it first if needed, and advances the PC
+	template<QuirkProfile Profile>
+	const CachedInstruction& FetchCached();
+	// All guest writes to memory must go through here so stale decode slots get dropped
+	void WriteMemory(uint16_t address, uint8_t value);
+	void InvalidateDecodeCache();
+	// For when all of memory and the display were replaced at once: drops every decoded or compiled instruction and
+	// marks everything changed
+	void OnMachineReplaced();
+
+	// The CPU section of save states and rewind frames
+	void SaveCpuState(CpuState& cpu);
+	void LoadCpuState(const CpuState& cpu);
+
+	// All display changes must go through here so the renderer knows which rows to upload
+	void MarkRowsDirty(uint64_t rows);
+	// Planes drawn to, cleared and scrolled, XO-CHIP picks them with FN01 and the rest only have the first
+	template<QuirkProfile Profile>
+	uint8_t GetSelectedPlanes() const;
+	// Steps over the next instruction, which on XO-CHIP can be the four byte F000 NNNN
+	template<QuirkProfile Profile>
+	void SkipInstruction();
+
+	// Scans program memory for instruction idioms and marks their first slot, so RunCycles() can execute them in one go
+	void FuseSuperinstructions();
+	// Executes the fused idiom starting at the program counter, returns the number of guest instructions it retired
+	template<QuirkProfile Profile>
+	uint32_t ExecuteFusion(Fusion fusion, uint32_t cyclesLeft);
+
+#if CHIP8_TRACE || CHIP8_PROFILE
+	// RunCycles() while tracing or profiling, one instruction at a time
+	uint32_t RunInstrumentedCycles(uint32_t cycles);
+#endif
+
+	// Op Codes, the ones taking a QuirkProfile behave differently between interpreters
+	template<QuirkProfile Profile>
+	void OpCode_ClearScreen(const Operands& operands);			// 00E0
+	void OpCode_Jump(const Operands& operands);					// 1NNN
+	void OpCode_SetVxToNn(const Operands& operands);			// 6XNN
+	void OpCode_SetIndexRegister(const Operands& operands);		// ANNN
+	void OpCode_AddNnToVx(const Operands& operands);			// 7XNN
+	template<QuirkProfile Profile>
+	void OpCode_Display(const Operands& operands);				// DXYN
+
+	void OpCode_PushSubroutine(const Operands& operands);		// 2NNN
+	void OpCode_PopSubroutine(const Operands& operands);		// 00EE
+	template<QuirkProfile Profile>
+	void OpCode_SkipIfVxNn(const Operands& operands);			// 3XNN
+	template<QuirkProfile Profile>
+	void OpCode_SkipIfVxNotNn(const Operands& operands);		// 4XNN
+	template<QuirkProfile Profile>
+	void OpCode_SkipVxVyEqual(const Operands& operands);		// 5XY0
+	template<QuirkProfile Profile>
+	void OpCode_SkipVxVyNotEqual(const Operands& operands);		// 9XY0
+	void OpCode_Add(const Operands& operands);					// 7XNN
+
+	template<QuirkProfile Profile>
+	void OpCode_JumpWithOffset(const Operands& operands);		// BNNN
+	void OpCode_Random(const Operands& operands);				// CXNN
+
+	void OpCode_Set(const Operands& operands);					// 8XY0
+	template<QuirkProfile Profile>
+	void OpCode_BinaryOR(const Operands& operands);				// 8XY1
+	template<QuirkProfile Profile>
+	void OpCode_BinaryAND(const Operands& operands);			// 8XY2
+	template<QuirkProfile Profile>
+	void OpCode_LogicalXOR(const Operands& operands);			// 8XY3
+	void OpCode_AddWithCarry(const Operands& operands);			// 8XY4
+	void OpCode_SubtractVyFromVx(const Operands& operands);		// 8XY5
+	void OpCode_SubtractVxfromVy(const Operands& operands);		// 8XY7
+	template<QuirkProfile Profile>
+	void OpCode_ShiftRight(const Operands& operands);			// 8XY6
+	template<QuirkProfile Profile>
+	void OpCode_ShiftLeft(const Operands& operands);			// 8XYE
+
+	template<QuirkProfile Profile>
+	void OpCode_SkipIfKeyPressed(const Operands& operands);		// EX9E
+	template<QuirkProfile Profile>
+	void OpCode_SkipIfKeyNotPressed(const Operands& operands);	// EXA1
+
+	void OpCode_CacheDelayTimer(const Operands& operands);		// FX07
+	void OpCode_SetDelayTimer(const Operands& operands);		// FX15
+	void OpCode_SetSoundTimer(const Operands& operands);		// FX18
+
+	void OpCode_AddToIndexRegister(const Operands& operands);	// FX1E
+	void OpCode_GetKey(const Operands& operands);				// FX0A
+	void OpCode_SetFontCharacter(const Operands& operands);		// FX29
+	void OpCode_BinaryToDecimal(const Operands& operands);		// FX33
+
+	template<QuirkProfile Profile>
+	void OpCode_StoreMemory(const Operands& operands);			// FX55
+	template<QuirkProfile Profile>
+	void OpCode_LoadMemory(const Operands& operands);			// FX65
+
+	// SUPER-CHIP
+	template<QuirkProfile Profile>
+	void OpCode_ScrollDown(const Operands& operands);			// 00CN
+	template<QuirkProfile Profile>
+	void OpCode_ScrollRight(const Operands& operands);			// 00FB
+	template<QuirkProfile Profile>
+	void OpCode_ScrollLeft(const Operands& operands);			// 00FC
+	void OpCode_Exit(const Operands& operands);					// 00FD
+	void OpCode_LowResolution(const Operands& operands);		// 00FE
+	void OpCode_HighResolution(const Operands& operands);		// 00FF
+	void OpCode_SetBigFontCharacter(const Operands& operands);	// FX30
+	void OpCode_StoreFlags(const Operands& operands);			// FX75
+	void OpCode_LoadFlags(const Operands& operands);			// FX85
+
+	// XO-CHIP
+	template<QuirkProfile Profile>
+	void OpCode_ScrollUp(const Operands& operands);				// 00DN
+	void OpCode_StoreRange(const Operands& operands);			// 5XY2
+	void OpCode_LoadRange(const Operands& operands);			// 5XY3
+	void OpCode_SetLongIndexRegister(const Operands& operands);	// F000 NNNN
+	void OpCode_SelectPlanes(const Operands& operands);			// FN01
+	void OpCode_LoadAudioPattern(const Operands& operands);		// F002
+	void OpCode_SetPitch(const Operands& operands);				// FX3A
+
+	void OpCode_Invalid(const Operands& operands);				// Anything not in the instruction set
+
+	// What FX55 and FX65 leave I at after touching V0 to VX
+	template<QuirkProfile Profile>
+	void AdvanceIndexRegister(uint8_t x);
 
 private:
-	std::array<uint8_t, 4096> mMemory = { 0 };
-	std::unordered_map<uint16_t, std::function<void(uint16_t)>> mInstructions;
+	std::array<uint8_t, gMemorySize> mMemory = { 0 };
+	MemoryPages mWrittenPages = MemoryPages().set();	// Pages of mMemory written since the rewind buffer last recorded a frame
+	std::unordered_map<uint16_t, std::function<void(const Operands&)>> mInstructions;
+	ExecutionEngine mEngine = ExecutionEngine::Predecoded;
+	QuirkProfile mQuirkProfile = QuirkProfile::CosmacVip;
+
+	// One slot per even address, as instructions are two bytes wide
+	std::array<CachedInstruction, gCachedCodeSize / 2> mDecodeCache;
+	CachedInstruction mUncachedInstruction;
+	// Fusion starting at each slot, kept apart from mDecodeCache so the slots stay small
+	std::array<Fusion, gCachedCodeSize / 2> mFusions = {};
+	std::array<uint64_t, static_cast<size_t>(Fusion::Count)> mFusionsFired = { 0 };
+
+	// Only exists while the Jit engine is selected
+	std::unique_ptr<Jit> mJit;
+
+	// Only exists while rewinding is enabled
+	std::unique_ptr<RewindBuffer> mRewind;
+	bool mIsRewinding = false;
+
+	// Applies the queued key events due by cycle
+	void ApplyKeyEvents(uint64_t cycle);
+
+	void RenderAudio();
+	AudioRing* mAudioOutput = nullptr;
+	CaptureWriter* mCapture = nullptr;
+	// Position in the pattern being played, in bits. Output only, so not part of the machine state.
+	double mAudioPhase = 0;
+
+#if CHIP8_TRACE
+	TraceRing* mTrace = nullptr;
+#endif
+#if CHIP8_PROFILE
+	Profiler* mProfiler = nullptr;
+#endif
+
 	std::array<uint8_t, 16> mVariableRegisters = { 0 };
 
-	// display (64 x 32, or 128x64 for SUPER-CHIP)
-	// Consuming more memory and using a 32 bit uint here makes SDL texture manipulation easier
-	// Each element will either be 0x00000000 (off) or 0xFFFFFFFF (on)
-	std::array<uint32_t, DISPLAY_WIDTH * DISPLAY_HEIGHT> mDisplay = { 0 };
+	// display (64 x 32, or 128x64 for SUPER-CHIP and XO-CHIP)
+	// Packed one bit per pixel, gDisplayRowWords 64-bit words per row and one plane per colour bit, so DXYN is a shift
+	// and an XOR per sprite row and plane. The RGBA texture data SDL wants only gets built when presenting.
+	DisplayPlanes mDisplay = {};
+	bool mHighResolution = false;
+	uint8_t mPlaneMask = 1;						// XO-CHIP's FN01 selection, bit 0 is the first plane
+	uint64_t mDirtyRows = gAllDisplayRows;
+	uint64_t mDisplayGeneration = 0;
+	uint64_t mChangedRows = gAllDisplayRows;	// Like mDirtyRows, but taken by the rewind buffer rather than the renderer
 
-	std::stack<uint16_t> mAddressStack;
+	// Fixed size rather than a std::stack so save states can copy it as is
+	std::array<uint16_t, gStackDepth> mAddressStack = { 0 };
+	uint8_t mStackSize = 0;
 	std::array<bool, 16> mKeypad = { 0 };
+	std::vector<KeyEvent> mKeyEvents;	// In cycle order, see QueueKeyEvent()
+	uint64_t mRandomSeed = 0;
+	Random mRandom;
 	uint16_t mIndexRegister = 0;
 	uint16_t mProgramCounter = 0x200;
 
-	double mTimer = 0;
 	uint8_t mDelayTimer = 0;
 	uint8_t mSoundTimer = 0;
 
+	// SUPER-CHIP's FX75/FX85 flags, the HP 48 kept them across programs so LoadROM() leaves them alone
+	std::array<uint8_t, 16> mFlagRegisters = { 0 };
+	// XO-CHIP's 1-bit sample played while the sound timer runs, and its playback rate (see F002 and FX3A)
+	std::array<uint8_t, 16> mAudioPattern = { 0 };
+	uint8_t mPitch = 64;
+
 	const uint16_t mStartingProgramCounter = 0x200;
-	uint8_t mRomSize = 0;
-	double mSecondsPerCycle = 0;
-	double mCycleTimer = 0;
+	uint16_t mRomSize = 0;
+	uint16_t mCyclesPerSecond = 700;
+	uint32_t mFrameCycleRemainder = 0;	// Cycles per second left over after dividing by the frame rate, carried into the next frame
+	double mFrameTimer = 0;				// Wall-clock time Update() hasn't turned into frames yet
+	uint64_t mCycleCount = 0;
+	// Where the next RunFrame()'s budget starts from, behind mCycleCount only by instructions stepped by hand while paused
+	uint64_t mFrameStartCycle = 0;
+	uint64_t mFrameCount = 0;
 
 #ifdef DEBUG
 	uint16_t mPreviousInstruction = 0;
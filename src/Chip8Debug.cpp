@@ -0,0 +1,168 @@
+#include "Chip8.h"
+#include "Rewind.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <string>
+
+#ifdef DEBUG
+#include <imgui.h>
+#include <backends/imgui_impl_sdl3.h>
+#include <backends/imgui_impl_sdlrenderer3.h>
+#endif
+
+std::string GetHexString(uint16_t num)
+{
+	std::stringstream output;
+	output << std::hex << num;
+	return output.str();
+}
+
+
+#ifdef DEBUG
+void CHIP::DrawDebug()
+{
+	ImGui::Begin("CHIP-8 Debug Controls");
+	ImGui::Text("Last Instruction: %s", GetHexString(mPreviousInstruction).c_str());
+	ImGui::Text("Next Instruction: %s", GetHexString(mNextInstruction).c_str());
+	// Through RunCycles() so the step is counted, traced and profiled like any other instruction
+	if (ImGui::Button("Process Next Instruction"))
+	{
+		RunCycles(1);
+	}
+
+	ImGui::Checkbox("Pause Emulation", &mIsPaused);
+	ImGui::Text("Quirks: %s", GetQuirkProfileName(mQuirkProfile));
+	ImGui::Text("Display: %dx%d, planes %d", GetDisplayWidth(), GetDisplayHeight(), mPlaneMask);
+
+	ImGui::Text("Fusions: draw %llu, delay wait %llu, counted loop %llu",
+		static_cast<unsigned long long>(GetFusionCount(Fusion::LoadAndDraw)),
+		static_cast<unsigned long long>(GetFusionCount(Fusion::WaitForDelay)),
+		static_cast<unsigned long long>(GetFusionCount(Fusion::CountedLoop)));
+
+	if (mAudioOutput)
+	{
+		ImGui::Text("Audio: %.1f ms buffered, %llu underruns, %llu overruns", 1000.0 * mAudioOutput->GetBuffered() / gAudioSampleRate,
+			static_cast<unsigned long long>(mAudioOutput->GetUnderruns()), static_cast<unsigned long long>(mAudioOutput->GetOverruns()));
+	}
+
+	if (mRewind)
+	{
+		ImGui::Text("Rewind: %zu frames, %zu / %zu KB", mRewind->GetFrameCount(), mRewind->GetUsedBytes() / 1024, mRewind->GetArenaSize() / 1024);
+		ImGui::Checkbox("Rewind", &mIsRewinding);
+		// Works while paused too, for stepping back one frame at a time
+		if (ImGui::Button("Step Back One Frame"))
+		{
+			mRewind->StepBack(*this);
+		}
+	}
+	ImGui::End();
+
+	if (mRomSize > 0)
+	{
+		const size_t bytesPerRow = 8;
+		ImGui::Begin("ROM Viewer");
+
+		// Loop through rows
+		for (int i = 0; i < mRomSize; ++i)
+		{
+			const size_t romIndex = mStartingProgramCounter + i;
+			const bool isCurrentPC = mProgramCounter == romIndex;
+			if (i % bytesPerRow != 0)
+			{
+				ImGui::SameLine();
+			}
+
+			if (isCurrentPC)
+				ImGui::PushStyleColor(ImGuiCol_Text, ImVec4(0.0f, 1.0f, 0.0f, 1.0f));
+
+			ImGui::Text("%s", GetHexString(mMemory[romIndex]).c_str());
+
+			if (isCurrentPC)
+				ImGui::PopStyleColor();
+		}
+
+		// End ImGui window
+		ImGui::End();
+	}
+
+#if CHIP8_PROFILE
+	if (mProfiler)
+	{
+		DrawProfiler();
+	}
+#endif
+}
+
+#if CHIP8_PROFILE
+void CHIP::DrawProfiler()
+{
+	ImGui::Begin("Profiler");
+
+	const uint64_t instructions = mProfiler->GetInstructionCount();
+	const uint64_t draws = mProfiler->GetDrawCount();
+	ImGui::Text("Instructions: %llu", static_cast<unsigned long long>(instructions));
+	ImGui::Text("DXYN: %llu, %.1f ns each", static_cast<unsigned long long>(draws), draws > 0 ? static_cast<double>(mProfiler->GetDrawNanoseconds()) / draws : 0.0);
+	if (ImGui::Button("Reset"))
+	{
+		mProfiler->Reset();
+	}
+
+	if (ImGui::CollapsingHeader("Opcodes", ImGuiTreeNodeFlags_DefaultOpen))
+	{
+		for (size_t opcode = 0; opcode < Profiler::gOpcodeCount; ++opcode)
+		{
+			const uint64_t count = mProfiler->GetOpcodeCount(opcode);
+			if (count > 0)
+			{
+				ImGui::Text("%-8s %12llu %6.2f%%", Profiler::GetOpcodeName(opcode), static_cast<unsigned long long>(count), 100.0 * count / instructions);
+			}
+		}
+	}
+
+	if (ImGui::CollapsingHeader("Hot Loops", ImGuiTreeNodeFlags_DefaultOpen))
+	{
+		for (const Profiler::Loop& loop : mProfiler->GetHotLoops(8))
+		{
+			ImGui::Text("%03X-%03X %12llu iterations %6.2f%% of instructions", loop.start, loop.end,
+				static_cast<unsigned long long>(loop.iterations), 100.0 * loop.instructions / instructions);
+		}
+	}
+
+	if (ImGui::CollapsingHeader("Heatmap", ImGuiTreeNodeFlags_DefaultOpen))
+	{
+		// One cell per address, 64 to a row, brightness on a log scale so a few hot loops don't wash out the rest
+		const std::array<uint64_t, 4096>& counts = mProfiler->GetAddressCounts();
+		const uint64_t hottest = std::max<uint64_t>(1, *std::max_element(counts.begin(), counts.end()));
+		const float cell = 5.0f;
+		const ImVec2 origin = ImGui::GetCursorScreenPos();
+		ImDrawList* drawList = ImGui::GetWindowDrawList();
+		for (size_t address = 0; address < counts.size(); ++address)
+		{
+			if (counts[address] == 0)
+			{
+				continue;
+			}
+
+			const float heat = static_cast<float>(std::log1p(static_cast<double>(counts[address])) / std::log1p(static_cast<double>(hottest)));
+			const ImVec2 min(origin.x + (address % 64) * cell, origin.y + (address / 64) * cell);
+			drawList->AddRectFilled(min, ImVec2(min.x + cell, min.y + cell), ImGui::GetColorU32(ImVec4(heat, 0.2f * heat, 1.0f - heat, 1.0f)));
+		}
+		ImGui::Dummy(ImVec2(64 * cell, 64 * cell));
+
+		if (ImGui::IsItemHovered())
+		{
+			const ImVec2 mouse = ImGui::GetIO().MousePos;
+			const size_t address = static_cast<size_t>((mouse.y - origin.y) / cell) * 64 + static_cast<size_t>((mouse.x - origin.x) / cell);
+			if (address < counts.size())
+			{
+				ImGui::SetTooltip("%03zX: %llu", address, static_cast<unsigned long long>(counts[address]));
+			}
+		}
+	}
+
+	ImGui::End();
+}
+#endif
+#endif
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "Display.h"
+#include "Framebuffer.h"
 
 #ifdef DEBUG
 #include <imgui.h>
@@ -49,6 +50,9 @@ bool Display::Startup(const int windowWidth, const int windowHeight, const int t
 	mRenderer = SDL_CreateRenderer(mWindow, NULL);
 	mTexture = SDL_CreateTexture(mRenderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING, textureWidth, textureHeight);
 
+	mTextureWidth = textureWidth;
+	mTextureHeight = textureHeight;
+
 	// Enables 'pixel perfect' texture scaling
 	SDL_SetTextureScaleMode(mTexture, SDL_SCALEMODE_NEAREST);
 
@@ -77,8 +81,18 @@ void Display::Shutdown()
 }
 
 
+void Display::SetPhosphor(const PhosphorSettings& settings)
+{
+	mPhosphor.SetSettings(settings);
+}
+
 void Display::Update(const SDL_Event* event)
 {
+	if (event->type == SDL_EVENT_WINDOW_EXPOSED || event->type == SDL_EVENT_WINDOW_PIXEL_SIZE_CHANGED)
+	{
+		mNeedsPresent = true;
+	}
+
 #ifdef DEBUG
 	ImGui_ImplSDL3_ProcessEvent(event); // Let ImGui handle the event
 #endif
@@ -93,10 +107,53 @@ void Display::RenderBegin()
 #endif
 }
 
-void Display::RenderEnd(const uint32_t* pixelBuffer, const int rowWidth)
+void Display::RenderEnd(const uint64_t* firstPlane, const uint64_t* secondPlane, const int rowWidth, const int rowCount, uint64_t dirtyRows)
 {
-	const int pitch = sizeof(pixelBuffer[0]) * rowWidth;
-	SDL_UpdateTexture(mTexture, nullptr, pixelBuffer, pitch);
+	const int scale = static_cast<int>(mPhosphor.GetSettings().scale);
+	const int width = rowWidth * scale;
+	if (width != mTextureWidth || rowCount * scale != mTextureHeight)
+	{
+		// SUPER-CHIP switched resolution or the scale changed, the new texture starts out with nothing in it
+		SDL_DestroyTexture(mTexture);
+		mTexture = SDL_CreateTexture(mRenderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING, width, rowCount * scale);
+		SDL_SetTextureScaleMode(mTexture, SDL_SCALEMODE_NEAREST);
+		mTextureWidth = width;
+		mTextureHeight = rowCount * scale;
+		dirtyRows = gAllDisplayRows;
+	}
+
+	const uint64_t changedRows = mPhosphor.Process(firstPlane, secondPlane, rowWidth, rowCount, dirtyRows);
+	const int pitch = sizeof(uint32_t) * width;
+
+	// Upload each run of consecutive changed rows as one rect, untouched rows keep what the texture already has
+	int row = 0;
+	while (row < rowCount)
+	{
+		if ((changedRows >> row & 1) == 0)
+		{
+			++row;
+			continue;
+		}
+
+		const int firstRow = row;
+		while (row < rowCount && (changedRows >> row & 1) != 0)
+		{
+			++row;
+		}
+
+		const SDL_Rect rect = { 0, firstRow * scale, width, (row - firstRow) * scale };
+		SDL_UpdateTexture(mTexture, &rect, mPhosphor.GetPixels() + static_cast<size_t>(rect.y) * width, pitch);
+	}
+
+#ifndef DEBUG
+	// ImGui redraws every frame in debug builds, otherwise an unchanged display that's done fading doesn't need presenting again
+	if (changedRows == 0 && !mNeedsPresent)
+	{
+		return;
+	}
+#endif
+	mNeedsPresent = false;
+
 	SDL_RenderTexture(mRenderer, mTexture, nullptr, nullptr);
 
 #ifdef DEBUG
@@ -2,17 +2,34 @@
 
 #include <SDL3/SDL.h>
 
+#include <cstdint>
+
+#include "Phosphor.h"
+
 class Display {
 public:
 	bool Startup(const int windowWidth, const int windowHeight, const int textureWidth, const int textureHeight);
 	void Shutdown();
 
+	// Fading, palette and upscaling applied between the display and the texture, can be changed at any time
+	void SetPhosphor(const PhosphorSettings& settings);
+
 	void Update(const SDL_Event* event);
 	void RenderBegin();
-	void RenderEnd(const uint32_t* pixelBuffer, const int pitch);
+	// Takes the emulator's bit-planar rows and runs the ones flagged in dirtyRows, plus any still fading, through the
+	// phosphor filter into the texture, which follows the display's resolution times the scale. Skips the upload
+	// entirely, and in release builds the present too, when nothing changed.
+	void RenderEnd(const uint64_t* firstPlane, const uint64_t* secondPlane, const int rowWidth, const int rowCount, uint64_t dirtyRows);
 
 private:
 	SDL_Window* mWindow;
 	SDL_Renderer* mRenderer;
 	SDL_Texture* mTexture;
+	int mTextureWidth = 0;
+	int mTextureHeight = 0;
+
+	// Owns the RGBA pixels uploaded to the texture, resized only when the resolution or scale changes
+	PhosphorFilter mPhosphor;
+	// Set when the window contents were lost or resized and need presenting even if the display hasn't changed
+	bool mNeedsPresent = true;
 };
\ No newline at end of file
@@ -0,0 +1,80 @@
+#include "FrameScheduler.h"
+
+#include <algorithm>
+#include <thread>
+
+namespace {
+
+	// How many frames the scheduler may lag before it gives up on catching up
+	constexpr int gMaxLagFrames = 4;
+
+	// sleep_until can overshoot by a scheduler quantum (up to ~15 ms on Windows), so it stops this far short of the
+	// deadline and yields for the remainder
+	constexpr auto gSleepMargin = std::chrono::milliseconds(2);
+}
+
+FrameScheduler::FrameScheduler(uint32_t frameRate)
+	: mFrameDuration(std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / frameRate)))
+	, mDeadline(Clock::now())
+	, mLastRender(mDeadline)
+{
+}
+
+void FrameScheduler::WaitForNextFrame()
+{
+	Clock::time_point now = Clock::now();
+
+	if (mTurbo)
+	{
+		mDeadline = now;
+		return;
+	}
+
+	mDeadline += mFrameDuration;
+	if (now - mDeadline > mFrameDuration * gMaxLagFrames)
+	{
+		mDeadline = now;
+		return;
+	}
+
+	if (mDeadline - now > gSleepMargin)
+	{
+		std::this_thread::sleep_until(mDeadline - gSleepMargin);
+	}
+	while (Clock::now() < mDeadline)
+	{
+		std::this_thread::yield();
+	}
+}
+
+FrameScheduler::Clock::duration FrameScheduler::GetTimeUntilNextFrame() const
+{
+	if (mTurbo)
+	{
+		return Clock::duration::zero();
+	}
+
+	return std::max(mDeadline + mFrameDuration - Clock::now(), Clock::duration::zero());
+}
+
+bool FrameScheduler::ShouldRender()
+{
+	const Clock::time_point now = Clock::now();
+	if (mTurbo && mRenderSkip && now - mLastRender < mFrameDuration)
+	{
+		return false;
+	}
+
+	mLastRender = now;
+	return true;
+}
+
+void FrameScheduler::SetTurbo(bool turbo)
+{
+	// Leaving turbo starts pacing from now, not from wherever the deadline was left
+	if (mTurbo && !turbo)
+	{
+		mDeadline = Clock::now();
+	}
+	mTurbo = turbo;
+}
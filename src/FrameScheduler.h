@@ -0,0 +1,35 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+// Paces a loop to a fixed frame rate by sleeping until each frame's deadline instead of spinning.
+// Turbo mode stops sleeping altogether; with render skipping on, ShouldRender() then limits presenting to the
+// display's own rate so the host spends its time emulating rather than uploading frames nobody can see.
+class FrameScheduler {
+public:
+	using Clock = std::chrono::steady_clock;
+
+	explicit FrameScheduler(uint32_t frameRate);
+
+	// Blocks until the next frame is due. Falling further behind than a few frames resyncs to now rather than
+	// running the missed frames back to back.
+	void WaitForNextFrame();
+	// How long WaitForNextFrame() would block if called now, for spending that time waiting on something else instead
+	Clock::duration GetTimeUntilNextFrame() const;
+
+	// Whether the frame that was just emulated should be presented
+	bool ShouldRender();
+
+	void SetTurbo(bool turbo);
+	inline bool IsTurbo() const { return mTurbo; }
+	inline void SetRenderSkip(bool renderSkip) { mRenderSkip = renderSkip; }
+
+private:
+	Clock::duration mFrameDuration;
+	Clock::time_point mDeadline;
+	Clock::time_point mLastRender;
+
+	bool mTurbo = false;
+	bool mRenderSkip = true;
+};
@@ -0,0 +1,268 @@
+#include "Framebuffer.h"
+#include "Hash.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(_M_X64) || defined(__x86_64__)
+#include <emmintrin.h>
+#endif
+
+static_assert(gPixelOn == 0xFFFFFFFF && gPixelOff == 0, "The SIMD paths build pixels straight from compare masks");
+
+namespace {
+
+	// Pixels covered by each byte of a row word, the most-significant byte holds the leftmost 8 pixels
+	inline uint32_t RowByte(uint64_t word, int byte)
+	{
+		return static_cast<uint32_t>(word >> (56 - byte * 8)) & 0xFF;
+	}
+
+	// Writes the 8 pixels of one byte from each plane. Pixels only the second plane lights, or both do, take the XO-CHIP
+	// colours; with an empty second plane this is just the first plane's on/off mask.
+#if defined(__AVX2__)
+	inline void ExpandByte(uint32_t first, uint32_t second, uint32_t* pixels)
+	{
+		// Broadcast each sprite byte across 8 lanes, then turn each lane's bit into an all-ones or all-zero pixel
+		const __m256i bits = _mm256_setr_epi32(0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+		const __m256i firstMask = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(first), bits), bits);
+		if (second == 0)
+		{
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(pixels), firstMask);
+			return;
+		}
+
+		const __m256i secondMask = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(second), bits), bits);
+		const __m256i onlyFirst = _mm256_andnot_si256(secondMask, firstMask);
+		const __m256i onlySecond = _mm256_and_si256(_mm256_andnot_si256(firstMask, secondMask), _mm256_set1_epi32(static_cast<int>(gPixelSecondPlane)));
+		const __m256i both = _mm256_and_si256(_mm256_and_si256(firstMask, secondMask), _mm256_set1_epi32(static_cast<int>(gPixelBothPlanes)));
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(pixels), _mm256_or_si256(onlyFirst, _mm256_or_si256(onlySecond, both)));
+	}
+#elif defined(_M_X64) || defined(__x86_64__)
+	inline __m128i ExpandNibble(__m128i firstMask, __m128i secondMask)
+	{
+		const __m128i onlyFirst = _mm_andnot_si128(secondMask, firstMask);
+		const __m128i onlySecond = _mm_and_si128(_mm_andnot_si128(firstMask, secondMask), _mm_set1_epi32(static_cast<int>(gPixelSecondPlane)));
+		const __m128i both = _mm_and_si128(_mm_and_si128(firstMask, secondMask), _mm_set1_epi32(static_cast<int>(gPixelBothPlanes)));
+		return _mm_or_si128(onlyFirst, _mm_or_si128(onlySecond, both));
+	}
+
+	inline void ExpandByte(uint32_t first, uint32_t second, uint32_t* pixels)
+	{
+		// Same as the AVX2 path, four pixels at a time as SSE2 is all x86-64 guarantees
+		const __m128i highBits = _mm_setr_epi32(0x80, 0x40, 0x20, 0x10);
+		const __m128i lowBits = _mm_setr_epi32(0x08, 0x04, 0x02, 0x01);
+		const __m128i firstValue = _mm_set1_epi32(static_cast<int>(first));
+		const __m128i firstHigh = _mm_cmpeq_epi32(_mm_and_si128(firstValue, highBits), highBits);
+		const __m128i firstLow = _mm_cmpeq_epi32(_mm_and_si128(firstValue, lowBits), lowBits);
+		if (second == 0)
+		{
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(pixels), firstHigh);
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + 4), firstLow);
+			return;
+		}
+
+		const __m128i secondValue = _mm_set1_epi32(static_cast<int>(second));
+		const __m128i secondHigh = _mm_cmpeq_epi32(_mm_and_si128(secondValue, highBits), highBits);
+		const __m128i secondLow = _mm_cmpeq_epi32(_mm_and_si128(secondValue, lowBits), lowBits);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(pixels), ExpandNibble(firstHigh, secondHigh));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + 4), ExpandNibble(firstLow, secondLow));
+	}
+#else
+	inline void ExpandByte(uint32_t first, uint32_t second, uint32_t* pixels)
+	{
+		static constexpr uint32_t palette[4] = { gPixelOff, gPixelOn, gPixelSecondPlane, gPixelBothPlanes };
+		for (int bit = 7; bit >= 0; --bit)
+		{
+			*pixels++ = palette[((first >> bit) & 1) | (((second >> bit) & 1) << 1)];
+		}
+	}
+#endif
+
+	// A high-resolution row as one 128-bit value, high holds the leftmost 64 pixels
+	struct Row128
+	{
+		uint64_t high = 0;
+		uint64_t low = 0;
+	};
+
+	inline Row128 ShiftRight(Row128 row, uint8_t count)
+	{
+		if (count == 0)
+		{
+			return row;
+		}
+		if (count >= 64)
+		{
+			return { 0, row.high >> (count - 64) };
+		}
+		return { row.high >> count, (row.low >> count) | (row.high << (64 - count)) };
+	}
+
+	inline Row128 ShiftLeft(Row128 row, uint8_t count)
+	{
+		if (count == 0)
+		{
+			return row;
+		}
+		if (count >= 64)
+		{
+			return { row.low << (count - 64), 0 };
+		}
+		return { (row.high << count) | (row.low >> (64 - count)), row.low << count };
+	}
+
+	inline Row128 RotateRight(Row128 row, uint8_t count)
+	{
+		const Row128 right = ShiftRight(row, count);
+		const Row128 left = ShiftLeft(row, static_cast<uint8_t>((128 - count) & 127));
+		return count == 0 ? row : Row128{ right.high | left.high, right.low | left.low };
+	}
+
+	// Bits of the rows a display of this height has
+	inline uint64_t VisibleRows(uint8_t height)
+	{
+		return height == 64 ? ~0ull : (1ull << height) - 1;
+	}
+}
+
+void ExpandFramebuffer(const uint64_t* firstPlane, const uint64_t* secondPlane, int width, int height, uint32_t* pixels)
+{
+	const int rowWords = width / 64;
+	for (int y = 0; y < height; ++y)
+	{
+		for (int word = 0; word < rowWords; ++word)
+		{
+			const uint64_t first = firstPlane[y * gDisplayRowWords + word];
+			const uint64_t second = secondPlane[y * gDisplayRowWords + word];
+			for (int byte = 0; byte < 8; ++byte)
+			{
+				ExpandByte(RowByte(first, byte), RowByte(second, byte), pixels);
+				pixels += 8;
+			}
+		}
+	}
+}
+
+uint64_t DrawSprite(DisplayPlane& plane, bool highResolution, uint8_t x, uint8_t y, const uint8_t* sprite, uint8_t rows, bool wide, bool wraps, bool& collided)
+{
+	const uint8_t height = highResolution ? gHiResDisplayHeight : DISPLAY_HEIGHT;
+	const uint8_t bytesPerRow = wide ? 2 : 1;
+
+	// The starting position always wraps. Unless the profile wraps sprites too, anything drawn past the bottom edge is clipped.
+	const uint8_t visibleRows = wraps ? rows : std::min<uint8_t>(rows, height - y);
+	uint64_t collision = 0;
+	uint64_t touchedRows = 0;
+
+	for (uint8_t row = 0; row < visibleRows; ++row)
+	{
+		const uint8_t displayRow = wraps ? (y + row) % height : y + row;
+		uint64_t* words = &plane[displayRow * gDisplayRowWords];
+		const uint64_t bits = wide ? (static_cast<uint64_t>(sprite[row * 2]) << 8) | sprite[row * 2 + 1] : sprite[row];
+
+		if (!highResolution)
+		{
+			// Line the sprite row up with the word's most-significant bit (the leftmost pixel), then move it across to X.
+			// Shifting clips bits pushed off the right edge, rotating brings them back in on the left.
+			const uint64_t aligned = bits << (64 - bytesPerRow * 8);
+			const uint64_t shifted = wraps ? std::rotr(aligned, x) : aligned >> x;
+
+			// Any pixel that's on in both the sprite and the row is about to be turned off
+			collision |= words[0] & shifted;
+			words[0] ^= shifted;
+			touchedRows |= static_cast<uint64_t>(shifted != 0) << displayRow;
+			continue;
+		}
+
+		// Same again, across the two words of a high-resolution row
+		const Row128 aligned = { bits << (64 - bytesPerRow * 8), 0 };
+		const Row128 shifted = wraps ? RotateRight(aligned, x) : ShiftRight(aligned, x);
+		collision |= (words[0] & shifted.high) | (words[1] & shifted.low);
+		words[0] ^= shifted.high;
+		words[1] ^= shifted.low;
+		touchedRows |= static_cast<uint64_t>((shifted.high | shifted.low) != 0) << displayRow;
+	}
+
+	collided |= collision != 0;
+	return touchedRows;
+}
+
+uint64_t ScrollDown(DisplayPlane& plane, bool highResolution, uint8_t rows)
+{
+	const uint8_t height = highResolution ? gHiResDisplayHeight : DISPLAY_HEIGHT;
+	rows = std::min(rows, height);
+
+	// Rows are laid out back to back, so the whole scroll is one move towards the end and a clear of the top
+	std::memmove(&plane[rows * gDisplayRowWords], &plane[0], (height - rows) * gDisplayRowWords * sizeof(uint64_t));
+	std::memset(&plane[0], 0, rows * gDisplayRowWords * sizeof(uint64_t));
+	return rows == 0 ? 0 : VisibleRows(height);
+}
+
+uint64_t ScrollUp(DisplayPlane& plane, bool highResolution, uint8_t rows)
+{
+	const uint8_t height = highResolution ? gHiResDisplayHeight : DISPLAY_HEIGHT;
+	rows = std::min(rows, height);
+
+	std::memmove(&plane[0], &plane[rows * gDisplayRowWords], (height - rows) * gDisplayRowWords * sizeof(uint64_t));
+	std::memset(&plane[(height - rows) * gDisplayRowWords], 0, rows * gDisplayRowWords * sizeof(uint64_t));
+	return rows == 0 ? 0 : VisibleRows(height);
+}
+
+uint64_t ScrollRight(DisplayPlane& plane, bool highResolution, uint8_t columns)
+{
+	const uint8_t height = highResolution ? gHiResDisplayHeight : DISPLAY_HEIGHT;
+	for (uint8_t row = 0; row < height; ++row)
+	{
+		uint64_t* words = &plane[row * gDisplayRowWords];
+		if (highResolution)
+		{
+			const Row128 shifted = ShiftRight({ words[0], words[1] }, columns);
+			words[0] = shifted.high;
+			words[1] = shifted.low;
+		}
+		else
+		{
+			words[0] = columns < 64 ? words[0] >> columns : 0;
+		}
+	}
+	return columns == 0 ? 0 : VisibleRows(height);
+}
+
+uint64_t ScrollLeft(DisplayPlane& plane, bool highResolution, uint8_t columns)
+{
+	const uint8_t height = highResolution ? gHiResDisplayHeight : DISPLAY_HEIGHT;
+	for (uint8_t row = 0; row < height; ++row)
+	{
+		uint64_t* words = &plane[row * gDisplayRowWords];
+		if (highResolution)
+		{
+			const Row128 shifted = ShiftLeft({ words[0], words[1] }, columns);
+			words[0] = shifted.high;
+			words[1] = shifted.low;
+		}
+		else
+		{
+			words[0] = columns < 64 ? words[0] << columns : 0;
+		}
+	}
+	return columns == 0 ? 0 : VisibleRows(height);
+}
+
+uint64_t HashDisplay(const DisplayPlanes& planes, bool highResolution, size_t planeCount, uint64_t seed)
+{
+	const uint8_t height = highResolution ? gHiResDisplayHeight : DISPLAY_HEIGHT;
+	const size_t rowBytes = (highResolution ? gDisplayRowWords : 1) * sizeof(uint64_t);
+
+	uint64_t hash = seed;
+	for (size_t plane = 0; plane < planeCount; ++plane)
+	{
+		for (uint8_t row = 0; row < height; ++row)
+		{
+			hash = HashBytes(&planes[plane][row * gDisplayRowWords], rowBytes, hash);
+		}
+	}
+	return hash;
+}
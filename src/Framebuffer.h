@@ -0,0 +1,56 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// Low-resolution display, the only one CHIP-8 and CHIP-48 have
+constexpr uint8_t DISPLAY_WIDTH = 64;
+constexpr uint8_t DISPLAY_HEIGHT = 32;
+// SUPER-CHIP and XO-CHIP's high-resolution mode, switched to with 00FF
+constexpr uint8_t gHiResDisplayWidth = 128;
+constexpr uint8_t gHiResDisplayHeight = 64;
+static_assert(DISPLAY_WIDTH == 64, "Each low-resolution row is packed into one 64-bit word");
+static_assert(gHiResDisplayHeight <= 64, "Dirty rows are tracked in one 64-bit mask");
+
+// Every row gets room for a high-resolution row, so the layout doesn't change with the resolution. Low-resolution rows
+// only use their first word.
+constexpr size_t gDisplayRowWords = gHiResDisplayWidth / 64;
+// XO-CHIP draws to two bit-planes, every other profile only ever touches the first
+constexpr size_t gDisplayPlanes = 2;
+
+// One bit per pixel, the most-significant bit of a row's first word is its leftmost pixel
+using DisplayPlane = std::array<uint64_t, gHiResDisplayHeight * gDisplayRowWords>;
+using DisplayPlanes = std::array<DisplayPlane, gDisplayPlanes>;
+
+// Dirty row mask with every display row set, whatever the resolution
+constexpr uint64_t gAllDisplayRows = ~0ull;
+
+// Colours written by ExpandFramebuffer(), in the RGBA8888 layout the SDL texture uses. A pixel lit in only the second
+// plane, or in both, only happens on XO-CHIP.
+constexpr uint32_t gPixelOn = 0xFFFFFFFF;
+constexpr uint32_t gPixelOff = 0x00000000;
+constexpr uint32_t gPixelSecondPlane = 0xFF6600FF;
+constexpr uint32_t gPixelBothPlanes = 0x662200FF;
+
+// Expands bit-planar display rows (see CHIP::GetDisplayPlane()) into one 32-bit pixel per bit.
+// Rows are gDisplayRowWords apart in both planes, width is 64 or 128. pixels must have room for width * height entries
+// and is written row by row with no padding.
+void ExpandFramebuffer(const uint64_t* firstPlane, const uint64_t* secondPlane, int width, int height, uint32_t* pixels);
+
+// XORs a sprite into plane with its top-left corner at (x, y), which must already be on the display. Sprite rows are
+// one byte wide, or two for SUPER-CHIP's 16x16 sprites. Pixels past the right or bottom edge wrap around to the other
+// side when wraps is set and are clipped otherwise.
+// Returns a bit per row the sprite touched, collided is set when any pixel got turned off.
+uint64_t DrawSprite(DisplayPlane& plane, bool highResolution, uint8_t x, uint8_t y, const uint8_t* sprite, uint8_t rows, bool wide, bool wraps, bool& collided);
+
+// Scroll kernels, whole rows move with a memmove and columns with word shifts. Pixels coming in from outside the display
+// are off. Each returns the rows it may have changed.
+uint64_t ScrollDown(DisplayPlane& plane, bool highResolution, uint8_t rows);
+uint64_t ScrollUp(DisplayPlane& plane, bool highResolution, uint8_t rows);
+uint64_t ScrollRight(DisplayPlane& plane, bool highResolution, uint8_t columns);
+uint64_t ScrollLeft(DisplayPlane& plane, bool highResolution, uint8_t columns);
+
+// HashBytes() of the first planeCount planes, only counting the part of each row the resolution shows.
+// A single low-resolution plane hashes the same as 32 words of 64 pixels back to back.
+uint64_t HashDisplay(const DisplayPlanes& planes, bool highResolution, size_t planeCount, uint64_t seed);
@@ -0,0 +1,176 @@
+#include "Gif.h"
+
+#include <algorithm>
+
+namespace {
+
+	// LZW codes never get longer than 12 bits, the table starts over once they'd have to
+	constexpr uint32_t gMaxCodeBits = 12;
+	constexpr uint32_t gMaxCodes = 1u << gMaxCodeBits;
+	// Image data goes out in sub-blocks of at most this many bytes
+	constexpr size_t gMaxBlockSize = 255;
+
+	inline void WriteWord(FILE* file, uint16_t value)
+	{
+		const uint8_t bytes[2] = { static_cast<uint8_t>(value), static_cast<uint8_t>(value >> 8) };
+		std::fwrite(bytes, 1, sizeof(bytes), file);
+	}
+}
+
+GifWriter::GifWriter(const char* path, uint16_t width, uint16_t height, const std::vector<uint32_t>& palette)
+	: mFile(std::fopen(path, "wb"))
+	, mWidth(width)
+	, mHeight(height)
+{
+	if (mFile == nullptr)
+	{
+		return;
+	}
+
+	while ((1u << mColourBits) < palette.size() && mColourBits < 8)
+	{
+		++mColourBits;
+	}
+
+	// Logical screen with a global colour table
+	std::fwrite("GIF89a", 1, 6, mFile);
+	WriteWord(mFile, width);
+	WriteWord(mFile, height);
+	const uint8_t screen[3] = { static_cast<uint8_t>(0x80 | (mColourBits - 1) << 4 | (mColourBits - 1)), 0, 0 };
+	std::fwrite(screen, 1, sizeof(screen), mFile);
+	for (uint32_t i = 0; i < (1u << mColourBits); ++i)
+	{
+		const uint32_t colour = i < palette.size() ? palette[i] : 0;
+		const uint8_t rgb[3] = { static_cast<uint8_t>(colour >> 16), static_cast<uint8_t>(colour >> 8), static_cast<uint8_t>(colour) };
+		std::fwrite(rgb, 1, sizeof(rgb), mFile);
+	}
+
+	// NETSCAPE2.0 application extension, loop forever
+	const uint8_t loop[19] = { 0x21, 0xFF, 0x0B, 'N', 'E', 'T', 'S', 'C', 'A', 'P', 'E', '2', '.', '0', 0x03, 0x01, 0x00, 0x00, 0x00 };
+	std::fwrite(loop, 1, sizeof(loop), mFile);
+}
+
+GifWriter::~GifWriter()
+{
+	if (mFile == nullptr)
+	{
+		return;
+	}
+
+	std::fputc(0x3B, mFile);
+	std::fclose(mFile);
+}
+
+void GifWriter::AddFrame(const uint8_t* pixels, uint16_t delay)
+{
+	if (mFile == nullptr)
+	{
+		return;
+	}
+
+	// Graphic control extension: leave the frame in place, no transparency
+	const uint8_t control[4] = { 0x21, 0xF9, 0x04, 0x04 };
+	std::fwrite(control, 1, sizeof(control), mFile);
+	WriteWord(mFile, delay);
+	const uint8_t controlEnd[2] = { 0x00, 0x00 };
+	std::fwrite(controlEnd, 1, sizeof(controlEnd), mFile);
+
+	// Image descriptor covering the whole screen, no local colour table
+	std::fputc(0x2C, mFile);
+	WriteWord(mFile, 0);
+	WriteWord(mFile, 0);
+	WriteWord(mFile, mWidth);
+	WriteWord(mFile, mHeight);
+	std::fputc(0x00, mFile);
+
+	WriteImageData(pixels, static_cast<size_t>(mWidth) * mHeight);
+}
+
+void GifWriter::WriteImageData(const uint8_t* pixels, size_t count)
+{
+	// GIF wants a minimum code size of at least 2, even for two colours
+	const uint32_t minCodeSize = std::max<uint32_t>(mColourBits, 2);
+	const uint32_t alphabet = 1u << minCodeSize;
+	const uint32_t clearCode = alphabet;
+	std::fputc(static_cast<int>(minCodeSize), mFile);
+
+	mChildren.assign(static_cast<size_t>(gMaxCodes) * alphabet, 0);
+	uint32_t codeSize = minCodeSize + 1;
+	uint32_t lastCode = clearCode + 1;
+	WriteCode(clearCode, codeSize);
+
+	uint32_t prefix = count > 0 ? pixels[0] : 0;
+	for (size_t i = 1; i < count; ++i)
+	{
+		const uint32_t pixel = pixels[i];
+		uint16_t& child = mChildren[prefix * alphabet + pixel];
+		if (child != 0)
+		{
+			prefix = child;
+			continue;
+		}
+
+		WriteCode(prefix, codeSize);
+		child = static_cast<uint16_t>(++lastCode);
+		if (lastCode >= (1u << codeSize))
+		{
+			++codeSize;
+		}
+		if (lastCode == gMaxCodes - 1)
+		{
+			// The table is full, start a new one
+			WriteCode(clearCode, codeSize);
+			std::fill(mChildren.begin(), mChildren.end(), uint16_t(0));
+			codeSize = minCodeSize + 1;
+			lastCode = clearCode + 1;
+		}
+		prefix = pixel;
+	}
+
+	// The decoder adds one more entry after reading the last code, which can widen the end code
+	WriteCode(prefix, codeSize);
+	if (++lastCode >= (1u << codeSize) && codeSize < gMaxCodeBits)
+	{
+		++codeSize;
+	}
+	WriteCode(clearCode + 1, codeSize);
+
+	// Pad out the last byte, then the empty sub-block that ends the image data
+	if (mBitCount > 0)
+	{
+		mBlock.push_back(static_cast<uint8_t>(mBits));
+		mBits = 0;
+		mBitCount = 0;
+	}
+	FlushBlock();
+	std::fputc(0x00, mFile);
+}
+
+void GifWriter::WriteCode(uint32_t code, uint32_t size)
+{
+	// Codes are packed least-significant bit first
+	mBits |= code << mBitCount;
+	mBitCount += size;
+	while (mBitCount >= 8)
+	{
+		mBlock.push_back(static_cast<uint8_t>(mBits));
+		mBits >>= 8;
+		mBitCount -= 8;
+		if (mBlock.size() == gMaxBlockSize)
+		{
+			FlushBlock();
+		}
+	}
+}
+
+void GifWriter::FlushBlock()
+{
+	if (mBlock.empty())
+	{
+		return;
+	}
+
+	std::fputc(static_cast<int>(mBlock.size()), mFile);
+	std::fwrite(mBlock.data(), 1, mBlock.size(), mFile);
+	mBlock.clear();
+}
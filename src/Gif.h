@@ -0,0 +1,40 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// Writes an animated GIF that loops forever, one full-screen frame at a time. Every frame indexes the same global
+// palette of up to 256 0xRRGGBB colours.
+class GifWriter {
+public:
+	GifWriter(const char* path, uint16_t width, uint16_t height, const std::vector<uint32_t>& palette);
+	// Writes the trailer
+	~GifWriter();
+
+	GifWriter(const GifWriter&) = delete;
+	GifWriter& operator=(const GifWriter&) = delete;
+
+	inline bool IsOpen() const { return mFile != nullptr; }
+
+	// width * height palette indices, row by row. delay is how long the frame shows, in hundredths of a second; most
+	// viewers slow anything under 2 down.
+	void AddFrame(const uint8_t* pixels, uint16_t delay);
+
+private:
+	// LZW compresses pixels into the image data sub-blocks
+	void WriteImageData(const uint8_t* pixels, size_t count);
+	void WriteCode(uint32_t code, uint32_t size);
+	void FlushBlock();
+
+	FILE* mFile = nullptr;
+	uint16_t mWidth = 0;
+	uint16_t mHeight = 0;
+	uint32_t mColourBits = 1;		// The palette is padded to 2^mColourBits entries
+
+	// LZW state: child codes by (prefix code, next pixel), 0 where there's none yet
+	std::vector<uint16_t> mChildren;
+	uint32_t mBits = 0;
+	uint32_t mBitCount = 0;
+	std::vector<uint8_t> mBlock;
+};
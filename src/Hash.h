@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+constexpr uint64_t gHashSeed = 0xCBF29CE484222325;
+
+// 64-bit FNV-1a, used wherever framebuffers, registers or ROMs need a stable fingerprint.
+// Pass a previous result as the seed to chain several buffers into one hash.
+inline uint64_t HashBytes(const void* data, size_t size, uint64_t hash = gHashSeed)
+{
+	const uint8_t* bytes = static_cast<const uint8_t*>(data);
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= bytes[i];
+		hash *= 0x100000001B3;
+	}
+	return hash;
+}
\ No newline at end of file
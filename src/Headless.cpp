@@ -0,0 +1,531 @@
+#include "Chip8.h"
+#include "FrameScheduler.h"
+#include "Lockstep.h"
+#include "Movie.h"
+#include "SaveState.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+
+// Display-less runner for build machines: runs a ROM for a cycle or wall-clock budget and reports throughput and the final framebuffer hash
+
+namespace {
+
+	constexpr uint16_t gDefaultCyclesPerSecond = 700;
+
+	struct Options
+	{
+		const char* romPath = nullptr;
+		uint64_t maxCycles = 0;			// 0 means no cycle budget
+		double maxSeconds = 0;			// 0 means no wall-clock budget
+		uint16_t cyclesPerSecond = gDefaultCyclesPerSecond;
+		bool unlimited = false;			// Run at full host speed rather than pacing to real time
+		ExecutionEngine engine = ExecutionEngine::Predecoded;
+		QuirkProfile quirks = QuirkProfile::CosmacVip;
+		const char* tracePath = nullptr;	// Binary instruction trace to write, needs a CHIP8_ENABLE_TRACE build
+		const char* profilePath = nullptr;	// JSON profile to write, needs a CHIP8_ENABLE_PROFILER build
+		size_t lanes = 0;				// Run this many copies of the ROM in lockstep instead of a single CHIP
+		const char* loadStatePath = nullptr;	// State file or pack to resume from
+		const char* saveStatePath = nullptr;	// Where to write the state the run ends in
+		const char* checkpointPath = nullptr;	// Pack to collect a state per emulated second in
+		const char* replayPath = nullptr;		// Movie to play back instead of running without input
+		const char* capturePath = nullptr;		// Capture file to record the display to
+		CaptureOverflow captureOverflow = CaptureOverflow::Drop;	// Wait with --capture-wait, for captures that need every frame
+		bool hasRandomSeed = false;		// Otherwise CXNN is seeded randomly
+		uint64_t randomSeed = 0;
+	};
+
+	// Records the ring can hold before the writer thread falls behind and records get dropped
+	constexpr size_t gTraceRingCapacity = 1 << 20;
+
+	// Frames between states written to --checkpoints, one per emulated second
+	constexpr uint64_t gCheckpointInterval = gFrameRate;
+
+	void PrintUsage()
+	{
+		std::fprintf(stderr,
+			"usage: chip8-headless <rom> [--cycles N] [--seconds S] [--speed N|unlimited] [--engine hashmap|switch|predecoded|jit] [--trace FILE] [--profile FILE] [--lanes N]\n"
+			"                      [--quirks vip|chip48|schip|xochip] [--load-state FILE] [--save-state FILE] [--checkpoints FILE] [--replay FILE]\n"
+			"                      [--seed N] [--capture FILE] [--capture-wait]\n"
+			"  --cycles   stop after N guest instructions\n"
+			"  --seconds  stop after S seconds of wall-clock time\n"
+			"  --speed    guest instructions per second (default %u), or unlimited to run at full host speed\n"
+			"  --engine   interpreter core to use (default predecoded)\n"
+			"  --trace    write every executed instruction to FILE, read it back with chip8-trace\n"
+			"  --profile  write per-opcode and per-address counts, DXYN timings and the hottest loops to FILE as JSON\n"
+			"  --lanes    run N (1-32) copies of the ROM side by side on the lockstep engine\n"
+			"  --quirks   interpreter the ROM was written for (default vip). Save states and movies carry their own\n"
+			"  --load-state   resume from a state file, or the newest state in a checkpoint pack. --cycles counts from the ROM's start\n"
+			"  --save-state   write the final machine state to FILE\n"
+			"  --checkpoints  pack a state every emulated second into FILE\n"
+			"  --replay       play back a movie recorded with CHIP8 --record at full speed, checking every frame's hash\n"
+			"  --seed         seed CXNN's generator with N (hex) so the run can be repeated, the seed used is always printed\n"
+			"  --capture      record the display to FILE every frame, export it with chip8-capture. Frames the encoder\n"
+			"                 can't keep up with, e.g. at unlimited speed, are dropped and counted\n"
+			"  --capture-wait make the run wait for the encoder instead, so no frame is dropped\n",
+			gDefaultCyclesPerSecond);
+	}
+
+	bool ParseOptions(int argc, char** argv, Options& options)
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			const char* arg = argv[i];
+			const bool hasValue = i + 1 < argc;
+
+			if (std::strcmp(arg, "--cycles") == 0 && hasValue)
+			{
+				options.maxCycles = std::strtoull(argv[++i], nullptr, 10);
+			}
+			else if (std::strcmp(arg, "--seconds") == 0 && hasValue)
+			{
+				options.maxSeconds = std::strtod(argv[++i], nullptr);
+			}
+			else if (std::strcmp(arg, "--speed") == 0 && hasValue)
+			{
+				const char* speed = argv[++i];
+				if (std::strcmp(speed, "unlimited") == 0)
+				{
+					options.unlimited = true;
+				}
+				else
+				{
+					char* end = nullptr;
+					const unsigned long cyclesPerSecond = std::strtoul(speed, &end, 10);
+					if (end == speed || *end != '\0' || cyclesPerSecond == 0 || cyclesPerSecond > UINT16_MAX)
+					{
+						return false;
+					}
+					options.cyclesPerSecond = static_cast<uint16_t>(cyclesPerSecond);
+				}
+			}
+			else if (std::strcmp(arg, "--engine") == 0 && hasValue)
+			{
+				if (!ParseExecutionEngine(argv[++i], options.engine))
+				{
+					return false;
+				}
+			}
+			else if (std::strcmp(arg, "--quirks") == 0 && hasValue)
+			{
+				if (!ParseQuirkProfile(argv[++i], options.quirks))
+				{
+					return false;
+				}
+			}
+			else if (std::strcmp(arg, "--lanes") == 0 && hasValue)
+			{
+				options.lanes = std::strtoul(argv[++i], nullptr, 10);
+				if (options.lanes == 0 || options.lanes > gMaxLockstepLanes)
+				{
+					return false;
+				}
+			}
+			else if (std::strcmp(arg, "--load-state") == 0 && hasValue)
+			{
+				options.loadStatePath = argv[++i];
+			}
+			else if (std::strcmp(arg, "--save-state") == 0 && hasValue)
+			{
+				options.saveStatePath = argv[++i];
+			}
+			else if (std::strcmp(arg, "--checkpoints") == 0 && hasValue)
+			{
+				options.checkpointPath = argv[++i];
+			}
+			else if (std::strcmp(arg, "--replay") == 0 && hasValue)
+			{
+				options.replayPath = argv[++i];
+			}
+			else if (std::strcmp(arg, "--seed") == 0 && hasValue)
+			{
+				options.randomSeed = std::strtoull(argv[++i], nullptr, 16);
+				options.hasRandomSeed = true;
+			}
+			else if (std::strcmp(arg, "--trace") == 0 && hasValue)
+			{
+				options.tracePath = argv[++i];
+			}
+			else if (std::strcmp(arg, "--profile") == 0 && hasValue)
+			{
+				options.profilePath = argv[++i];
+			}
+			else if (std::strcmp(arg, "--capture") == 0 && hasValue)
+			{
+				options.capturePath = argv[++i];
+			}
+			else if (std::strcmp(arg, "--capture-wait") == 0)
+			{
+				options.captureOverflow = CaptureOverflow::Wait;
+			}
+			else if (arg[0] != '-' && options.romPath == nullptr)
+			{
+				options.romPath = arg;
+			}
+			else
+			{
+				return false;
+			}
+		}
+
+		return options.romPath != nullptr && options.cyclesPerSecond > 0;
+	}
+
+	// Restores emu from a single state file or, failing that, the newest state in a checkpoint pack
+	bool LoadStateFrom(CHIP& emu, const char* path)
+	{
+		const StateFile file(path);
+		if (file.Get() != nullptr)
+		{
+			return emu.LoadState(*file.Get());
+		}
+
+		const StatePackReader pack(path);
+		if (pack.IsValid() && pack.GetCount() > 0)
+		{
+			return emu.LoadState(*pack.FindLatest(UINT64_MAX));
+		}
+
+		return false;
+	}
+
+	// Plays the whole movie back unpaced, the movie decides the speed and length of the run
+	int RunReplay(const Options& options)
+	{
+		MoviePlayer movie(options.replayPath);
+		if (!movie.IsValid())
+		{
+			std::fprintf(stderr, "chip8-headless: %s isn't a movie from this version\n", options.replayPath);
+			return 1;
+		}
+
+		std::unique_ptr<CHIP> emu = std::make_unique<CHIP>();
+		emu->SetExecutionEngine(options.engine);
+		if (!movie.Start(*emu, options.romPath))
+		{
+			std::fprintf(stderr, "chip8-headless: %s was recorded with a different ROM\n", options.replayPath);
+			return 1;
+		}
+
+		std::unique_ptr<CaptureWriter> capture;
+		if (options.capturePath != nullptr)
+		{
+			capture = std::make_unique<CaptureWriter>(options.capturePath, options.captureOverflow);
+			if (!capture->IsOpen())
+			{
+				std::fprintf(stderr, "chip8-headless: can't write %s\n", options.capturePath);
+				return 1;
+			}
+			emu->SetCapture(capture.get());
+		}
+#ifdef DEBUG
+		emu->SetPaused(false);
+#endif
+
+		using Clock = std::chrono::steady_clock;
+		const Clock::time_point start = Clock::now();
+		while (movie.RunFrame(*emu))
+		{
+		}
+
+		const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+		const uint64_t cycles = emu->GetCycleCount();
+
+		std::printf("rom: %s\n", options.romPath);
+		std::printf("movie: %s\n", options.replayPath);
+		std::printf("instructions: %llu\n", static_cast<unsigned long long>(cycles));
+		std::printf("seconds: %.3f\n", seconds);
+		std::printf("instructions/sec: %.0f\n", seconds > 0 ? cycles / seconds : 0.0);
+		std::printf("frames: %llu\n", static_cast<unsigned long long>(movie.GetFramesPlayed()));
+		std::printf("framebuffer hash: %016llx\n", static_cast<unsigned long long>(emu->GetDisplayHash()));
+		if (capture)
+		{
+			std::printf("capture frames dropped: %llu\n", static_cast<unsigned long long>(capture->GetDropped()));
+		}
+		if (!movie.HasHashes())
+		{
+			std::printf("verification: movie has no frame hashes\n");
+		}
+		else if (movie.GetFirstDivergentFrame() != UINT64_MAX)
+		{
+			std::printf("verification: diverged at frame %llu\n", static_cast<unsigned long long>(movie.GetFirstDivergentFrame()));
+			return 2;
+		}
+		else
+		{
+			std::printf("verification: every frame matched\n");
+		}
+
+		return 0;
+	}
+
+	// Same loop as main() below, with every lane running the ROM
+	int RunLockstep(const Options& options)
+	{
+		LockstepChip machines(options.lanes);
+		if (options.hasRandomSeed)
+		{
+			machines.SetRandomSeed(options.randomSeed);
+		}
+		if (!machines.LoadROM(options.romPath, options.cyclesPerSecond, options.quirks))
+		{
+			std::fprintf(stderr, "chip8-headless: %s doesn't fit in memory\n", options.romPath);
+			return 1;
+		}
+
+		using Clock = FrameScheduler::Clock;
+		FrameScheduler scheduler(gFrameRate);
+		scheduler.SetTurbo(options.unlimited);
+		const Clock::time_point start = Clock::now();
+
+		while (true)
+		{
+			if (options.maxCycles > 0 && machines.GetCycleCount() >= options.maxCycles)
+			{
+				break;
+			}
+			if (options.maxSeconds > 0 && std::chrono::duration<double>(Clock::now() - start).count() >= options.maxSeconds)
+			{
+				break;
+			}
+
+			// The last frame is cut short so exactly --cycles instructions run, its timers don't tick
+			if (options.maxCycles > 0 && machines.GetFrameEndCycle() > options.maxCycles)
+			{
+				machines.RunCycles(static_cast<uint32_t>(options.maxCycles - machines.GetCycleCount()));
+				break;
+			}
+
+			machines.RunFrame();
+			scheduler.WaitForNextFrame();
+		}
+
+		const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+		const uint64_t cycles = machines.GetCycleCount() * machines.GetLaneCount();
+
+		std::printf("rom: %s\n", options.romPath);
+		std::printf("lanes: %zu\n", machines.GetLaneCount());
+		std::printf("seed: %016llx\n", static_cast<unsigned long long>(machines.GetRandomSeed()));
+		std::printf("instructions: %llu\n", static_cast<unsigned long long>(cycles));
+		std::printf("seconds: %.3f\n", seconds);
+		std::printf("instructions/sec: %.0f\n", seconds > 0 ? cycles / seconds : 0.0);
+		std::printf("frames: %llu\n", static_cast<unsigned long long>(machines.GetFrameCount()));
+		std::printf("lanes per decode: %.2f\n", machines.GetGroupCount() > 0 ? static_cast<double>(cycles) / machines.GetGroupCount() : 0.0);
+		std::printf("framebuffer hash (lane 0): %016llx\n", static_cast<unsigned long long>(machines.GetDisplayHash(0)));
+
+		return 0;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if (!ParseOptions(argc, argv, options))
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	// Without either budget the run would never end
+	if (options.maxCycles == 0 && options.maxSeconds == 0)
+	{
+		options.maxCycles = static_cast<uint64_t>(options.cyclesPerSecond) * 10;
+	}
+
+	if (!std::ifstream(options.romPath, std::ios::binary))
+	{
+		std::fprintf(stderr, "chip8-headless: can't open %s\n", options.romPath);
+		return 1;
+	}
+
+	if (options.replayPath != nullptr)
+	{
+		return RunReplay(options);
+	}
+
+	if (options.lanes > 0)
+	{
+		if (options.loadStatePath != nullptr || options.saveStatePath != nullptr || options.checkpointPath != nullptr)
+		{
+			std::fprintf(stderr, "chip8-headless: save states aren't supported with --lanes\n");
+			return 1;
+		}
+		if (options.capturePath != nullptr)
+		{
+			std::fprintf(stderr, "chip8-headless: --capture isn't supported with --lanes\n");
+			return 1;
+		}
+		return RunLockstep(options);
+	}
+
+#if CHIP8_TRACE
+	std::unique_ptr<TraceRing> traceRing;
+	std::unique_ptr<TraceWriter> traceWriter;
+	if (options.tracePath != nullptr)
+	{
+		traceRing = std::make_unique<TraceRing>(gTraceRingCapacity);
+		traceWriter = std::make_unique<TraceWriter>(*traceRing, options.tracePath);
+		if (!traceWriter->IsOpen())
+		{
+			std::fprintf(stderr, "chip8-headless: can't write %s\n", options.tracePath);
+			return 1;
+		}
+	}
+#else
+	if (options.tracePath != nullptr)
+	{
+		std::fprintf(stderr, "chip8-headless: --trace needs a build configured with -DCHIP8_ENABLE_TRACE=ON\n");
+		return 1;
+	}
+#endif
+
+#if !CHIP8_PROFILE
+	if (options.profilePath != nullptr)
+	{
+		std::fprintf(stderr, "chip8-headless: --profile needs a build configured with -DCHIP8_ENABLE_PROFILER=ON\n");
+		return 1;
+	}
+#endif
+
+	std::unique_ptr<CHIP> emu = std::make_unique<CHIP>();
+	emu->SetExecutionEngine(options.engine);
+#if CHIP8_TRACE
+	emu->SetTrace(traceRing.get());
+#endif
+#if CHIP8_PROFILE
+	std::unique_ptr<Profiler> profiler;
+	if (options.profilePath != nullptr)
+	{
+		profiler = std::make_unique<Profiler>();
+		emu->SetProfiler(profiler.get());
+	}
+#endif
+	if (options.hasRandomSeed)
+	{
+		emu->SetRandomSeed(options.randomSeed);
+	}
+	if (!emu->LoadROM(options.romPath, options.cyclesPerSecond, options.quirks))
+	{
+		std::fprintf(stderr, "chip8-headless: %s doesn't fit in memory\n", options.romPath);
+		return 1;
+	}
+#ifdef DEBUG
+	emu->SetPaused(false);
+#endif
+	if (options.loadStatePath != nullptr && !LoadStateFrom(*emu, options.loadStatePath))
+	{
+		std::fprintf(stderr, "chip8-headless: %s isn't a save state from this version\n", options.loadStatePath);
+		return 1;
+	}
+
+	std::unique_ptr<StatePackWriter> checkpoints;
+	if (options.checkpointPath != nullptr)
+	{
+		checkpoints = std::make_unique<StatePackWriter>(options.checkpointPath);
+		if (!checkpoints->IsOpen())
+		{
+			std::fprintf(stderr, "chip8-headless: can't write %s\n", options.checkpointPath);
+			return 1;
+		}
+	}
+	// Frames the encoder couldn't keep up with are dropped rather than slowing the run down, unless --capture-wait
+	std::unique_ptr<CaptureWriter> capture;
+	if (options.capturePath != nullptr)
+	{
+		capture = std::make_unique<CaptureWriter>(options.capturePath, options.captureOverflow);
+		if (!capture->IsOpen())
+		{
+			std::fprintf(stderr, "chip8-headless: can't write %s\n", options.capturePath);
+			return 1;
+		}
+		emu->SetCapture(capture.get());
+	}
+	// Roughly 4 KB, kept off the stack
+	std::unique_ptr<MachineState> state = std::make_unique<MachineState>();
+
+	using Clock = FrameScheduler::Clock;
+	FrameScheduler scheduler(gFrameRate);
+	scheduler.SetTurbo(options.unlimited);
+	const Clock::time_point start = Clock::now();
+
+	// Step in whole emulated frames so the timers see the same cadence as in the SDL frontend, only a final partial
+	// frame stops exactly at --cycles
+	while (true)
+	{
+		if (options.maxCycles > 0 && emu->GetCycleCount() >= options.maxCycles)
+		{
+			break;
+		}
+		if (options.maxSeconds > 0 && std::chrono::duration<double>(Clock::now() - start).count() >= options.maxSeconds)
+		{
+			break;
+		}
+
+		if (options.maxCycles > 0 && emu->GetFrameEndCycle() > options.maxCycles)
+		{
+			emu->RunCycles(static_cast<uint32_t>(options.maxCycles - emu->GetCycleCount()));
+			break;
+		}
+
+		emu->RunFrame();
+		if (checkpoints && emu->GetFrameCount() % gCheckpointInterval == 0)
+		{
+			emu->SaveState(*state);
+			checkpoints->Add(*state);
+		}
+		scheduler.WaitForNextFrame();
+	}
+
+	const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	const uint64_t cycles = emu->GetCycleCount();
+	const uint64_t framebufferHash = emu->GetDisplayHash();
+
+	std::printf("rom: %s\n", options.romPath);
+	std::printf("quirks: %s\n", GetQuirkProfileName(emu->GetQuirkProfile()));
+	std::printf("seed: %016llx\n", static_cast<unsigned long long>(emu->GetRandomSeed()));
+	std::printf("instructions: %llu\n", static_cast<unsigned long long>(cycles));
+	std::printf("seconds: %.3f\n", seconds);
+	std::printf("instructions/sec: %.0f\n", seconds > 0 ? cycles / seconds : 0.0);
+	std::printf("frames: %llu\n", static_cast<unsigned long long>(emu->GetFrameCount()));
+	std::printf("fusions: %llu draw, %llu delay wait, %llu counted loop\n",
+		static_cast<unsigned long long>(emu->GetFusionCount(Fusion::LoadAndDraw)),
+		static_cast<unsigned long long>(emu->GetFusionCount(Fusion::WaitForDelay)),
+		static_cast<unsigned long long>(emu->GetFusionCount(Fusion::CountedLoop)));
+	std::printf("framebuffer hash: %016llx\n", static_cast<unsigned long long>(framebufferHash));
+#if CHIP8_TRACE
+	if (traceRing)
+	{
+		std::printf("trace records dropped: %llu\n", static_cast<unsigned long long>(traceRing->GetDropped()));
+	}
+#endif
+
+#if CHIP8_PROFILE
+	if (profiler && !profiler->WriteJson(options.profilePath))
+	{
+		std::fprintf(stderr, "chip8-headless: can't write %s\n", options.profilePath);
+	}
+#endif
+	if (checkpoints)
+	{
+		std::printf("checkpoints: %zu\n", checkpoints->GetCount());
+	}
+	if (capture)
+	{
+		std::printf("capture frames dropped: %llu\n", static_cast<unsigned long long>(capture->GetDropped()));
+	}
+	if (options.saveStatePath != nullptr)
+	{
+		emu->SaveState(*state);
+		if (!WriteStateFile(options.saveStatePath, *state))
+		{
+			std::fprintf(stderr, "chip8-headless: can't write %s\n", options.saveStatePath);
+		}
+	}
+
+	return 0;
+}
\ No newline at end of file
@@ -0,0 +1,698 @@
+#include "Jit.h"
+#include "Chip8.h"
+
+#include <bit>
+#include <cstring>
+
+#if CHIP8_JIT_SUPPORTED
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+namespace {
+
+	constexpr size_t gCodeArenaSize = 4 * 1024 * 1024;
+	// Longest run of guest instructions compiled into one block
+	constexpr uint16_t gMaxBlockLength = 64;
+	// Blocks overwritten more than this are left to the interpreter for good
+	constexpr uint8_t gMaxInvalidations = 4;
+
+	enum Reg : uint8_t
+	{
+		RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+		R8, R9, R10, R11, R12, R13, R14, R15,
+	};
+
+	// Guest registers get handed out from here in order. Caller-saved registers come first so small blocks don't need to push anything.
+	// RAX, RCX and RDX are scratch, R15 holds the CHIP pointer.
+	constexpr std::array<Reg, 11> gRegisterPool = { R8, R9, R10, R11, RSI, RDI, RBX, RBP, R12, R13, R14 };
+
+	bool IsCalleeSaved(Reg reg)
+	{
+		// RSI and RDI are only callee-saved on Windows, but preserving them everywhere keeps a single code path
+		return reg == RBX || reg == RBP || reg == RSI || reg == RDI || reg >= R12;
+	}
+
+	// Bits 0-15 are V0-VF, bit 16 is the index register
+	constexpr uint32_t gIndexBit = 1 << 16;
+
+	constexpr uint32_t RegisterBit(uint8_t reg)
+	{
+		return 1u << reg;
+	}
+
+	enum class InstructionKind : uint8_t
+	{
+		Unsupported,	// Ends the block before it, the interpreter takes over
+		Body,
+		Terminator,		// Ends the block after it
+	};
+
+	struct InstructionInfo
+	{
+		InstructionKind kind = InstructionKind::Unsupported;
+		uint32_t touched = 0;	// Registers read or written
+		uint32_t written = 0;
+	};
+
+	// 3XNN, 4XNN, 5XY0 and 9XY0, the instructions that conditionally step over the next one
+	constexpr bool IsSkip(uint16_t instruction)
+	{
+		const uint8_t group = instruction >> 12;
+		return group == 0x3 || group == 0x4 || group == 0x5 || group == 0x9;
+	}
+
+	InstructionInfo Classify(uint16_t instruction, const Quirks& quirks)
+	{
+		// XO-CHIP's 5XY2 and 5XY3 write memory and load registers in ranges, they stay with the interpreter
+		if (quirks.instructions == InstructionSet::XoChip && (instruction & 0xF00F) != 0x5000 && (instruction >> 12) == 0x5)
+		{
+			return {};
+		}
+
+		const uint8_t x = (instruction & 0x0F00) >> 8;
+		const uint8_t y = (instruction & 0x00F0) >> 4;
+		const uint32_t vx = RegisterBit(x);
+		const uint32_t vy = RegisterBit(y);
+		const uint32_t vf = RegisterBit(0xF);
+
+		switch (instruction >> 12)
+		{
+		case 0x1: return { InstructionKind::Terminator, 0, 0 };
+		case 0x3:
+		case 0x4: return { InstructionKind::Terminator, vx, 0 };
+		case 0x5:
+		case 0x9: return { InstructionKind::Terminator, vx | vy, 0 };
+		case 0x6: return { InstructionKind::Body, vx, vx };
+		case 0x7: return { InstructionKind::Body, vx, vx };
+		case 0x8:
+			switch (instruction & 0x000F)
+			{
+			case 0x0: return { InstructionKind::Body, vx | vy, vx };
+			case 0x1:
+			case 0x2:
+			case 0x3:
+				if (quirks.resetsFlag)
+				{
+					return { InstructionKind::Body, vx | vy | vf, vx | vf };
+				}
+				return { InstructionKind::Body, vx | vy, vx };
+			case 0x4:
+			case 0x5:
+			case 0x6:
+			case 0x7:
+			case 0xE: return { InstructionKind::Body, vx | vy | vf, vx | vf };
+			}
+			break;
+		case 0xA: return { InstructionKind::Body, gIndexBit, gIndexBit };
+		case 0xB: return { InstructionKind::Terminator, quirks.jumpsWithVx ? vx : RegisterBit(0), 0 };
+		case 0xF:
+			switch (instruction & 0x00FF)
+			{
+			case 0x07: return { InstructionKind::Body, vx, vx };
+			case 0x15:
+			case 0x18: return { InstructionKind::Body, vx, 0 };
+			case 0x1E: return { InstructionKind::Body, vx | gIndexBit, gIndexBit };
+			case 0x65:
+			{
+				const uint32_t loaded = (RegisterBit(x) << 1) - 1;
+				return { InstructionKind::Body, loaded | gIndexBit, loaded | (quirks.indexIncrement != IndexIncrement::None ? gIndexBit : 0) };
+			}
+			}
+			break;
+		}
+
+		return {};
+	}
+
+	// Just enough of an x86-64 assembler for the block translations below.
+	// Guest values are kept zero-extended in 32-bit host registers, and all CHIP state is addressed as [R15 + disp32].
+	class Emitter {
+	public:
+		explicit Emitter(std::vector<uint8_t>& out) : mOut(out) {}
+
+		void MovImm(Reg dst, uint32_t imm)
+		{
+			Rex(false, 0, 0, dst);
+			Byte(0xB8 + (dst & 7));
+			Dword(imm);
+		}
+
+		void Mov(Reg dst, Reg src) { Alu(0x89, dst, src); }
+		void Add(Reg dst, Reg src) { Alu(0x01, dst, src); }
+		void Or(Reg dst, Reg src) { Alu(0x09, dst, src); }
+		void And(Reg dst, Reg src) { Alu(0x21, dst, src); }
+		void Sub(Reg dst, Reg src) { Alu(0x29, dst, src); }
+		void Xor(Reg dst, Reg src) { Alu(0x31, dst, src); }
+		void Cmp(Reg dst, Reg src) { Alu(0x39, dst, src); }
+
+		void AddImm(Reg dst, uint32_t imm) { AluImm(0, dst, imm); }
+		void AndImm(Reg dst, uint32_t imm) { AluImm(4, dst, imm); }
+		void CmpImm(Reg dst, uint32_t imm) { AluImm(7, dst, imm); }
+
+		void Shl1(Reg dst) { Shift(4, dst); }
+		void Shr1(Reg dst) { Shift(5, dst); }
+
+		// Condition codes as used by SETcc/CMOVcc
+		enum Condition : uint8_t { Equal = 0x4, NotEqual = 0x5, Above = 0x7 };
+
+		// Only used with RAX/RCX/RDX, so the byte register never needs a REX prefix
+		void SetZeroExtended(Condition condition, Reg dst)
+		{
+			Byte(0x0F); Byte(0x90 + condition); Byte(ModRM(3, 0, dst));
+			Byte(0x0F); Byte(0xB6); Byte(ModRM(3, dst, dst));
+		}
+
+		void CMov(Condition condition, Reg dst, Reg src)
+		{
+			Rex(false, dst, 0, src);
+			Byte(0x0F); Byte(0x40 + condition); Byte(ModRM(3, dst, src));
+		}
+
+		// movzx dst, byte [r15 + disp]
+		void LoadByte(Reg dst, int32_t disp)
+		{
+			Rex(false, dst, 0, R15);
+			Byte(0x0F); Byte(0xB6); Byte(ModRM(2, dst, R15));
+			Dword(disp);
+		}
+
+		// movzx dst, byte [r15 + index + disp]
+		void LoadByteIndexed(Reg dst, Reg index, int32_t disp)
+		{
+			Rex(false, dst, index, R15);
+			Byte(0x0F); Byte(0xB6); Byte(ModRM(2, dst, RSP)); Byte(ModRM(0, index, R15));
+			Dword(disp);
+		}
+
+		// movzx dst, word [r15 + disp]
+		void LoadWord(Reg dst, int32_t disp)
+		{
+			Rex(false, dst, 0, R15);
+			Byte(0x0F); Byte(0xB7); Byte(ModRM(2, dst, R15));
+			Dword(disp);
+		}
+
+		// mov byte [r15 + disp], src
+		void StoreByte(Reg src, int32_t disp)
+		{
+			// Without a REX prefix encodings 4-7 would mean AH-BH rather than SPL-DIL
+			Rex(false, src, 0, R15, src >= RSP);
+			Byte(0x88); Byte(ModRM(2, src, R15));
+			Dword(disp);
+		}
+
+		// mov word [r15 + disp], src
+		void StoreWord(Reg src, int32_t disp)
+		{
+			Byte(0x66);
+			Rex(false, src, 0, R15);
+			Byte(0x89); Byte(ModRM(2, src, R15));
+			Dword(disp);
+		}
+
+		void MovQ(Reg dst, Reg src)
+		{
+			Rex(true, src, 0, dst);
+			Byte(0x89); Byte(ModRM(3, src, dst));
+		}
+
+		void Push(Reg reg)
+		{
+			Rex(false, 0, 0, reg);
+			Byte(0x50 + (reg & 7));
+		}
+
+		void Pop(Reg reg)
+		{
+			Rex(false, 0, 0, reg);
+			Byte(0x58 + (reg & 7));
+		}
+
+		void Ret() { Byte(0xC3); }
+
+	private:
+		void Alu(uint8_t opcode, Reg dst, Reg src)
+		{
+			Rex(false, src, 0, dst);
+			Byte(opcode); Byte(ModRM(3, src, dst));
+		}
+
+		void AluImm(uint8_t extension, Reg dst, uint32_t imm)
+		{
+			Rex(false, 0, 0, dst);
+			Byte(0x81); Byte(ModRM(3, extension, dst));
+			Dword(imm);
+		}
+
+		void Shift(uint8_t extension, Reg dst)
+		{
+			Rex(false, 0, 0, dst);
+			Byte(0xD1); Byte(ModRM(3, extension, dst));
+		}
+
+		void Rex(bool wide, uint8_t reg, uint8_t index, uint8_t rm, bool force = false)
+		{
+			const uint8_t rex = 0x40 | (wide << 3) | ((reg >> 3) << 2) | ((index >> 3) << 1) | (rm >> 3);
+			if (rex != 0x40 || force)
+			{
+				Byte(rex);
+			}
+		}
+
+		static uint8_t ModRM(uint8_t mod, uint8_t reg, uint8_t rm)
+		{
+			return (mod << 6) | ((reg & 7) << 3) | (rm & 7);
+		}
+
+		void Byte(uint8_t value) { mOut.push_back(value); }
+
+		void Dword(uint32_t value)
+		{
+			for (int i = 0; i < 4; ++i)
+			{
+				Byte(static_cast<uint8_t>(value >> (i * 8)));
+			}
+		}
+
+		std::vector<uint8_t>& mOut;
+	};
+
+	int32_t Displacement(const CHIP& chip, const void* member)
+	{
+		return static_cast<int32_t>(static_cast<const uint8_t*>(member) - reinterpret_cast<const uint8_t*>(&chip));
+	}
+}
+
+Jit::Jit(CHIP& chip)
+	: mChip(chip)
+{
+	static_assert(std::tuple_size_v<decltype(mBlocks)> * 2 == gCachedCodeSize, "Blocks cover exactly the cached region");
+
+#ifdef _WIN32
+	mCode = static_cast<uint8_t*>(VirtualAlloc(nullptr, gCodeArenaSize, MEM_COMMIT | MEM_RESERVE, PAGE_EXECUTE_READWRITE));
+#else
+	void* code = mmap(nullptr, gCodeArenaSize, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	mCode = code == MAP_FAILED ? nullptr : static_cast<uint8_t*>(code);
+#endif
+	mCodeSize = mCode ? gCodeArenaSize : 0;
+}
+
+Jit::~Jit()
+{
+	if (mCode == nullptr)
+	{
+		return;
+	}
+
+#ifdef _WIN32
+	VirtualFree(mCode, 0, MEM_RELEASE);
+#else
+	munmap(mCode, mCodeSize);
+#endif
+}
+
+uint32_t Jit::Step(uint32_t cyclesLeft)
+{
+	const uint16_t pc = mChip.mProgramCounter;
+	if ((pc & 1) == 0 && pc < gCachedCodeSize)
+	{
+		Block& block = mBlocks[pc >> 1];
+		if (block.code == nullptr && !block.interpretOnly)
+		{
+			Compile(pc);
+		}
+
+		if (block.code != nullptr && block.length <= cyclesLeft)
+		{
+			block.code(&mChip);
+			return block.length;
+		}
+	}
+
+	mChip.Process();
+	return 1;
+}
+
+void Jit::Invalidate(uint16_t address)
+{
+	const uint16_t slot = address >> 1;
+	if (slot >= mCoverage.size() || mCoverage[slot] == 0)
+	{
+		return;
+	}
+
+	// A block spans at most one slot past its longest length
+	const uint16_t firstStart = slot >= gMaxBlockLength ? slot - gMaxBlockLength : 0;
+	for (uint16_t start = firstStart; start <= slot; ++start)
+	{
+		const Block& block = mBlocks[start];
+		if (block.code != nullptr && start + block.span > slot)
+		{
+			Discard(start);
+		}
+	}
+}
+
+void Jit::Reset()
+{
+	mBlocks.fill({});
+	mCoverage.fill(0);
+	mCodeUsed = 0;
+}
+
+void Jit::Discard(uint16_t slot)
+{
+	Block& block = mBlocks[slot];
+	for (uint16_t i = 0; i < block.span; ++i)
+	{
+		--mCoverage[slot + i];
+	}
+
+	// The code itself is only reclaimed when the arena gets flushed
+	block.code = nullptr;
+	block.length = 0;
+	block.span = 0;
+
+	// Self-modifying code would just keep recompiling, leave it to the interpreter
+	if (++block.invalidations >= gMaxInvalidations)
+	{
+		block.interpretOnly = true;
+	}
+}
+
+void Jit::Compile(uint16_t address)
+{
+	Block& block = mBlocks[address >> 1];
+	const auto& memory = mChip.mMemory;
+
+	// Blocks are compiled for the profile of the loaded ROM, changing it resets the JIT
+	const Quirks quirks = GetQuirks(mChip.mQuirkProfile);
+
+	// First pass: find where the block ends and which registers it needs
+	std::array<uint16_t, gMaxBlockLength> instructions;
+	uint16_t length = 0;
+	uint32_t touched = 0;
+	uint32_t written = 0;
+	bool terminated = false;
+
+	// XO-CHIP skips step over F000 NNNN's second word too, so a block ending in one also depends on the instruction after it
+	const bool longSkips = quirks.instructions == InstructionSet::XoChip;
+	uint16_t span = 0;
+
+	for (uint16_t pc = address; length < gMaxBlockLength && static_cast<size_t>(pc) + 1 < gCachedCodeSize && !terminated; pc += 2)
+	{
+		const uint16_t instruction = (static_cast<uint16_t>(memory[pc]) << 8) | memory[pc + 1];
+		const InstructionInfo info = Classify(instruction, quirks);
+		if (info.kind == InstructionKind::Unsupported || std::popcount(touched | info.touched) > static_cast<int>(gRegisterPool.size()))
+		{
+			break;
+		}
+
+		if (longSkips && IsSkip(instruction))
+		{
+			// Skipping a long instruction is left to the interpreter, as is a skip whose next instruction isn't cached
+			if (static_cast<size_t>(pc) + 3 >= gCachedCodeSize || (memory[pc + 2] == 0xF0 && memory[pc + 3] == 0x00))
+			{
+				break;
+			}
+			span = 1;
+		}
+
+		instructions[length++] = instruction;
+		touched |= info.touched;
+		written |= info.written;
+		terminated = info.kind == InstructionKind::Terminator;
+	}
+
+	if (length == 0)
+	{
+		block.interpretOnly = true;
+		return;
+	}
+	span += length;
+
+	// Second pass: assign host registers and emit
+	std::array<Reg, 17> hostRegister = {};
+	std::vector<Reg> saved = { R15 };
+	size_t nextRegister = 0;
+	for (uint8_t reg = 0; reg < hostRegister.size(); ++reg)
+	{
+		if (touched & (1u << reg))
+		{
+			hostRegister[reg] = gRegisterPool[nextRegister++];
+			if (IsCalleeSaved(hostRegister[reg]))
+			{
+				saved.push_back(hostRegister[reg]);
+			}
+		}
+	}
+
+	const int32_t registersDisp = Displacement(mChip, mChip.mVariableRegisters.data());
+	const int32_t indexDisp = Displacement(mChip, &mChip.mIndexRegister);
+	const int32_t pcDisp = Displacement(mChip, &mChip.mProgramCounter);
+	const int32_t memoryDisp = Displacement(mChip, mChip.mMemory.data());
+	const int32_t delayDisp = Displacement(mChip, &mChip.mDelayTimer);
+	const int32_t soundDisp = Displacement(mChip, &mChip.mSoundTimer);
+
+	mScratch.clear();
+	Emitter emit(mScratch);
+
+	for (Reg reg : saved)
+	{
+		emit.Push(reg);
+	}
+#ifdef _WIN32
+	emit.MovQ(R15, RCX);
+#else
+	emit.MovQ(R15, RDI);
+#endif
+
+	for (uint8_t reg = 0; reg < 16; ++reg)
+	{
+		if (touched & RegisterBit(reg))
+		{
+			emit.LoadByte(hostRegister[reg], registersDisp + reg);
+		}
+	}
+	if (touched & gIndexBit)
+	{
+		emit.LoadWord(hostRegister[16], indexDisp);
+	}
+
+	const Reg vf = hostRegister[0xF];
+	const Reg index = hostRegister[16];
+
+	// The next program counter is left in ECX for the epilogue
+	emit.MovImm(RCX, address + length * 2);
+
+	for (uint16_t i = 0; i < length; ++i)
+	{
+		const uint16_t instruction = instructions[i];
+		const uint16_t pc = address + i * 2;
+		const Reg vx = hostRegister[(instruction & 0x0F00) >> 8];
+		const Reg vy = hostRegister[(instruction & 0x00F0) >> 4];
+		const uint8_t nn = instruction & 0x00FF;
+		const uint16_t nnn = instruction & 0x0FFF;
+
+		// Each translation mirrors the statement order of the matching OpCode_* handler, so aliasing (e.g. X == F) behaves identically
+		switch (instruction >> 12)
+		{
+		case 0x1:
+			emit.MovImm(RCX, nnn);
+			break;
+		case 0x3:
+		case 0x4:
+			emit.MovImm(RCX, pc + 2);
+			emit.MovImm(RDX, pc + 4);
+			emit.CmpImm(vx, nn);
+			emit.CMov((instruction >> 12) == 0x3 ? Emitter::Equal : Emitter::NotEqual, RCX, RDX);
+			break;
+		case 0x5:
+		case 0x9:
+			emit.MovImm(RCX, pc + 2);
+			emit.MovImm(RDX, pc + 4);
+			emit.Cmp(vx, vy);
+			emit.CMov((instruction >> 12) == 0x5 ? Emitter::Equal : Emitter::NotEqual, RCX, RDX);
+			break;
+		case 0x6:
+			emit.MovImm(vx, nn);
+			break;
+		case 0x7:
+			emit.AddImm(vx, nn);
+			emit.AndImm(vx, 0xFF);
+			break;
+		case 0x8:
+			switch (instruction & 0x000F)
+			{
+			case 0x0: emit.Mov(vx, vy); break;
+			case 0x1:
+			case 0x2:
+			case 0x3:
+				switch (instruction & 0x000F)
+				{
+				case 0x1: emit.Or(vx, vy); break;
+				case 0x2: emit.And(vx, vy); break;
+				case 0x3: emit.Xor(vx, vy); break;
+				}
+				if (quirks.resetsFlag)
+				{
+					emit.MovImm(vf, 0);
+				}
+				break;
+			case 0x4:
+				// VX = VX + VY, then VF = carry
+				emit.Mov(RAX, vx);
+				emit.Add(RAX, vy);
+				emit.Mov(vx, RAX);
+				emit.AndImm(vx, 0xFF);
+				emit.CmpImm(RAX, 0xFF);
+				emit.SetZeroExtended(Emitter::Above, RDX);
+				emit.Mov(vf, RDX);
+				break;
+			case 0x5:
+			case 0x7:
+			{
+				// VX = VX - VY or VY - VX, then VF = no borrow
+				const bool reversed = (instruction & 0x000F) == 0x7;
+				emit.Mov(RAX, reversed ? vy : vx);
+				emit.Mov(RDX, reversed ? vx : vy);
+				emit.Sub(RAX, RDX);
+				emit.SetZeroExtended(Emitter::Above, RDX);
+				emit.AndImm(RAX, 0xFF);
+				emit.Mov(vx, RAX);
+				emit.Mov(vf, RDX);
+				break;
+			}
+			case 0x6:
+				if (quirks.shiftsVy)
+				{
+					emit.Mov(vx, vy);
+				}
+				emit.Mov(RAX, vx);
+				emit.AndImm(RAX, 0x01);
+				emit.Mov(vf, RAX);
+				emit.Shr1(vx);
+				break;
+			case 0xE:
+				if (quirks.shiftsVy)
+				{
+					emit.Mov(vx, vy);
+				}
+				emit.Mov(RAX, vx);
+				emit.AndImm(RAX, 0x80);
+				emit.Mov(vf, RAX);
+				emit.Shl1(vx);
+				emit.AndImm(vx, 0xFF);
+				break;
+			}
+			break;
+		case 0xA:
+			emit.MovImm(index, nnn);
+			break;
+		case 0xB:
+			emit.Mov(RCX, quirks.jumpsWithVx ? vx : hostRegister[0]);
+			emit.AddImm(RCX, nnn);
+			break;
+		case 0xF:
+			switch (instruction & 0x00FF)
+			{
+			case 0x07: emit.LoadByte(vx, delayDisp); break;
+			case 0x15: emit.StoreByte(vx, delayDisp); break;
+			case 0x18: emit.StoreByte(vx, soundDisp); break;
+			case 0x1E:
+				emit.Add(index, vx);
+				emit.AndImm(index, 0xFFFF);
+				break;
+			case 0x65:
+				// I + reg wraps at 64 KB like the interpreter, so an I near the top never reads past mMemory
+				for (uint8_t reg = 0; reg <= (instruction & 0x0F00) >> 8; ++reg)
+				{
+					emit.Mov(RAX, index);
+					if (reg != 0)
+					{
+						emit.AddImm(RAX, reg);
+						emit.AndImm(RAX, 0xFFFF);
+					}
+					emit.LoadByteIndexed(hostRegister[reg], RAX, memoryDisp);
+				}
+				if (quirks.indexIncrement != IndexIncrement::None)
+				{
+					const uint8_t x = (instruction & 0x0F00) >> 8;
+					emit.AddImm(index, quirks.indexIncrement == IndexIncrement::XPlusOne ? x + 1 : x);
+					emit.AndImm(index, 0xFFFF);
+				}
+				break;
+			}
+			break;
+		}
+	}
+
+	for (uint8_t reg = 0; reg < 16; ++reg)
+	{
+		if (written & RegisterBit(reg))
+		{
+			emit.StoreByte(hostRegister[reg], registersDisp + reg);
+		}
+	}
+	if (written & gIndexBit)
+	{
+		emit.StoreWord(index, indexDisp);
+	}
+	emit.StoreWord(RCX, pcDisp);
+
+	for (auto it = saved.rbegin(); it != saved.rend(); ++it)
+	{
+		emit.Pop(*it);
+	}
+	emit.Ret();
+
+	if (mCodeUsed + mScratch.size() > mCodeSize)
+	{
+		if (mScratch.size() > mCodeSize)
+		{
+			block.interpretOnly = true;
+			return;
+		}
+
+		// Out of room, start over. Invalidation counts survive so self-modifying code stays with the interpreter.
+		for (uint16_t slot = 0; slot < mBlocks.size(); ++slot)
+		{
+			if (mBlocks[slot].code != nullptr)
+			{
+				mBlocks[slot].code = nullptr;
+				mBlocks[slot].length = 0;
+				mBlocks[slot].span = 0;
+			}
+		}
+		mCoverage.fill(0);
+		mCodeUsed = 0;
+	}
+
+	uint8_t* code = mCode + mCodeUsed;
+	memcpy(code, mScratch.data(), mScratch.size());
+	mCodeUsed += mScratch.size();
+
+	block.code = reinterpret_cast<BlockFunction>(code);
+	block.length = length;
+	block.span = span;
+	for (uint16_t i = 0; i < span; ++i)
+	{
+		++mCoverage[(address >> 1) + i];
+	}
+}
+
+#else
+
+Jit::Jit(CHIP& chip) : mChip(chip) {}
+Jit::~Jit() = default;
+uint32_t Jit::Step(uint32_t cyclesLeft) { mChip.Process(); return 1; }
+void Jit::Invalidate(uint16_t address) {}
+void Jit::Reset() {}
+
+#endif
\ No newline at end of file
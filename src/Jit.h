@@ -0,0 +1,67 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// The recompiler emits x86-64 machine code, any other host is limited to the interpreter engines
+#if defined(_M_X64) || defined(__x86_64__)
+#define CHIP8_JIT_SUPPORTED 1
+#else
+#define CHIP8_JIT_SUPPORTED 0
+#endif
+
+class CHIP;
+
+// Dynamic recompiler for CHIP::Process().
+// Guest basic blocks starting at mProgramCounter are translated into native x86-64 functions. A block runs until it hits
+// a jump, skip or an instruction the recompiler leaves to the interpreter (calls, returns, DXYN, FX0A, memory writes, ...).
+// The variable and index registers a block touches live in host registers for its whole duration.
+class Jit {
+public:
+	explicit Jit(CHIP& chip);
+	~Jit();
+
+	Jit(const Jit&) = delete;
+	Jit& operator=(const Jit&) = delete;
+
+	// Runs the block at the program counter if it fits in the remaining cycle budget, otherwise interprets a single instruction.
+	// Returns the number of guest instructions executed.
+	uint32_t Step(uint32_t cyclesLeft);
+
+	// Drops any block containing this address, must be called for every guest memory write
+	void Invalidate(uint16_t address);
+	// Drops every block, e.g. after a new ROM has been loaded
+	void Reset();
+
+private:
+	using BlockFunction = void (*)(CHIP* chip);
+
+	struct Block
+	{
+		BlockFunction code = nullptr;
+		uint16_t length = 0;			// Guest instructions in the block, including the terminator
+		uint16_t span = 0;				// Instruction slots the block depends on, one more than length when an XO-CHIP skip had to look past it
+		uint8_t invalidations = 0;
+		bool interpretOnly = false;		// Can't be compiled, or keeps getting overwritten
+	};
+
+	void Compile(uint16_t address);
+	void Discard(uint16_t slot);
+
+	CHIP& mChip;
+
+	// One entry per even address of the first 4 KB (gCachedCodeSize), indexed by the block's starting address.
+	// Code above it is always interpreted.
+	std::array<Block, 4096 / 2> mBlocks;
+	// Number of compiled blocks spanning each instruction slot, so writes to data can skip the block search
+	std::array<uint8_t, 4096 / 2> mCoverage = { 0 };
+
+	// Executable arena that compiled blocks are bump allocated from, flushed entirely when it fills up
+	uint8_t* mCode = nullptr;
+	size_t mCodeSize = 0;
+	size_t mCodeUsed = 0;
+
+	std::vector<uint8_t> mScratch;
+};
\ No newline at end of file
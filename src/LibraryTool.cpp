@@ -0,0 +1,146 @@
+#include "RomLibrary.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+// Builds and edits ROM library indexes, see RomLibrary
+
+namespace {
+
+	void PrintUsage()
+	{
+		std::fprintf(stderr,
+			"usage: chip8-library scan <directory> <index>\n"
+			"       chip8-library list <index>\n"
+			"       chip8-library set <index> <hash> [--speed N] [--quirks vip|chip48|schip|xochip] [--keymap KEYS]\n"
+			"  scan      hash every ROM under directory into index, keeping the settings of ROMs it already had\n"
+			"  list      print every indexed ROM with its settings\n"
+			"  set       change the settings of the ROM with this hash (as printed by list)\n"
+			"  --speed   instructions per second\n"
+			"  --quirks  interpreter the ROM was written for\n"
+			"  --keymap  16 different printable ASCII host keys for CHIP-8 keys 0 to F, e.g. x123qweasdzc4rfv\n");
+	}
+
+	int Scan(const char* directory, const char* indexPath)
+	{
+		size_t romCount = 0;
+		if (!RomLibrary::Scan(directory, indexPath, romCount))
+		{
+			std::fprintf(stderr, "chip8-library: can't index %s into %s\n", directory, indexPath);
+			return 1;
+		}
+
+		std::printf("indexed %zu ROMs\n", romCount);
+		return 0;
+	}
+
+	int List(const char* indexPath)
+	{
+		const RomLibrary library(indexPath);
+		if (!library.IsValid())
+		{
+			std::fprintf(stderr, "chip8-library: %s isn't a ROM index from this version\n", indexPath);
+			return 1;
+		}
+
+		std::printf("%-16s %6s %6s %-7s %-16s %s\n", "hash", "size", "speed", "quirks", "keymap", "path");
+		for (size_t i = 0; i < library.GetCount(); ++i)
+		{
+			const RomIndexEntry& entry = library.GetEntry(i);
+			const RomSettings settings = RomLibrary::GetSettings(entry);
+			const std::string_view path = library.GetPath(entry);
+			std::printf("%016llx %6u %6u %-7s %-16.16s %.*s\n", static_cast<unsigned long long>(entry.hash), entry.size,
+				settings.cyclesPerSecond, GetQuirkProfileName(settings.quirks), settings.keymap.data(), static_cast<int>(path.size()), path.data());
+		}
+		return 0;
+	}
+
+	int Set(int argc, char** argv)
+	{
+		if (argc < 4)
+		{
+			PrintUsage();
+			return 1;
+		}
+
+		const char* indexPath = argv[2];
+		const uint64_t hash = std::strtoull(argv[3], nullptr, 16);
+
+		// Only what's on the command line changes. The index is closed again before it gets rewritten.
+		RomSettings settings;
+		{
+			const RomLibrary library(indexPath);
+			const RomIndexEntry* entry = library.Find(hash);
+			if (entry == nullptr)
+			{
+				std::fprintf(stderr, "chip8-library: %s has no ROM with hash %s\n", indexPath, argv[3]);
+				return 1;
+			}
+			settings = RomLibrary::GetSettings(*entry);
+		}
+
+		for (int i = 4; i < argc; ++i)
+		{
+			const bool hasValue = i + 1 < argc;
+			if (std::strcmp(argv[i], "--speed") == 0 && hasValue)
+			{
+				const unsigned long speed = std::strtoul(argv[++i], nullptr, 10);
+				if (speed == 0 || speed > UINT16_MAX)
+				{
+					PrintUsage();
+					return 1;
+				}
+				settings.cyclesPerSecond = static_cast<uint16_t>(speed);
+			}
+			else if (std::strcmp(argv[i], "--quirks") == 0 && hasValue)
+			{
+				if (!ParseQuirkProfile(argv[++i], settings.quirks))
+				{
+					PrintUsage();
+					return 1;
+				}
+			}
+			else if (std::strcmp(argv[i], "--keymap") == 0 && hasValue)
+			{
+				if (!ParseKeymap(argv[++i], settings.keymap))
+				{
+					PrintUsage();
+					return 1;
+				}
+			}
+			else
+			{
+				PrintUsage();
+				return 1;
+			}
+		}
+
+		if (!RomLibrary::SetSettings(indexPath, hash, settings))
+		{
+			std::fprintf(stderr, "chip8-library: can't write %s\n", indexPath);
+			return 1;
+		}
+		return 0;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc == 4 && std::strcmp(argv[1], "scan") == 0)
+	{
+		return Scan(argv[2], argv[3]);
+	}
+	if (argc == 3 && std::strcmp(argv[1], "list") == 0)
+	{
+		return List(argv[2]);
+	}
+	if (argc >= 2 && std::strcmp(argv[1], "set") == 0)
+	{
+		return Set(argc, argv);
+	}
+
+	PrintUsage();
+	return 1;
+}
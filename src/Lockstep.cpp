@@ -0,0 +1,742 @@
+#include "Lockstep.h"
+#include "Hash.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <type_traits>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+	// Same start address as CHIP::mStartingProgramCounter
+	constexpr uint16_t gProgramStart = 0x200;
+	constexpr uint16_t gAddressMask = gMemorySize - 1;
+
+	// Lane kernels. Bytes holds one 8-bit register for all 32 lanes, Words one 16-bit register split into two halves
+	// of 16 lanes. Lane masks are plain bitmasks, bit N is lane N. Every operation is one or two instructions with
+	// AVX2, the fallback loops are written so the compiler can vectorise them for whatever the target has.
+#if defined(__AVX2__)
+	struct Bytes { __m256i v; };
+	struct Words { __m256i low; __m256i high; };
+
+	inline Bytes LoadBytes(const uint8_t* lanes) { return { _mm256_load_si256(reinterpret_cast<const __m256i*>(lanes)) }; }
+	inline Bytes SplatBytes(uint8_t value) { return { _mm256_set1_epi8(static_cast<char>(value)) }; }
+	inline Bytes Add(Bytes a, Bytes b) { return { _mm256_add_epi8(a.v, b.v) }; }
+	inline Bytes Sub(Bytes a, Bytes b) { return { _mm256_sub_epi8(a.v, b.v) }; }
+	inline Bytes Or(Bytes a, Bytes b) { return { _mm256_or_si256(a.v, b.v) }; }
+	inline Bytes And(Bytes a, Bytes b) { return { _mm256_and_si256(a.v, b.v) }; }
+	inline Bytes Xor(Bytes a, Bytes b) { return { _mm256_xor_si256(a.v, b.v) }; }
+	// No 8-bit shifts in AVX2, shift 16-bit lanes and drop the bit that crossed over from the neighbouring byte
+	inline Bytes ShiftRight1(Bytes a) { return { _mm256_and_si256(_mm256_srli_epi16(a.v, 1), _mm256_set1_epi8(0x7F)) }; }
+	inline Bytes ShiftLeft1(Bytes a) { return { _mm256_add_epi8(a.v, a.v) }; }
+	inline Bytes SaturatingDecrement(Bytes a) { return { _mm256_subs_epu8(a.v, _mm256_set1_epi8(1)) }; }
+
+	inline uint32_t EqualLanes(Bytes a, Bytes b)
+	{
+		return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(a.v, b.v)));
+	}
+
+	// Unsigned a > b, which is exactly when min(a, b) isn't a
+	inline uint32_t GreaterLanes(Bytes a, Bytes b)
+	{
+		return ~EqualLanes({ _mm256_min_epu8(a.v, b.v) }, a);
+	}
+
+	inline __m256i ByteMask(uint32_t lanes)
+	{
+		// Copy mask byte N into bytes 8N to 8N+7, then keep only the bit belonging to each byte
+		const __m256i spread = _mm256_shuffle_epi8(_mm256_set1_epi32(static_cast<int>(lanes)),
+			_mm256_setr_epi64x(0x0000000000000000, 0x0101010101010101, 0x0202020202020202, 0x0303030303030303));
+		const __m256i bits = _mm256_set1_epi64x(static_cast<long long>(0x8040201008040201));
+		return _mm256_cmpeq_epi8(_mm256_and_si256(spread, bits), bits);
+	}
+
+	inline Bytes Select(uint32_t lanes, Bytes set, Bytes clear) { return { _mm256_blendv_epi8(clear.v, set.v, ByteMask(lanes)) }; }
+
+	inline void StoreBytes(uint8_t* lanes, Bytes value, uint32_t mask)
+	{
+		__m256i* destination = reinterpret_cast<__m256i*>(lanes);
+		_mm256_store_si256(destination, _mm256_blendv_epi8(_mm256_load_si256(destination), value.v, ByteMask(mask)));
+	}
+
+	inline Words LoadWords(const uint16_t* lanes)
+	{
+		return { _mm256_load_si256(reinterpret_cast<const __m256i*>(lanes)), _mm256_load_si256(reinterpret_cast<const __m256i*>(lanes + 16)) };
+	}
+	inline Words SplatWords(uint16_t value) { const __m256i v = _mm256_set1_epi16(static_cast<short>(value)); return { v, v }; }
+	inline Words Add(Words a, Words b) { return { _mm256_add_epi16(a.low, b.low), _mm256_add_epi16(a.high, b.high) }; }
+	inline Words Widen(Bytes a)
+	{
+		return { _mm256_cvtepu8_epi16(_mm256_castsi256_si128(a.v)), _mm256_cvtepu8_epi16(_mm256_extracti128_si256(a.v, 1)) };
+	}
+
+	inline uint32_t EqualLanes(Words a, Words b)
+	{
+		// Narrow both compare results to bytes; packs interleaves the 128-bit halves, so put them back in lane order
+		const __m256i packed = _mm256_packs_epi16(_mm256_cmpeq_epi16(a.low, b.low), _mm256_cmpeq_epi16(a.high, b.high));
+		return static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_permute4x64_epi64(packed, 0xD8)));
+	}
+
+	inline __m256i WordMask(uint32_t lanes)
+	{
+		const __m256i bits = _mm256_setr_epi16(0x0001, 0x0002, 0x0004, 0x0008, 0x0010, 0x0020, 0x0040, 0x0080,
+			0x0100, 0x0200, 0x0400, 0x0800, 0x1000, 0x2000, 0x4000, static_cast<short>(0x8000));
+		return _mm256_cmpeq_epi16(_mm256_and_si256(_mm256_set1_epi16(static_cast<short>(lanes)), bits), bits);
+	}
+
+	inline void StoreWords(uint16_t* lanes, Words value, uint32_t mask)
+	{
+		__m256i* low = reinterpret_cast<__m256i*>(lanes);
+		__m256i* high = reinterpret_cast<__m256i*>(lanes + 16);
+		_mm256_store_si256(low, _mm256_blendv_epi8(_mm256_load_si256(low), value.low, WordMask(mask & 0xFFFF)));
+		_mm256_store_si256(high, _mm256_blendv_epi8(_mm256_load_si256(high), value.high, WordMask(mask >> 16)));
+	}
+#else
+	struct Bytes { uint8_t v[gMaxLockstepLanes]; };
+	struct Words { uint16_t v[gMaxLockstepLanes]; };
+
+	template <typename Lanes, typename Operation>
+	inline Lanes Map(const Lanes& a, const Lanes& b, Operation operation)
+	{
+		Lanes result;
+		for (size_t i = 0; i < gMaxLockstepLanes; ++i)
+		{
+			result.v[i] = static_cast<std::remove_reference_t<decltype(result.v[0])>>(operation(a.v[i], b.v[i]));
+		}
+		return result;
+	}
+
+	inline Bytes LoadBytes(const uint8_t* lanes) { Bytes result; std::memcpy(result.v, lanes, sizeof(result.v)); return result; }
+	inline Bytes SplatBytes(uint8_t value) { Bytes result; std::memset(result.v, value, sizeof(result.v)); return result; }
+	inline Bytes Add(Bytes a, Bytes b) { return Map(a, b, [](uint8_t x, uint8_t y) { return x + y; }); }
+	inline Bytes Sub(Bytes a, Bytes b) { return Map(a, b, [](uint8_t x, uint8_t y) { return x - y; }); }
+	inline Bytes Or(Bytes a, Bytes b) { return Map(a, b, [](uint8_t x, uint8_t y) { return x | y; }); }
+	inline Bytes And(Bytes a, Bytes b) { return Map(a, b, [](uint8_t x, uint8_t y) { return x & y; }); }
+	inline Bytes Xor(Bytes a, Bytes b) { return Map(a, b, [](uint8_t x, uint8_t y) { return x ^ y; }); }
+	inline Bytes ShiftRight1(Bytes a) { return Map(a, a, [](uint8_t x, uint8_t) { return x >> 1; }); }
+	inline Bytes ShiftLeft1(Bytes a) { return Map(a, a, [](uint8_t x, uint8_t) { return x << 1; }); }
+	inline Bytes SaturatingDecrement(Bytes a) { return Map(a, a, [](uint8_t x, uint8_t) { return x > 0 ? x - 1 : 0; }); }
+
+	inline uint32_t EqualLanes(Bytes a, Bytes b)
+	{
+		uint32_t lanes = 0;
+		for (size_t i = 0; i < gMaxLockstepLanes; ++i)
+		{
+			lanes |= static_cast<uint32_t>(a.v[i] == b.v[i]) << i;
+		}
+		return lanes;
+	}
+
+	inline uint32_t GreaterLanes(Bytes a, Bytes b)
+	{
+		uint32_t lanes = 0;
+		for (size_t i = 0; i < gMaxLockstepLanes; ++i)
+		{
+			lanes |= static_cast<uint32_t>(a.v[i] > b.v[i]) << i;
+		}
+		return lanes;
+	}
+
+	inline Bytes Select(uint32_t lanes, Bytes set, Bytes clear)
+	{
+		for (size_t i = 0; i < gMaxLockstepLanes; ++i)
+		{
+			clear.v[i] = (lanes >> i & 1) ? set.v[i] : clear.v[i];
+		}
+		return clear;
+	}
+
+	// Without vector blends, visiting only the lanes in the mask is cheaper than a select across all 32
+	inline void StoreBytes(uint8_t* lanes, Bytes value, uint32_t mask)
+	{
+		for (; mask != 0; mask &= mask - 1)
+		{
+			const int i = std::countr_zero(mask);
+			lanes[i] = value.v[i];
+		}
+	}
+
+	inline Words LoadWords(const uint16_t* lanes) { Words result; std::memcpy(result.v, lanes, sizeof(result.v)); return result; }
+	inline Words SplatWords(uint16_t value) { Words result; std::fill(std::begin(result.v), std::end(result.v), value); return result; }
+	inline Words Add(Words a, Words b) { return Map(a, b, [](uint16_t x, uint16_t y) { return x + y; }); }
+	inline Words Widen(Bytes a) { Words result; std::copy(std::begin(a.v), std::end(a.v), std::begin(result.v)); return result; }
+
+	inline uint32_t EqualLanes(Words a, Words b)
+	{
+		uint32_t lanes = 0;
+		for (size_t i = 0; i < gMaxLockstepLanes; ++i)
+		{
+			lanes |= static_cast<uint32_t>(a.v[i] == b.v[i]) << i;
+		}
+		return lanes;
+	}
+
+	inline void StoreWords(uint16_t* lanes, Words value, uint32_t mask)
+	{
+		for (; mask != 0; mask &= mask - 1)
+		{
+			const int i = std::countr_zero(mask);
+			lanes[i] = value.v[i];
+		}
+	}
+#endif
+
+	// Calls function(lane) for each lane in the mask, lowest first
+	template <typename Function>
+	inline void ForEachLane(uint32_t lanes, Function function)
+	{
+		while (lanes != 0)
+		{
+			function(static_cast<size_t>(std::countr_zero(lanes)));
+			lanes &= lanes - 1;
+		}
+	}
+}
+
+LockstepChip::LockstepChip(size_t laneCount)
+	: mLaneCount(laneCount)
+	, mAllLanes(laneCount >= 32 ? ~0u : (1u << laneCount) - 1)
+	, mMemory(laneCount)
+	, mDisplays(laneCount)
+	, mAddressStacks(laneCount)
+	, mFlagRegisters(laneCount)
+{
+	assert(laneCount > 0 && laneCount <= gMaxLockstepLanes && "Lane count must fit in one 256-bit vector of bytes");
+
+	mRandom.resize(laneCount);
+	std::random_device seed;
+	SetRandomSeed((static_cast<uint64_t>(seed()) << 32) | seed());
+}
+
+void LockstepChip::SetRandomSeed(uint64_t seed)
+{
+	mRandomSeed = seed;
+	Random random(seed);
+	for (Random& lane : mRandom)
+	{
+		lane = random;
+		random.Jump();
+	}
+}
+
+bool LockstepChip::LoadROM(const char* romPath, uint16_t cyclesPerSecond /* = 700 */, QuirkProfile quirks /* = QuirkProfile::CosmacVip */)
+{
+	assert(cyclesPerSecond > 0 && "The program has to make some progress each second");
+
+	const MappedFile rom(romPath);
+	if (!rom.IsOpen() || rom.Size() > gMaxRomSize)
+	{
+		return false;
+	}
+
+	Memory image = {};
+	std::memcpy(&image[gDefaultFontStartAddress], gDefaultFont.data(), sizeof(gDefaultFont));
+	std::memcpy(&image[gBigFontStartAddress], gBigFont.data(), sizeof(gBigFont));
+	std::memcpy(&image[gProgramStart], rom.Data(), rom.Size());
+
+	for (size_t lane = 0; lane < mLaneCount; ++lane)
+	{
+		mMemory[lane] = image;
+		mDisplays[lane] = {};
+		mAddressStacks[lane].clear();
+	}
+
+	mVariableRegisters = {};
+	mIndexRegisters.fill(0);
+	mProgramCounters.fill(gProgramStart);
+	mDelayTimers.fill(0);
+	mSoundTimers.fill(0);
+	mHighResolution.fill(0);
+	mPlaneMasks.fill(1);
+	mWrittenLanes.fill(0);
+
+	mQuirkProfile = quirks;
+	mCyclesPerSecond = cyclesPerSecond;
+	mFrameCycleRemainder = 0;
+	mCycleCount = 0;
+	mFrameCount = 0;
+	mGroupCount = 0;
+	SetRandomSeed(mRandomSeed);
+	return true;
+}
+
+void LockstepChip::RunCycles(uint32_t cycles)
+{
+	switch (mQuirkProfile)
+	{
+	case QuirkProfile::CosmacVip: RunCycles<QuirkProfile::CosmacVip>(cycles); break;
+	case QuirkProfile::Chip48: RunCycles<QuirkProfile::Chip48>(cycles); break;
+	case QuirkProfile::SuperChip: RunCycles<QuirkProfile::SuperChip>(cycles); break;
+	case QuirkProfile::XoChip: RunCycles<QuirkProfile::XoChip>(cycles); break;
+	default: assert(false && "Unknown quirk profile."); break;
+	}
+}
+
+template<QuirkProfile Profile>
+void LockstepChip::RunCycles(uint32_t cycles)
+{
+	for (uint32_t cycle = 0; cycle < cycles; ++cycle)
+	{
+		// Every lane executes one instruction per cycle, in groups of lanes that are at the same PC.
+		// Converged lanes form a single group, so the instruction is decoded and applied once for all of them.
+		uint32_t remaining = mAllLanes;
+		while (remaining != 0)
+		{
+			const size_t leader = static_cast<size_t>(std::countr_zero(remaining));
+			const uint16_t pc = mProgramCounters[leader];
+			const uint16_t instruction = FetchInstruction(leader, pc);
+
+			uint32_t group = EqualLanes(LoadWords(mProgramCounters.data()), SplatWords(pc)) & remaining;
+
+			// Lanes that wrote over this code may be running something else at the same address. When the leader is one
+			// of them, the untouched lanes are the ones that may differ, so every lane gets compared.
+			const uint32_t written = mWrittenLanes[(pc & gAddressMask) >> 6] | mWrittenLanes[((pc + 1) & gAddressMask) >> 6];
+			const uint32_t rewritten = group & ((written >> leader) & 1 ? ~0u : written);
+			ForEachLane(rewritten, [&](size_t lane)
+			{
+				if (FetchInstruction(lane, pc) != instruction)
+				{
+					group &= ~(1u << lane);
+				}
+			});
+
+			StoreWords(mProgramCounters.data(), Add(LoadWords(mProgramCounters.data()), SplatWords(2)), group);
+			Execute<Profile>(Operands(instruction), group);
+
+			remaining &= ~group;
+			++mGroupCount;
+		}
+	}
+
+	mCycleCount += cycles;
+}
+
+void LockstepChip::RunFrame()
+{
+	const uint32_t frameCycles = mCyclesPerSecond + mFrameCycleRemainder;
+	mFrameCycleRemainder = frameCycles % gFrameRate;
+	RunCycles(frameCycles / gFrameRate);
+
+	StoreBytes(mDelayTimers.data(), SaturatingDecrement(LoadBytes(mDelayTimers.data())), mAllLanes);
+	StoreBytes(mSoundTimers.data(), SaturatingDecrement(LoadBytes(mSoundTimers.data())), mAllLanes);
+
+	++mFrameCount;
+}
+
+void LockstepChip::SetKey(size_t lane, uint8_t key, bool pressed)
+{
+	const uint16_t bit = static_cast<uint16_t>(1u << (key & 0xF));
+	mKeypads[lane] = pressed ? (mKeypads[lane] | bit) : (mKeypads[lane] & ~bit);
+}
+
+uint64_t LockstepChip::GetDisplayHash(size_t lane) const
+{
+	return HashDisplay(mDisplays[lane], mHighResolution[lane], mQuirkProfile == QuirkProfile::XoChip ? gDisplayPlanes : 1, gHashSeed);
+}
+
+uint16_t LockstepChip::FetchInstruction(size_t lane, uint16_t address) const
+{
+	const Memory& memory = mMemory[lane];
+	return static_cast<uint16_t>((memory[address & gAddressMask] << 8) | memory[(address + 1) & gAddressMask]);
+}
+
+void LockstepChip::WriteMemory(size_t lane, uint16_t address, uint8_t value)
+{
+	address &= gAddressMask;
+	mMemory[lane][address] = value;
+	mWrittenLanes[address >> 6] |= 1u << lane;
+}
+
+template<QuirkProfile Profile>
+void LockstepChip::Skip(uint32_t lanes)
+{
+	if constexpr (GetQuirks(Profile).instructions == InstructionSet::XoChip)
+	{
+		ForEachLane(lanes, [&](size_t lane)
+		{
+			mProgramCounters[lane] += FetchInstruction(lane, mProgramCounters[lane]) == 0xF000 ? 4 : 2;
+		});
+		return;
+	}
+	StoreWords(mProgramCounters.data(), Add(LoadWords(mProgramCounters.data()), SplatWords(2)), lanes);
+}
+
+template<QuirkProfile Profile>
+uint8_t LockstepChip::GetSelectedPlanes(size_t lane) const
+{
+	if constexpr (GetQuirks(Profile).instructions == InstructionSet::XoChip)
+	{
+		return mPlaneMasks[lane];
+	}
+	return 1;
+}
+
+template<QuirkProfile Profile>
+void LockstepChip::Execute(const Operands& operands, uint32_t lanes)
+{
+	constexpr Quirks quirks = GetQuirks(Profile);
+
+	// Mirrors CHIP::LookupHandler(), with each handler's effects written as lane-wide operations.
+	// Loads and stores happen in the same order as the handlers', so X or Y being F behaves the same.
+	uint8_t* vx = mVariableRegisters[operands.x].data();
+	uint8_t* vf = mVariableRegisters[0xF].data();
+	const Bytes x = LoadBytes(vx);
+	const Bytes y = LoadBytes(mVariableRegisters[operands.y].data());
+	uint16_t* pc = mProgramCounters.data();
+
+	switch (operands.instruction >> 12)
+	{
+	case 0x1:
+		StoreWords(pc, SplatWords(operands.nnn), lanes);
+		return;
+	case 0x3:
+		Skip<Profile>(lanes & EqualLanes(x, SplatBytes(operands.nn)));
+		return;
+	case 0x4:
+		Skip<Profile>(lanes & ~EqualLanes(x, SplatBytes(operands.nn)));
+		return;
+	case 0x5:
+		if (quirks.instructions == InstructionSet::XoChip && (operands.n == 0x2 || operands.n == 0x3))
+		{
+			break;
+		}
+		Skip<Profile>(lanes & EqualLanes(x, y));
+		return;
+	case 0x6:
+		StoreBytes(vx, SplatBytes(operands.nn), lanes);
+		return;
+	case 0x7:
+		StoreBytes(vx, Add(x, SplatBytes(operands.nn)), lanes);
+		return;
+	case 0x8:
+		switch (operands.n)
+		{
+		case 0x0: StoreBytes(vx, y, lanes); return;
+		case 0x1:
+		case 0x2:
+		case 0x3:
+			StoreBytes(vx, operands.n == 0x1 ? Or(x, y) : operands.n == 0x2 ? And(x, y) : Xor(x, y), lanes);
+			if constexpr (quirks.resetsFlag)
+			{
+				StoreBytes(vf, SplatBytes(0), lanes);
+			}
+			return;
+		case 0x4:
+			// vx + vy overflows exactly when vx > 255 - vy
+			StoreBytes(vx, Add(x, y), lanes);
+			StoreBytes(vf, Select(GreaterLanes(x, Xor(y, SplatBytes(0xFF))), SplatBytes(1), SplatBytes(0)), lanes);
+			return;
+		case 0x5:
+			StoreBytes(vx, Sub(x, y), lanes);
+			StoreBytes(vf, Select(GreaterLanes(x, y), SplatBytes(1), SplatBytes(0)), lanes);
+			return;
+		case 0x7:
+			StoreBytes(vx, Sub(y, x), lanes);
+			StoreBytes(vf, Select(GreaterLanes(y, x), SplatBytes(1), SplatBytes(0)), lanes);
+			return;
+		case 0x6:
+			if constexpr (quirks.shiftsVy)
+			{
+				StoreBytes(vx, y, lanes);
+			}
+			StoreBytes(vf, And(LoadBytes(vx), SplatBytes(0x01)), lanes);
+			StoreBytes(vx, ShiftRight1(LoadBytes(vx)), lanes);
+			return;
+		case 0xE:
+			if constexpr (quirks.shiftsVy)
+			{
+				StoreBytes(vx, y, lanes);
+			}
+			StoreBytes(vf, And(LoadBytes(vx), SplatBytes(0x80)), lanes);
+			StoreBytes(vx, ShiftLeft1(LoadBytes(vx)), lanes);
+			return;
+		}
+		break;
+	case 0x9:
+		Skip<Profile>(lanes & ~EqualLanes(x, y));
+		return;
+	case 0xA:
+		StoreWords(mIndexRegisters.data(), SplatWords(operands.nnn), lanes);
+		return;
+	case 0xB:
+		StoreWords(pc, Add(SplatWords(operands.nnn), Widen(LoadBytes(mVariableRegisters[quirks.jumpsWithVx ? operands.x : 0].data()))), lanes);
+		return;
+	case 0xF:
+		switch (operands.nn)
+		{
+		case 0x07: StoreBytes(vx, LoadBytes(mDelayTimers.data()), lanes); return;
+		case 0x15: StoreBytes(mDelayTimers.data(), x, lanes); return;
+		case 0x18: StoreBytes(mSoundTimers.data(), x, lanes); return;
+		case 0x1E: StoreWords(mIndexRegisters.data(), Add(LoadWords(mIndexRegisters.data()), Widen(x)), lanes); return;
+		}
+		break;
+	}
+
+	// Everything touching memory, the stack, the display, the keypad or the RNG works on each lane's own copy
+	ExecutePerLane<Profile>(operands, lanes);
+}
+
+template<QuirkProfile Profile>
+void LockstepChip::ExecutePerLane(const Operands& operands, uint32_t lanes)
+{
+	constexpr Quirks quirks = GetQuirks(Profile);
+	const uint16_t instruction = operands.instruction;
+	// FX55 and FX65 leave I this far along
+	const uint16_t indexIncrement = quirks.indexIncrement == IndexIncrement::XPlusOne ? operands.x + 1 : quirks.indexIncrement == IndexIncrement::X ? operands.x : 0;
+
+	ForEachLane(lanes, [&](size_t lane)
+	{
+		const Memory& memory = mMemory[lane];
+		uint8_t& vx = mVariableRegisters[operands.x][lane];
+		uint16_t& index = mIndexRegisters[lane];
+		uint16_t& pc = mProgramCounters[lane];
+
+		DisplayPlanes& display = mDisplays[lane];
+		const bool highResolution = mHighResolution[lane] != 0;
+		const uint8_t planes = GetSelectedPlanes<Profile>(lane);
+
+		switch (instruction >> 12)
+		{
+		case 0x0:
+			if (instruction == 0x00E0)
+			{
+				for (size_t plane = 0; plane < gDisplayPlanes; ++plane)
+				{
+					if (planes >> plane & 1)
+					{
+						display[plane].fill(0);
+					}
+				}
+				return;
+			}
+			if (instruction == 0x00EE)
+			{
+				// A bad return or call leaves the lane stuck on it, as CHIP does
+				if (mAddressStacks[lane].empty())
+				{
+					pc -= 2;
+					return;
+				}
+				pc = mAddressStacks[lane].back();
+				mAddressStacks[lane].pop_back();
+				return;
+			}
+			if constexpr (quirks.instructions != InstructionSet::Chip8)
+			{
+				// The scroll kernels are the same ones CHIP uses, only the dirty rows they return go unused
+				for (size_t plane = 0; plane < gDisplayPlanes; ++plane)
+				{
+					if ((planes >> plane & 1) == 0)
+					{
+						continue;
+					}
+					if ((instruction & 0xFFF0) == 0x00C0)
+					{
+						ScrollDown(display[plane], highResolution, operands.n);
+					}
+					else if ((instruction & 0xFFF0) == 0x00D0 && quirks.instructions == InstructionSet::XoChip)
+					{
+						ScrollUp(display[plane], highResolution, operands.n);
+					}
+					else if (instruction == 0x00FB)
+					{
+						ScrollRight(display[plane], highResolution, 4);
+					}
+					else if (instruction == 0x00FC)
+					{
+						ScrollLeft(display[plane], highResolution, 4);
+					}
+				}
+				if ((instruction & 0xFFF0) == 0x00C0 || ((instruction & 0xFFF0) == 0x00D0 && quirks.instructions == InstructionSet::XoChip)
+					|| instruction == 0x00FB || instruction == 0x00FC)
+				{
+					return;
+				}
+				if (instruction == 0x00FD)
+				{
+					pc -= 2;
+					return;
+				}
+				if (instruction == 0x00FE || instruction == 0x00FF)
+				{
+					mHighResolution[lane] = instruction == 0x00FF;
+					display = {};
+					return;
+				}
+			}
+			break;
+		case 0x2:
+			if (mAddressStacks[lane].size() >= gStackDepth)
+			{
+				pc -= 2;
+				return;
+			}
+			mAddressStacks[lane].push_back(pc);
+			pc = operands.nnn;
+			return;
+		case 0xC:
+			vx = mRandom[lane].NextByte() & operands.nn;
+			return;
+		case 0xD:
+		{
+			const uint8_t xPos = vx % GetDisplayWidth(lane);
+			const uint8_t yPos = mVariableRegisters[operands.y][lane] % GetDisplayHeight(lane);
+			const bool wide = quirks.instructions != InstructionSet::Chip8 && operands.n == 0;
+			const uint8_t rows = wide ? 16 : operands.n;
+			const uint16_t spriteSize = wide ? 32 : rows;
+
+			uint16_t address = index;
+			bool collided = false;
+			for (size_t plane = 0; plane < gDisplayPlanes; ++plane)
+			{
+				if ((planes >> plane & 1) == 0)
+				{
+					continue;
+				}
+
+				std::array<uint8_t, 32> sprite;
+				for (uint16_t i = 0; i < spriteSize; ++i)
+				{
+					sprite[i] = memory[(address + i) & gAddressMask];
+				}
+				DrawSprite(display[plane], highResolution, xPos, yPos, sprite.data(), rows, wide, quirks.wrapsSprites, collided);
+				address += spriteSize;
+			}
+			mVariableRegisters[0xF][lane] = collided;
+			return;
+		}
+		case 0xE:
+		{
+			// Keys past F read beyond CHIP's keypad array, here they just count as released
+			const bool pressed = vx < 16 && (mKeypads[lane] >> vx & 1) != 0;
+			if (operands.nn == 0x9E)
+			{
+				Skip<Profile>(pressed ? 1u << lane : 0);
+				return;
+			}
+			if (operands.nn == 0xA1)
+			{
+				Skip<Profile>(pressed ? 0 : 1u << lane);
+				return;
+			}
+			break;
+		}
+		case 0xF:
+			switch (operands.nn)
+			{
+			case 0x0A:
+				pc -= 2;
+				for (uint8_t key = 0; key < 16; ++key)
+				{
+					if (mKeypads[lane] >> key & 1)
+					{
+						pc += 2;
+						vx = key;
+					}
+				}
+				return;
+			case 0x29:
+				index = memory[gDefaultFontStartAddress + static_cast<uint8_t>(vx * gDefaultFontHeight)];
+				return;
+			case 0x33:
+			{
+				uint8_t input = vx;
+				uint8_t address = static_cast<uint8_t>(index);
+				while (input > 0)
+				{
+					WriteMemory(lane, address, input % 10);
+					++address;
+					input /= 10;
+				}
+				return;
+			}
+			case 0x55:
+				for (int i = 0; i <= operands.x; ++i)
+				{
+					WriteMemory(lane, index + i, mVariableRegisters[i][lane]);
+				}
+				index += indexIncrement;
+				return;
+			case 0x65:
+				for (int i = 0; i <= operands.x; ++i)
+				{
+					mVariableRegisters[i][lane] = memory[(index + i) & gAddressMask];
+				}
+				index += indexIncrement;
+				return;
+			}
+			if constexpr (quirks.instructions != InstructionSet::Chip8)
+			{
+				switch (operands.nn)
+				{
+				case 0x30:
+					index = gBigFontStartAddress + (vx & 0xF) * gBigFontHeight;
+					return;
+				case 0x75:
+					for (int i = 0; i <= operands.x; ++i)
+					{
+						mFlagRegisters[lane][i] = mVariableRegisters[i][lane];
+					}
+					return;
+				case 0x85:
+					for (int i = 0; i <= operands.x; ++i)
+					{
+						mVariableRegisters[i][lane] = mFlagRegisters[lane][i];
+					}
+					return;
+				}
+			}
+			if constexpr (quirks.instructions == InstructionSet::XoChip)
+			{
+				if (instruction == 0xF000)
+				{
+					index = FetchInstruction(lane, pc);
+					pc += 2;
+					return;
+				}
+				if (operands.nn == 0x01)
+				{
+					mPlaneMasks[lane] = operands.x & 0x3;
+					return;
+				}
+				// Lanes have no audio output, the pattern and pitch would go nowhere
+				if (instruction == 0xF002 || operands.nn == 0x3A)
+				{
+					return;
+				}
+			}
+			break;
+		case 0x5:
+			if constexpr (quirks.instructions == InstructionSet::XoChip)
+			{
+				// 5XY2 and 5XY3, VX to VY in either direction, leaving I alone
+				const int step = operands.x <= operands.y ? 1 : -1;
+				const int count = std::abs(operands.y - operands.x) + 1;
+				for (int i = 0; i < count; ++i)
+				{
+					uint8_t& reg = mVariableRegisters[operands.x + i * step][lane];
+					if (operands.n == 0x2)
+					{
+						WriteMemory(lane, index + i, reg);
+					}
+					else
+					{
+						reg = memory[(index + i) & gAddressMask];
+					}
+				}
+				return;
+			}
+			break;
+		}
+
+		assert(false && "Opcode not found in instruction set.");
+	});
+}
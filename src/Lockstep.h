@@ -0,0 +1,109 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Chip8.h"
+
+// Most machines a LockstepChip can run, one per byte of a 256-bit vector
+constexpr size_t gMaxLockstepLanes = 32;
+
+// Runs up to 32 copies of the same ROM side by side, e.g. with different input streams.
+// Registers, timers, index registers and program counters are stored structure-of-arrays style, one lane per machine,
+// so an instruction is decoded once and applied to every lane sitting at the same PC with a handful of AVX2 operations
+// (when the core is built with CHIP8_ENABLE_AVX2, plain loops otherwise). Lanes that diverge are regrouped by PC each
+// step. Memory, stacks and displays stay per lane.
+// Instruction semantics follow CHIP's OpCode_* handlers exactly, including their quirks, and the quirk profile is a
+// template argument here too.
+class LockstepChip {
+public:
+	explicit LockstepChip(size_t laneCount);
+
+	// Lane n's CXNN draws from the n-th Random::Jump() of a generator seeded with this, so lane 0 matches a CHIP with the
+	// same seed and no two lanes share a stream. Reseeded on every LoadROM(), starts out random.
+	void SetRandomSeed(uint64_t seed);
+	inline uint64_t GetRandomSeed() const { return mRandomSeed; }
+
+	// Loads the same ROM into every lane and resets them, false if it can't be read or is too big
+	bool LoadROM(const char* romPath, uint16_t cyclesPerSecond = 700, QuirkProfile quirks = QuirkProfile::CosmacVip);
+	// Every lane executes exactly this many instructions
+	void RunCycles(uint32_t cycles);
+	// Same frame cadence as CHIP::RunFrame()
+	void RunFrame();
+
+	void SetKey(size_t lane, uint8_t key, bool pressed);
+
+	inline size_t GetLaneCount() const { return mLaneCount; }
+	// Same layout as CHIP::GetDisplayPlane()
+	inline const uint64_t* GetDisplayPlane(size_t lane, size_t plane) const { return mDisplays[lane][plane].data(); }
+	inline uint8_t GetDisplayWidth(size_t lane) const { return mHighResolution[lane] ? gHiResDisplayWidth : DISPLAY_WIDTH; }
+	inline uint8_t GetDisplayHeight(size_t lane) const { return mHighResolution[lane] ? gHiResDisplayHeight : DISPLAY_HEIGHT; }
+	uint64_t GetDisplayHash(size_t lane) const;
+
+	inline uint8_t GetRegister(size_t lane, uint8_t index) const { return mVariableRegisters[index][lane]; }
+	inline uint16_t GetIndexRegister(size_t lane) const { return mIndexRegisters[lane]; }
+	inline uint16_t GetProgramCounter(size_t lane) const { return mProgramCounters[lane]; }
+
+	// Instructions each lane has executed since the ROM was loaded
+	inline uint64_t GetCycleCount() const { return mCycleCount; }
+	// Cycle count the next RunFrame() stops at
+	inline uint64_t GetFrameEndCycle() const { return mCycleCount + (mCyclesPerSecond + mFrameCycleRemainder) / gFrameRate; }
+	inline uint64_t GetFrameCount() const { return mFrameCount; }
+	// Decoded instruction groups executed, lanes * cycles / groups is how many lanes shared each decode on average
+	inline uint64_t GetGroupCount() const { return mGroupCount; }
+
+private:
+	using Memory = std::array<uint8_t, gMemorySize>;
+	using Lanes8 = std::array<uint8_t, gMaxLockstepLanes>;
+	using Lanes16 = std::array<uint16_t, gMaxLockstepLanes>;
+
+	uint16_t FetchInstruction(size_t lane, uint16_t address) const;
+	template<QuirkProfile Profile>
+	void RunCycles(uint32_t cycles);
+	// Runs one instruction on every lane in the mask, their program counters all point at it
+	template<QuirkProfile Profile>
+	void Execute(const Operands& operands, uint32_t lanes);
+	template<QuirkProfile Profile>
+	void ExecutePerLane(const Operands& operands, uint32_t lanes);
+	void WriteMemory(size_t lane, uint16_t address, uint8_t value);
+	// Steps each lane in the mask over the instruction at its PC, XO-CHIP's F000 NNNN takes 4 bytes
+	template<QuirkProfile Profile>
+	void Skip(uint32_t lanes);
+	// Planes DXYN, 00E0 and the scrolls affect on this lane
+	template<QuirkProfile Profile>
+	uint8_t GetSelectedPlanes(size_t lane) const;
+
+	size_t mLaneCount = 0;
+	uint32_t mAllLanes = 0;
+
+	// Register-major, so each register of all 32 lanes is a single 256-bit load
+	alignas(32) std::array<Lanes8, 16> mVariableRegisters = {};
+	alignas(32) Lanes16 mIndexRegisters = {};
+	alignas(32) Lanes16 mProgramCounters = {};
+	alignas(32) Lanes8 mDelayTimers = {};
+	alignas(32) Lanes8 mSoundTimers = {};
+	// One bit per key
+	std::array<uint16_t, gMaxLockstepLanes> mKeypads = {};
+	Lanes8 mHighResolution = {};
+	Lanes8 mPlaneMasks = {};
+
+	std::vector<Memory> mMemory;
+	std::vector<DisplayPlanes> mDisplays;
+	std::vector<std::vector<uint16_t>> mAddressStacks;
+	std::vector<std::array<uint8_t, 16>> mFlagRegisters;
+	uint64_t mRandomSeed = 0;
+	std::vector<Random> mRandom;
+
+	// Lanes that have written into each 64 byte block of memory. Only those can hold different code at a shared PC,
+	// so grouping only has to compare their instructions.
+	std::array<uint32_t, gMemorySize / 64> mWrittenLanes = {};
+
+	QuirkProfile mQuirkProfile = QuirkProfile::CosmacVip;
+	uint16_t mCyclesPerSecond = 700;
+	uint32_t mFrameCycleRemainder = 0;
+	uint64_t mCycleCount = 0;
+	uint64_t mFrameCount = 0;
+	uint64_t mGroupCount = 0;
+};
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Read-only memory mapping of a whole file, so large traces and state files can be read without copying them in.
+// Data() is nullptr if the file couldn't be opened or is empty.
+class MappedFile {
+public:
+	MappedFile() = default;
+	explicit MappedFile(const char* path);
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+
+	inline const uint8_t* Data() const { return mData; }
+	inline size_t Size() const { return mSize; }
+	inline bool IsOpen() const { return mData != nullptr; }
+
+private:
+	void Close();
+
+	const uint8_t* mData = nullptr;
+	size_t mSize = 0;
+#ifdef _WIN32
+	void* mFile = nullptr;
+	void* mMapping = nullptr;
+#endif
+};
@@ -0,0 +1,156 @@
+#include "Movie.h"
+#include "Hash.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+uint64_t HashFile(const char* path)
+{
+	const MappedFile file(path);
+	return file.IsOpen() ? HashBytes(file.Data(), file.Size()) : 0;
+}
+
+MovieRecorder::MovieRecorder(CHIP& chip, const char* romPath, bool recordHashes)
+	: mChip(chip)
+	, mRecordHashes(recordHashes)
+	, mHash(gHashSeed)
+{
+	mHeader.cyclesPerSecond = chip.GetCyclesPerSecond();
+	mHeader.romHash = HashFile(romPath);
+	mHeader.randomSeed = chip.GetRandomSeed();
+	mHeader.quirkProfile = static_cast<uint8_t>(chip.GetQuirkProfile());
+}
+
+void MovieRecorder::BeginFrame()
+{
+	const bool* keypad = mChip.GetKeypad();
+	for (uint8_t key = 0; key < mKeypad.size(); ++key)
+	{
+		if (keypad[key] != mKeypad[key])
+		{
+			MovieEvent event;
+			event.cycle = mChip.GetCycleCount();
+			event.key = key;
+			event.pressed = keypad[key];
+			mEvents.push_back(event);
+			mKeypad[key] = keypad[key];
+		}
+	}
+}
+
+uint64_t MovieRecorder::QueueKeyEvent(uint64_t cycle, uint8_t key, bool pressed)
+{
+	MovieEvent event;
+	event.cycle = mChip.QueueKeyEvent(cycle, key, pressed);
+	event.key = key & 0xF;
+	event.pressed = pressed;
+	mEvents.push_back(event);
+
+	// The core applies it during the frame, so the next BeginFrame() mustn't see it as a change of its own
+	mKeypad[event.key] = pressed;
+	return event.cycle;
+}
+
+void MovieRecorder::EndFrame()
+{
+	++mHeader.frameCount;
+	if (mRecordHashes)
+	{
+		mHash = mChip.GetFrameHash(mHash);
+		mHashes.push_back(mHash);
+	}
+}
+
+bool MovieRecorder::Save(const char* path) const
+{
+	FILE* file = std::fopen(path, "wb");
+	if (file == nullptr)
+	{
+		return false;
+	}
+
+	MovieHeader header = mHeader;
+	header.eventCount = static_cast<uint32_t>(mEvents.size());
+	header.hashCount = static_cast<uint32_t>(mHashes.size());
+
+	bool written = std::fwrite(&header, sizeof(header), 1, file) == 1;
+	written &= std::fwrite(mEvents.data(), sizeof(MovieEvent), mEvents.size(), file) == mEvents.size();
+	written &= std::fwrite(mHashes.data(), sizeof(uint64_t), mHashes.size(), file) == mHashes.size();
+	return std::fclose(file) == 0 && written;
+}
+
+MoviePlayer::MoviePlayer(const char* path)
+	: mFile(path)
+{
+	if (mFile.Size() < sizeof(MovieHeader))
+	{
+		return;
+	}
+
+	std::memcpy(&mHeader, mFile.Data(), sizeof(mHeader));
+
+	const MovieHeader expected;
+	const uint64_t size = sizeof(MovieHeader) + static_cast<uint64_t>(mHeader.eventCount) * sizeof(MovieEvent) + static_cast<uint64_t>(mHeader.hashCount) * sizeof(uint64_t);
+	if (std::memcmp(mHeader.magic, expected.magic, sizeof(mHeader.magic)) != 0 || mHeader.version != expected.version
+		|| mHeader.cyclesPerSecond == 0 || mHeader.quirkProfile >= static_cast<uint8_t>(QuirkProfile::Count) || (mHeader.hashCount != 0 && mHeader.hashCount != mHeader.frameCount) || mFile.Size() < size)
+	{
+		return;
+	}
+
+	// Every section is a multiple of 8 bytes, so both arrays are aligned in the mapping
+	mEvents = reinterpret_cast<const MovieEvent*>(mFile.Data() + sizeof(MovieHeader));
+	mHashes = reinterpret_cast<const uint64_t*>(mEvents + mHeader.eventCount);
+	mIsValid = true;
+}
+
+bool MoviePlayer::Start(CHIP& chip, const char* romPath)
+{
+	// Mapped once for both the hash check and the load
+	const MappedFile rom(romPath);
+	if (!mIsValid || !rom.IsOpen() || HashBytes(rom.Data(), rom.Size()) != mHeader.romHash)
+	{
+		return false;
+	}
+
+	chip.SetRandomSeed(mHeader.randomSeed);
+	if (!chip.LoadROM(rom.Data(), rom.Size(), mHeader.cyclesPerSecond, static_cast<QuirkProfile>(mHeader.quirkProfile)))
+	{
+		return false;
+	}
+	std::fill_n(chip.GetKeypad(), 16, false);
+
+	mFrame = 0;
+	mNextEvent = 0;
+	mHash = gHashSeed;
+	mFirstDivergentFrame = UINT64_MAX;
+	return true;
+}
+
+bool MoviePlayer::RunFrame(CHIP& chip)
+{
+	if (mFrame >= mHeader.frameCount)
+	{
+		return false;
+	}
+
+	// Every event due by the end of this frame goes in the core's queue, which applies each at its recorded cycle
+	for (; mNextEvent < mHeader.eventCount && mEvents[mNextEvent].cycle <= chip.GetFrameEndCycle(); ++mNextEvent)
+	{
+		chip.QueueKeyEvent(mEvents[mNextEvent].cycle, mEvents[mNextEvent].key, mEvents[mNextEvent].pressed != 0);
+	}
+
+	chip.RunFrame();
+
+	if (HasHashes())
+	{
+		mHash = chip.GetFrameHash(mHash);
+		if (mHash != mHashes[mFrame] && mFirstDivergentFrame == UINT64_MAX)
+		{
+			mFirstDivergentFrame = mFrame;
+		}
+	}
+
+	++mFrame;
+	return mFrame < mHeader.frameCount;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "Chip8.h"
+#include "MappedFile.h"
+
+// Movie files are this header, eventCount MovieEvents, then hashCount frame hashes. A movie always starts from
+// LoadROM() with the recorded seed, speed and quirk profile, so together with the events it reproduces the run exactly.
+struct MovieHeader
+{
+	char magic[4] = { 'C', '8', 'M', 'V' };
+	uint16_t version = 4;		// 4: CXNN draws from xoshiro256**
+	uint16_t cyclesPerSecond = 0;
+	uint64_t romHash = 0;		// HashBytes() of the ROM file, replays refuse a different ROM
+	uint64_t randomSeed = 0;
+	uint64_t frameCount = 0;
+	uint32_t eventCount = 0;
+	uint32_t hashCount = 0;		// Either frameCount or 0 when recorded without hashes
+	uint8_t quirkProfile = 0;	// QuirkProfile the ROM was loaded with
+	uint8_t reserved[7] = {};
+};
+static_assert(sizeof(MovieHeader) == 48, "Movie header layout is part of the file format");
+
+// A key going down or up, applied right before the instruction at cycle runs
+struct MovieEvent
+{
+	uint64_t cycle = 0;
+	uint8_t key = 0;
+	uint8_t pressed = 0;
+	uint8_t reserved[6] = {};
+};
+static_assert(sizeof(MovieEvent) == 16, "Movie event layout is part of the file format");
+
+// HashBytes() of a whole file, 0 if it can't be read
+uint64_t HashFile(const char* path);
+
+// Records a run's keypad changes, and optionally a rolling hash after every frame.
+// Key events queued through the recorder are recorded at the cycle the core applies them. Anything written straight to
+// the keypad between frames is caught by diffing it before each frame, at the exact cycle the core first sees it.
+class MovieRecorder {
+public:
+	// chip should have just loaded romPath, the movie starts from there
+	MovieRecorder(CHIP& chip, const char* romPath, bool recordHashes);
+
+	// Call right before each CHIP::RunFrame()
+	void BeginFrame();
+	// Call right after each CHIP::RunFrame()
+	void EndFrame();
+	// CHIP::QueueKeyEvent() that also goes into the movie. Call after BeginFrame(), for the frame about to run.
+	uint64_t QueueKeyEvent(uint64_t cycle, uint8_t key, bool pressed);
+
+	bool Save(const char* path) const;
+
+	inline uint64_t GetFrameCount() const { return mHeader.frameCount; }
+
+private:
+	CHIP& mChip;
+	MovieHeader mHeader;
+	bool mRecordHashes = false;
+	std::array<bool, 16> mKeypad = {};
+	std::vector<MovieEvent> mEvents;
+	std::vector<uint64_t> mHashes;
+	uint64_t mHash = 0;
+};
+
+// Plays a movie back as fast as the host allows, checking every frame against the recorded hashes
+class MoviePlayer {
+public:
+	explicit MoviePlayer(const char* path);
+
+	// False if the file is missing, truncated or from another format version
+	inline bool IsValid() const { return mIsValid; }
+
+	// Seeds and loads the ROM the way the recording started, with the same quirk profile. False if it's not the ROM the movie was recorded with.
+	bool Start(CHIP& chip, const char* romPath);
+	// Applies the frame's input and runs it. Returns false once every recorded frame has been played.
+	bool RunFrame(CHIP& chip);
+
+	inline uint64_t GetFrameCount() const { return mHeader.frameCount; }
+	inline uint64_t GetFramesPlayed() const { return mFrame; }
+	inline bool HasHashes() const { return mHeader.hashCount > 0; }
+	// First frame whose hash didn't match the recording, or UINT64_MAX if none so far
+	inline uint64_t GetFirstDivergentFrame() const { return mFirstDivergentFrame; }
+
+private:
+	MappedFile mFile;
+	MovieHeader mHeader;
+	bool mIsValid = false;
+	const MovieEvent* mEvents = nullptr;
+	const uint64_t* mHashes = nullptr;
+
+	uint64_t mFrame = 0;
+	uint32_t mNextEvent = 0;
+	uint64_t mHash = 0;
+	uint64_t mFirstDivergentFrame = UINT64_MAX;
+};
@@ -0,0 +1,251 @@
+#include "Phosphor.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(_M_X64) || defined(__x86_64__)
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+	// What's left of a channel after a frame, in 256ths, for it to drop under 1/16 in persistence frames
+	uint32_t GetDecay(uint32_t persistence)
+	{
+		if (persistence == 0)
+		{
+			return 0;
+		}
+		return std::min<uint32_t>(255, static_cast<uint32_t>(std::lround(256.0 * std::pow(1.0 / 16.0, 1.0 / persistence))));
+	}
+
+	// Bits of the rows a display of this height has
+	inline uint64_t VisibleRows(int height)
+	{
+		return height >= 64 ? ~0ull : (1ull << height) - 1;
+	}
+
+	// Maps a row of ExpandFramebuffer() pixels through the palette into glow. Lit pixels take their colour at once,
+	// pixels that are off move from their old colour towards the off colour, every channel keeping decay / 256 of its
+	// distance from it. That works whichever way the palette runs, dark ink on a light background fades out too.
+	// Returns whether any pixel hasn't reached its colour yet, i.e. is still fading. count is a multiple of 64.
+#if defined(__AVX2__)
+	bool FadeRow(const uint32_t* expanded, uint32_t* glow, int count, const Palette& palette, uint32_t decay)
+	{
+		const __m256i on = _mm256_set1_epi32(static_cast<int>(gPixelOn));
+		const __m256i secondPlane = _mm256_set1_epi32(static_cast<int>(gPixelSecondPlane));
+		const __m256i bothPlanes = _mm256_set1_epi32(static_cast<int>(gPixelBothPlanes));
+		const __m256i factor = _mm256_set1_epi16(static_cast<short>(decay));
+		const __m256i zero = _mm256_setzero_si256();
+		__m256i colours[4];
+		for (size_t i = 0; i < palette.size(); ++i)
+		{
+			colours[i] = _mm256_set1_epi32(static_cast<int>(palette[i]));
+		}
+
+		__m256i settled = _mm256_set1_epi8(-1);
+		for (int x = 0; x < count; x += 8)
+		{
+			// Each pixel is exactly one of the four expanded colours, so three compares pick its palette entry
+			const __m256i pixel = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(expanded + x));
+			const __m256i isOn = _mm256_cmpeq_epi32(pixel, on);
+			const __m256i isSecond = _mm256_cmpeq_epi32(pixel, secondPlane);
+			const __m256i isBoth = _mm256_cmpeq_epi32(pixel, bothPlanes);
+			const __m256i isLit = _mm256_or_si256(isOn, _mm256_or_si256(isSecond, isBoth));
+			const __m256i colour = _mm256_or_si256(_mm256_or_si256(_mm256_andnot_si256(isLit, colours[0]), _mm256_and_si256(isOn, colours[1])),
+				_mm256_or_si256(_mm256_and_si256(isSecond, colours[2]), _mm256_and_si256(isBoth, colours[3])));
+
+			// Unsigned distance from the colour per channel, only one of the two saturating subtractions is non-zero.
+			// No 8-bit multiplies, so it's widened to 16 bits and narrowed back. Both work within 128-bit lanes, so
+			// the channels come back out where they went in.
+			const __m256i old = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(glow + x));
+			const __m256i above = _mm256_subs_epu8(old, colour);
+			const __m256i below = _mm256_subs_epu8(colour, old);
+			const __m256i distance = _mm256_or_si256(above, below);
+			const __m256i low = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_unpacklo_epi8(distance, zero), factor), 8);
+			const __m256i high = _mm256_srli_epi16(_mm256_mullo_epi16(_mm256_unpackhi_epi8(distance, zero), factor), 8);
+			const __m256i step = _mm256_packus_epi16(low, high);
+			const __m256i isAbove = _mm256_cmpeq_epi8(below, zero);
+			const __m256i faded = _mm256_blendv_epi8(_mm256_subs_epu8(colour, step), _mm256_adds_epu8(colour, step), isAbove);
+			const __m256i result = _mm256_blendv_epi8(faded, colour, isLit);
+
+			_mm256_storeu_si256(reinterpret_cast<__m256i*>(glow + x), result);
+			settled = _mm256_and_si256(settled, _mm256_cmpeq_epi8(result, colour));
+		}
+		return _mm256_movemask_epi8(settled) != -1;
+	}
+#elif defined(_M_X64) || defined(__x86_64__)
+	bool FadeRow(const uint32_t* expanded, uint32_t* glow, int count, const Palette& palette, uint32_t decay)
+	{
+		// Same as the AVX2 path, four pixels at a time and with masks in place of blends
+		const __m128i on = _mm_set1_epi32(static_cast<int>(gPixelOn));
+		const __m128i secondPlane = _mm_set1_epi32(static_cast<int>(gPixelSecondPlane));
+		const __m128i bothPlanes = _mm_set1_epi32(static_cast<int>(gPixelBothPlanes));
+		const __m128i factor = _mm_set1_epi16(static_cast<short>(decay));
+		const __m128i zero = _mm_setzero_si128();
+		__m128i colours[4];
+		for (size_t i = 0; i < palette.size(); ++i)
+		{
+			colours[i] = _mm_set1_epi32(static_cast<int>(palette[i]));
+		}
+
+		__m128i settled = _mm_set1_epi8(-1);
+		for (int x = 0; x < count; x += 4)
+		{
+			const __m128i pixel = _mm_loadu_si128(reinterpret_cast<const __m128i*>(expanded + x));
+			const __m128i isOn = _mm_cmpeq_epi32(pixel, on);
+			const __m128i isSecond = _mm_cmpeq_epi32(pixel, secondPlane);
+			const __m128i isBoth = _mm_cmpeq_epi32(pixel, bothPlanes);
+			const __m128i isLit = _mm_or_si128(isOn, _mm_or_si128(isSecond, isBoth));
+			const __m128i colour = _mm_or_si128(_mm_or_si128(_mm_andnot_si128(isLit, colours[0]), _mm_and_si128(isOn, colours[1])),
+				_mm_or_si128(_mm_and_si128(isSecond, colours[2]), _mm_and_si128(isBoth, colours[3])));
+
+			const __m128i old = _mm_loadu_si128(reinterpret_cast<const __m128i*>(glow + x));
+			const __m128i above = _mm_subs_epu8(old, colour);
+			const __m128i below = _mm_subs_epu8(colour, old);
+			const __m128i distance = _mm_or_si128(above, below);
+			const __m128i low = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(distance, zero), factor), 8);
+			const __m128i high = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(distance, zero), factor), 8);
+			const __m128i step = _mm_packus_epi16(low, high);
+			const __m128i isAbove = _mm_cmpeq_epi8(below, zero);
+			const __m128i faded = _mm_or_si128(_mm_and_si128(isAbove, _mm_adds_epu8(colour, step)), _mm_andnot_si128(isAbove, _mm_subs_epu8(colour, step)));
+			const __m128i result = _mm_or_si128(_mm_and_si128(isLit, colour), _mm_andnot_si128(isLit, faded));
+
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(glow + x), result);
+			settled = _mm_and_si128(settled, _mm_cmpeq_epi8(result, colour));
+		}
+		return _mm_movemask_epi8(settled) != 0xFFFF;
+	}
+#else
+	bool FadeRow(const uint32_t* expanded, uint32_t* glow, int count, const Palette& palette, uint32_t decay)
+	{
+		bool fading = false;
+		for (int x = 0; x < count; ++x)
+		{
+			const uint32_t pixel = expanded[x];
+			const bool isLit = pixel == gPixelOn || pixel == gPixelSecondPlane || pixel == gPixelBothPlanes;
+			const uint32_t colour = palette[pixel == gPixelOn ? 1 : pixel == gPixelSecondPlane ? 2 : pixel == gPixelBothPlanes ? 3 : 0];
+
+			uint32_t faded = colour;
+			if (!isLit)
+			{
+				faded = 0;
+				for (int shift = 0; shift < 32; shift += 8)
+				{
+					const uint32_t old = glow[x] >> shift & 0xFF;
+					const uint32_t target = colour >> shift & 0xFF;
+					const uint32_t step = ((old > target ? old - target : target - old) * decay) >> 8;
+					faded |= (old > target ? target + step : target - step) << shift;
+				}
+			}
+
+			glow[x] = faded;
+			fading |= faded != colour;
+		}
+		return fading;
+	}
+#endif
+
+	// Writes scale copies of each pixel, then copies the row scale - 1 times below itself
+	void ScaleRow(const uint32_t* row, int width, uint32_t scale, uint32_t* pixels)
+	{
+		uint32_t* out = pixels;
+		for (int x = 0; x < width; ++x)
+		{
+			std::fill_n(out, scale, row[x]);
+			out += scale;
+		}
+
+		const size_t outputWidth = static_cast<size_t>(width) * scale;
+		for (uint32_t copy = 1; copy < scale; ++copy)
+		{
+			std::memcpy(pixels + copy * outputWidth, pixels, outputWidth * sizeof(uint32_t));
+		}
+	}
+}
+
+bool ParsePalette(const char* text, Palette& palette)
+{
+	Palette parsed;
+	for (size_t i = 0; i < parsed.size(); ++i)
+	{
+		char* end = nullptr;
+		const unsigned long colour = std::strtoul(text, &end, 16);
+		const char expected = i + 1 < parsed.size() ? ',' : '\0';
+		if (end - text != 6 || *end != expected)
+		{
+			return false;
+		}
+
+		parsed[i] = static_cast<uint32_t>(colour << 8) | 0xFF;
+		text = end + 1;
+	}
+
+	palette = parsed;
+	return true;
+}
+
+void PhosphorFilter::SetSettings(const PhosphorSettings& settings)
+{
+	mSettings = settings;
+	mSettings.scale = std::clamp<uint32_t>(settings.scale, 1, gMaxPhosphorScale);
+	mDecay = GetDecay(settings.persistence);
+
+	// The next Process() sizes everything again and redoes every row
+	mWidth = 0;
+	mHeight = 0;
+}
+
+void PhosphorFilter::Resize(int width, int height)
+{
+	mWidth = width;
+	mHeight = height;
+	mFadingRows = 0;
+	mGlow.assign(static_cast<size_t>(width) * height, mSettings.palette[0]);
+	if (mSettings.scale > 1)
+	{
+		mPixels.assign(static_cast<size_t>(GetOutputWidth()) * GetOutputHeight(), mSettings.palette[0]);
+	}
+	else
+	{
+		mPixels.clear();
+	}
+}
+
+uint64_t PhosphorFilter::Process(const uint64_t* firstPlane, const uint64_t* secondPlane, int width, int height, uint64_t dirtyRows)
+{
+	if (width != mWidth || height != mHeight)
+	{
+		// A new resolution starts out blank, nothing fades over from the old one
+		Resize(width, height);
+		dirtyRows = gAllDisplayRows;
+	}
+
+	const uint64_t rows = (dirtyRows | mFadingRows) & VisibleRows(height);
+	const size_t outputWidth = static_cast<size_t>(GetOutputWidth());
+	std::array<uint32_t, gHiResDisplayWidth> expanded;
+	for (int y = 0; y < height; ++y)
+	{
+		if ((rows >> y & 1) == 0)
+		{
+			continue;
+		}
+
+		const size_t offset = y * gDisplayRowWords;
+		ExpandFramebuffer(firstPlane + offset, secondPlane + offset, width, 1, expanded.data());
+
+		uint32_t* glow = mGlow.data() + static_cast<size_t>(y) * width;
+		const uint64_t rowBit = 1ull << y;
+		mFadingRows = FadeRow(expanded.data(), glow, width, mSettings.palette, mDecay) ? mFadingRows | rowBit : mFadingRows & ~rowBit;
+
+		if (mSettings.scale > 1)
+		{
+			ScaleRow(glow, width, mSettings.scale, mPixels.data() + y * mSettings.scale * outputWidth);
+		}
+	}
+	return rows;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "Framebuffer.h"
+
+// Colours of pixels lit in neither plane, only the first, only the second and both, in the RGBA8888 layout
+using Palette = std::array<uint32_t, 4>;
+constexpr Palette gDefaultPalette = { gPixelOff, gPixelOn, gPixelSecondPlane, gPixelBothPlanes };
+// Largest whole-number scale PhosphorFilter upscales by
+constexpr uint32_t gMaxPhosphorScale = 16;
+
+// Reads four comma-separated RRGGBB colours, in Palette order, as opaque pixels. False, leaving palette alone, if
+// text isn't exactly that.
+bool ParsePalette(const char* text, Palette& palette);
+
+struct PhosphorSettings
+{
+	uint32_t persistence = 4;	// Frames a pixel takes to fade within 1/16 of the off colour after going out, 0 for none
+	uint32_t scale = 1;			// Each display pixel becomes a scale x scale block of output pixels
+	Palette palette = gDefaultPalette;
+};
+
+// Turns the display planes into the pixels that get presented, entirely on the CPU.
+// Lit pixels take their palette colour, and pixels that go out fade over the next few frames rather than vanishing, so
+// sprites erased and redrawn with XOR every frame stay on screen instead of flickering. Fading moves each channel
+// towards the off colour from whichever side it's on, so any palette works, with SSE2 or AVX2 kernels when the core is
+// built for them.
+class PhosphorFilter {
+public:
+	// Starts over from a blank display
+	void SetSettings(const PhosphorSettings& settings);
+	inline const PhosphorSettings& GetSettings() const { return mSettings; }
+
+	// Call once per presented frame with the rows changed since the last call, the planes laid out as for
+	// ExpandFramebuffer(). Returns the display rows whose output was redone, which includes rows still fading out.
+	uint64_t Process(const uint64_t* firstPlane, const uint64_t* secondPlane, int width, int height, uint64_t dirtyRows);
+
+	// GetOutputWidth() * GetOutputHeight() pixels, row by row with no padding. Display row y is output rows y * scale
+	// up to (y + 1) * scale.
+	inline const uint32_t* GetPixels() const { return mSettings.scale == 1 ? mGlow.data() : mPixels.data(); }
+	inline int GetOutputWidth() const { return mWidth * static_cast<int>(mSettings.scale); }
+	inline int GetOutputHeight() const { return mHeight * static_cast<int>(mSettings.scale); }
+
+	// Rows the next Process() redoes even if nothing on the display changes
+	inline uint64_t GetFadingRows() const { return mFadingRows; }
+
+private:
+	void Resize(int width, int height);
+
+	PhosphorSettings mSettings;
+	uint32_t mDecay = 0;		// What's left of each channel after a frame, in 256ths
+	int mWidth = 0;
+	int mHeight = 0;
+	uint64_t mFadingRows = 0;
+
+	std::vector<uint32_t> mGlow;	// Unscaled output, what the next frame fades from
+	std::vector<uint32_t> mPixels;	// Upscaled output, unused at a scale of 1
+};
@@ -0,0 +1,178 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace {
+
+	// Indexed by Profiler::GetOpcodeIndex()
+	const char* const gOpcodeNames[Profiler::gOpcodeCount] = {
+		"00E0", "00EE", "1NNN", "2NNN", "3XNN", "4XNN", "5XY0", "6XNN", "7XNN",
+		"8XY0", "8XY1", "8XY2", "8XY3", "8XY4", "8XY5", "8XY6", "8XY7", "8XYE",
+		"9XY0", "ANNN", "BNNN", "CXNN", "DXYN", "EX9E", "EXA1",
+		"FX07", "FX0A", "FX15", "FX18", "FX1E", "FX29", "FX33", "FX55", "FX65",
+		"00CN", "00DN", "00FB", "00FC", "00FD", "00FE", "00FF", "5XY2", "5XY3",
+		"F000", "FN01", "F002", "FX30", "FX3A", "FX75", "FX85",
+		"Invalid",
+	};
+
+	constexpr size_t gInvalidOpcode = Profiler::gOpcodeCount - 1;
+}
+
+const char* Profiler::GetOpcodeName(size_t opcode)
+{
+	return gOpcodeNames[opcode];
+}
+
+size_t Profiler::GetOpcodeIndex(uint16_t instruction)
+{
+	// Same families as CHIP::LookupHandler(), numbered in the order of gOpcodeNames. The SUPER-CHIP and XO-CHIP ones are
+	// counted whatever the profile, the others only ever execute them as invalid instructions.
+	const uint8_t family = instruction >> 12;
+	switch (family)
+	{
+	case 0x0:
+		if (instruction == 0x00E0) return 0;
+		if (instruction == 0x00EE) return 1;
+		if ((instruction & 0xFFF0) == 0x00C0) return 34;
+		if ((instruction & 0xFFF0) == 0x00D0) return 35;
+		if (instruction >= 0x00FB && instruction <= 0x00FF) return 36 + (instruction - 0x00FB);
+		break;
+	case 0x5:
+		if ((instruction & 0xF) == 0x2) return 41;
+		if ((instruction & 0xF) == 0x3) return 42;
+		return family + 1;
+	case 0x1: case 0x2: case 0x3: case 0x4: case 0x6: case 0x7:
+		return family + 1;
+	case 0x8:
+		if ((instruction & 0xF) <= 0x7) return 9 + (instruction & 0xF);
+		if ((instruction & 0xF) == 0xE) return 17;
+		break;
+	case 0x9: case 0xA: case 0xB: case 0xC: case 0xD:
+		return family + 9;
+	case 0xE:
+		if ((instruction & 0xFF) == 0x9E) return 23;
+		if ((instruction & 0xFF) == 0xA1) return 24;
+		break;
+	case 0xF:
+		switch (instruction & 0xFF)
+		{
+		case 0x07: return 25;
+		case 0x0A: return 26;
+		case 0x15: return 27;
+		case 0x18: return 28;
+		case 0x1E: return 29;
+		case 0x29: return 30;
+		case 0x33: return 31;
+		case 0x55: return 32;
+		case 0x65: return 33;
+		case 0x00: if (instruction == 0xF000) return 43; break;
+		case 0x01: return 44;
+		case 0x02: if (instruction == 0xF002) return 45; break;
+		case 0x30: return 46;
+		case 0x3A: return 47;
+		case 0x75: return 48;
+		case 0x85: return 49;
+		}
+		break;
+	}
+	return gInvalidOpcode;
+}
+
+void Profiler::Count(uint16_t pc, uint16_t instruction, uint16_t nextPc)
+{
+	++mInstructionCount;
+	++mOpcodeCounts[GetOpcodeIndex(instruction)];
+	++mAddressCounts[pc & 0xFFF];
+
+	// Only jumps close loops, calls and returns going backwards are just the call graph
+	const uint8_t family = instruction >> 12;
+	if ((family == 0x1 || family == 0xB) && nextPc <= pc)
+	{
+		++mBackwardJumps[(static_cast<uint32_t>(pc) << 16) | nextPc];
+	}
+}
+
+void Profiler::Reset()
+{
+	mInstructionCount = 0;
+	mOpcodeCounts.fill(0);
+	mAddressCounts.fill(0);
+	mDrawNanoseconds = 0;
+	mBackwardJumps.clear();
+}
+
+std::vector<Profiler::Loop> Profiler::GetHotLoops(size_t maxCount) const
+{
+	std::vector<Loop> loops;
+	loops.reserve(mBackwardJumps.size());
+	for (const auto& [key, iterations] : mBackwardJumps)
+	{
+		Loop loop;
+		loop.end = static_cast<uint16_t>(key >> 16);
+		loop.start = static_cast<uint16_t>(key);
+		loop.iterations = iterations;
+		loops.push_back(loop);
+	}
+
+	const auto hotter = [](const Loop& a, const Loop& b) { return a.iterations != b.iterations ? a.iterations > b.iterations : a.end < b.end; };
+	const size_t count = std::min(maxCount, loops.size());
+	std::partial_sort(loops.begin(), loops.begin() + count, loops.end(), hotter);
+	loops.resize(count);
+
+	for (Loop& loop : loops)
+	{
+		for (uint32_t address = loop.start & 0xFFF; address <= (loop.end & 0xFFFu); ++address)
+		{
+			loop.instructions += mAddressCounts[address];
+		}
+	}
+	return loops;
+}
+
+bool Profiler::WriteJson(const char* path, size_t maxLoops /* = 16 */) const
+{
+	FILE* file = std::fopen(path, "w");
+	if (file == nullptr)
+	{
+		return false;
+	}
+
+	std::fprintf(file, "{\n  \"instructions\": %llu,\n", static_cast<unsigned long long>(mInstructionCount));
+
+	std::fprintf(file, "  \"opcodes\": {");
+	for (size_t opcode = 0; opcode < gOpcodeCount; ++opcode)
+	{
+		std::fprintf(file, "%s\"%s\": %llu", opcode > 0 ? ", " : "", gOpcodeNames[opcode], static_cast<unsigned long long>(mOpcodeCounts[opcode]));
+	}
+	std::fprintf(file, "},\n");
+
+	const uint64_t draws = GetDrawCount();
+	std::fprintf(file, "  \"draw\": {\"count\": %llu, \"nanoseconds\": %llu, \"ns_per_draw\": %.1f},\n",
+		static_cast<unsigned long long>(draws), static_cast<unsigned long long>(mDrawNanoseconds), draws > 0 ? static_cast<double>(mDrawNanoseconds) / draws : 0.0);
+
+	// Only addresses that ran at all, a ROM rarely touches more than a few hundred
+	std::fprintf(file, "  \"addresses\": [");
+	bool first = true;
+	for (size_t address = 0; address < mAddressCounts.size(); ++address)
+	{
+		if (mAddressCounts[address] > 0)
+		{
+			std::fprintf(file, "%s{\"pc\": %zu, \"count\": %llu}", first ? "" : ", ", address, static_cast<unsigned long long>(mAddressCounts[address]));
+			first = false;
+		}
+	}
+	std::fprintf(file, "],\n");
+
+	std::fprintf(file, "  \"loops\": [");
+	first = true;
+	for (const Loop& loop : GetHotLoops(maxLoops))
+	{
+		std::fprintf(file, "%s\n    {\"start\": %u, \"end\": %u, \"iterations\": %llu, \"instructions\": %llu}", first ? "" : ",",
+			loop.start, loop.end, static_cast<unsigned long long>(loop.iterations), static_cast<unsigned long long>(loop.instructions));
+		first = false;
+	}
+	std::fprintf(file, "%s]\n}\n", first ? "" : "\n  ");
+
+	return std::fclose(file) == 0;
+}
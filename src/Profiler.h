@@ -0,0 +1,58 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Set through the CHIP8_ENABLE_PROFILER CMake option. When it's 0 the core has no profiling hooks at all, the
+// Profiler itself is still available for tools.
+#ifndef CHIP8_PROFILE
+#define CHIP8_PROFILE 0
+#endif
+
+// What a ROM spends its cycles on: executions per instruction family and per address, the time DXYN takes, and the
+// backward jumps that close its loops. Filled by CHIP::RunCycles() while set with CHIP::SetProfiler().
+class Profiler {
+public:
+	// A backward jump and how often it was taken, the loop body is start to end inclusive
+	struct Loop
+	{
+		uint16_t start = 0;			// Jump target
+		uint16_t end = 0;			// Address of the jump itself
+		uint64_t iterations = 0;
+		uint64_t instructions = 0;	// Executed within start to end, an upper bound when other code shares the range
+	};
+
+	// Number of instruction families counted separately, the last one collects anything invalid
+	static constexpr size_t gOpcodeCount = 51;
+	static const char* GetOpcodeName(size_t opcode);
+	static size_t GetOpcodeIndex(uint16_t instruction);
+
+	// Called once per executed instruction, with the program counter it was fetched from and the one it left behind
+	void Count(uint16_t pc, uint16_t instruction, uint16_t nextPc);
+	inline void AddDrawTime(uint64_t nanoseconds) { mDrawNanoseconds += nanoseconds; }
+
+	void Reset();
+
+	inline uint64_t GetInstructionCount() const { return mInstructionCount; }
+	inline uint64_t GetOpcodeCount(size_t opcode) const { return mOpcodeCounts[opcode]; }
+	// Executions per address, e.g. for a heatmap. Code above 4 KB, which only XO-CHIP can reach, is folded onto it.
+	inline const std::array<uint64_t, 4096>& GetAddressCounts() const { return mAddressCounts; }
+	inline uint64_t GetDrawCount() const { return mOpcodeCounts[GetOpcodeIndex(0xD000)]; }
+	inline uint64_t GetDrawNanoseconds() const { return mDrawNanoseconds; }
+
+	// The most taken backward jumps, most iterations first
+	std::vector<Loop> GetHotLoops(size_t maxCount) const;
+
+	bool WriteJson(const char* path, size_t maxLoops = 16) const;
+
+private:
+	uint64_t mInstructionCount = 0;
+	std::array<uint64_t, gOpcodeCount> mOpcodeCounts = {};
+	std::array<uint64_t, 4096> mAddressCounts = {};
+	uint64_t mDrawNanoseconds = 0;
+	// Keyed by jump address << 16 | target
+	std::unordered_map<uint32_t, uint64_t> mBackwardJumps;
+};
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstdint>
+
+// One step of SplitMix64, used to spread a 64-bit seed over a bigger generator state
+inline uint64_t SplitMix64(uint64_t& state)
+{
+	uint64_t z = (state += 0x9E3779B97F4A7C15);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+	return z ^ (z >> 31);
+}
+
+// Seed for the stream-th of many machines started from one base seed, e.g. the jobs of a batch.
+// It's the stream-th output of SplitMix64 from seed, so working it out doesn't depend on the streams before it.
+inline uint64_t GetStreamSeed(uint64_t seed, uint64_t stream)
+{
+	uint64_t state = seed + stream * 0x9E3779B97F4A7C15;
+	return SplitMix64(state);
+}
+
+// xoshiro256** by Blackman and Vigna: 32 bytes of state and a few shifts, rotates and multiplies per number, so CXNN
+// costs about as much as any other instruction. A seed fully determines the sequence.
+class Random {
+public:
+	using State = std::array<uint64_t, 4>;
+
+	Random() { Seed(0); }
+	explicit Random(uint64_t seed) { Seed(seed); }
+
+	// Every seed, 0 included, gives a usable state: it's filled from SplitMix64 and can't come out all zero
+	inline void Seed(uint64_t seed)
+	{
+		for (uint64_t& word : mState)
+		{
+			word = SplitMix64(seed);
+		}
+	}
+
+	inline uint64_t Next()
+	{
+		const uint64_t result = std::rotl(mState[1] * 5, 7) * 9;
+		const uint64_t t = mState[1] << 17;
+		mState[2] ^= mState[0];
+		mState[3] ^= mState[1];
+		mState[1] ^= mState[2];
+		mState[0] ^= mState[3];
+		mState[2] ^= t;
+		mState[3] = std::rotl(mState[3], 45);
+		return result;
+	}
+
+	// The top bits are the best mixed, CXNN only needs one byte
+	inline uint8_t NextByte() { return static_cast<uint8_t>(Next() >> 56); }
+
+	// Skips 2^128 numbers ahead. Jumping a copy of one generator n times gives the n-th of 2^128 streams that never
+	// overlap, which is how lockstep lanes share a seed.
+	inline void Jump()
+	{
+		static constexpr uint64_t polynomial[] = { 0x180EC6D33CFD0ABA, 0xD5A61266F0C9392C, 0xA9582618E03FC9AA, 0x39ABDC4529B1661C };
+
+		State jumped = {};
+		for (const uint64_t word : polynomial)
+		{
+			for (int bit = 0; bit < 64; ++bit)
+			{
+				if (word & (1ull << bit))
+				{
+					for (size_t i = 0; i < jumped.size(); ++i)
+					{
+						jumped[i] ^= mState[i];
+					}
+				}
+				Next();
+			}
+		}
+		mState = jumped;
+	}
+
+	// For save states. An all-zero state would only ever produce zeros, so it's replaced with Seed(0)'s.
+	inline const State& GetState() const { return mState; }
+	inline void SetState(const State& state)
+	{
+		if (state == State())
+		{
+			Seed(0);
+			return;
+		}
+		mState = state;
+	}
+
+private:
+	State mState;
+};
@@ -0,0 +1,201 @@
+#include "Rewind.h"
+#include "Chip8.h"
+
+#include <bit>
+#include <cassert>
+#include <cstring>
+
+namespace {
+
+	// A stored display row holds the row from every plane, whichever resolution it's in
+	constexpr size_t gRowBytes = gDisplayPlanes * gDisplayRowWords * sizeof(uint64_t);
+}
+
+RewindBuffer::RewindBuffer(size_t maxFrames, size_t arenaSize)
+	// Left uninitialised so the OS only commits the part of the arena history actually reaches
+	: mArena(std::make_unique_for_overwrite<uint8_t[]>(arenaSize))
+	, mArenaSize(arenaSize)
+	, mMaxFrames(maxFrames)
+{
+	assert(arenaSize >= sizeof(FrameHeader) + gMemorySize + gRowBytes * gHiResDisplayHeight && "The arena has to fit at least one keyframe");
+}
+
+void RewindBuffer::Record(CHIP& chip)
+{
+	MemoryPages pages = chip.mWrittenPages;
+	uint64_t rows = chip.mChangedRows;
+	chip.mWrittenPages.reset();
+	chip.mChangedRows = 0;
+
+	bool keyframe = mFrames.empty() || mFramesSinceKeyframe + 1 >= gRewindKeyframeInterval || (pages.all() && rows == gAllDisplayRows);
+	if (keyframe)
+	{
+		pages.set();
+		rows = gAllDisplayRows;
+	}
+
+	size_t size = GetFrameSize(pages, rows);
+	uint8_t* out = Allocate(size);
+	if (!keyframe && mFrames.empty())
+	{
+		// Making room dropped the keyframe this delta builds on, so it has to be one itself
+		keyframe = true;
+		pages.set();
+		rows = gAllDisplayRows;
+		size = GetFrameSize(pages, rows);
+		out = Allocate(size);
+	}
+
+	FrameHeader header;
+	chip.SaveCpuState(header.cpu);
+	header.rows = rows;
+	header.pages = pages;
+	std::memcpy(out, &header, sizeof(header));
+	out += sizeof(header);
+
+	for (size_t page = 0; page < pages.size(); ++page)
+	{
+		if (pages.test(page))
+		{
+			std::memcpy(out, &chip.mMemory[page * gMemoryPageSize], gMemoryPageSize);
+			out += gMemoryPageSize;
+		}
+	}
+	for (uint64_t remaining = rows; remaining != 0; remaining &= remaining - 1)
+	{
+		const size_t row = std::countr_zero(remaining) * gDisplayRowWords;
+		for (const DisplayPlane& plane : chip.mDisplay)
+		{
+			std::memcpy(out, &plane[row], gDisplayRowWords * sizeof(uint64_t));
+			out += gDisplayRowWords * sizeof(uint64_t);
+		}
+	}
+
+	Frame frame;
+	frame.offset = mHead;
+	frame.size = static_cast<uint32_t>(size);
+	frame.keyframe = keyframe;
+	mFrames.push_back(frame);
+	mHead += size;
+	mFramesSinceKeyframe = keyframe ? 0 : mFramesSinceKeyframe + 1;
+
+	while (mFrames.size() > mMaxFrames)
+	{
+		DropOldest();
+	}
+}
+
+bool RewindBuffer::StepBack(CHIP& chip)
+{
+	if (mFrames.size() < 2)
+	{
+		return false;
+	}
+
+	// The newest frame was the last thing written, so its space is free again
+	mHead = mFrames.back().offset;
+	mFrames.pop_back();
+	Restore(chip, mFrames.size() - 1);
+	return true;
+}
+
+void RewindBuffer::Clear()
+{
+	mFrames.clear();
+	mHead = 0;
+	mFramesSinceKeyframe = 0;
+}
+
+size_t RewindBuffer::GetUsedBytes() const
+{
+	size_t used = 0;
+	for (const Frame& frame : mFrames)
+	{
+		used += frame.size;
+	}
+	return used;
+}
+
+size_t RewindBuffer::GetFrameSize(const MemoryPages& pages, uint64_t rows)
+{
+	return sizeof(FrameHeader) + pages.count() * gMemoryPageSize + std::popcount(rows) * gRowBytes;
+}
+
+uint8_t* RewindBuffer::Allocate(size_t size)
+{
+	assert(size <= mArenaSize);
+
+	if (mHead + size > mArenaSize)
+	{
+		// Doesn't fit before the end of the arena, so it starts over at the beginning. Anything still stored past the
+		// head is older than everything before it, and has to go before the frames it's about to overwrite.
+		while (!mFrames.empty() && mFrames.front().offset >= mHead)
+		{
+			DropOldest();
+		}
+		mHead = 0;
+	}
+
+	while (!mFrames.empty() && mFrames.front().offset >= mHead && mFrames.front().offset < mHead + size)
+	{
+		DropOldest();
+	}
+
+	return mArena.get() + mHead;
+}
+
+void RewindBuffer::DropOldest()
+{
+	mFrames.pop_front();
+	while (!mFrames.empty() && !mFrames.front().keyframe)
+	{
+		mFrames.pop_front();
+	}
+}
+
+void RewindBuffer::Restore(CHIP& chip, size_t index)
+{
+	size_t keyframe = index;
+	while (!mFrames[keyframe].keyframe)
+	{
+		--keyframe;
+	}
+	mFramesSinceKeyframe = static_cast<uint32_t>(index - keyframe);
+
+	// Replay the deltas forwards from the keyframe, each one overwrites only what its frame changed
+	FrameHeader header;
+	for (size_t i = keyframe; i <= index; ++i)
+	{
+		const uint8_t* in = mArena.get() + mFrames[i].offset;
+		std::memcpy(&header, in, sizeof(header));
+		in += sizeof(header);
+
+		for (size_t page = 0; page < header.pages.size(); ++page)
+		{
+			if (header.pages.test(page))
+			{
+				std::memcpy(&chip.mMemory[page * gMemoryPageSize], in, gMemoryPageSize);
+				in += gMemoryPageSize;
+			}
+		}
+		for (uint64_t remaining = header.rows; remaining != 0; remaining &= remaining - 1)
+		{
+			const size_t row = std::countr_zero(remaining) * gDisplayRowWords;
+			for (DisplayPlane& plane : chip.mDisplay)
+			{
+				std::memcpy(&plane[row], in, gDisplayRowWords * sizeof(uint64_t));
+				in += gDisplayRowWords * sizeof(uint64_t);
+			}
+		}
+	}
+
+	// The keys are whatever the player is holding right now, not what they held back then
+	const std::array<bool, 16> keypad = chip.mKeypad;
+	chip.LoadCpuState(header.cpu);
+	chip.mKeypad = keypad;
+	chip.OnMachineReplaced();
+
+	// The machine now matches the newest frame exactly, so the next one only has to store what changes from here
+	chip.mWrittenPages.reset();
+	chip.mChangedRows = 0;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+
+#include "SaveState.h"
+
+class CHIP;
+
+// A full copy of the machine is stored at least this often, stepping back replays at most this many deltas
+constexpr uint32_t gRewindKeyframeInterval = gFrameRate;
+// Arena bytes CHIP::EnableRewind() budgets per frame of history: room for a couple of written pages on top of the
+// CPU section, with the 64 KB keyframes amortised over the interval
+constexpr size_t gRewindBytesPerFrame = 2048;
+
+// History of recent frames for stepping the machine backwards, see CHIP::EnableRewind().
+// Each frame stores its CPU section plus only the memory pages and display rows written since the previous frame,
+// every gRewindKeyframeInterval frames it stores everything. Frames live back to back in a fixed-size ring arena and
+// the oldest are dropped to make room, so both the cost per frame and how far back the arena reaches depend on how
+// much the program writes rather than on the size of the machine.
+class RewindBuffer {
+public:
+	RewindBuffer(size_t maxFrames, size_t arenaSize);
+
+	// Stores the frame the machine is at now, called at the end of every frame
+	void Record(CHIP& chip);
+	// Puts the machine back to the frame recorded before the newest one, and forgets the newest.
+	// Returns false, leaving the machine alone, once there's nothing older left.
+	bool StepBack(CHIP& chip);
+	void Clear();
+
+	inline size_t GetFrameCount() const { return mFrames.size(); }
+	inline size_t GetArenaSize() const { return mArenaSize; }
+	size_t GetUsedBytes() const;
+
+private:
+	struct Frame
+	{
+		size_t offset = 0;		// Into mArena
+		uint32_t size = 0;
+		bool keyframe = false;
+	};
+
+	// Start of every frame in the arena, followed by the written pages in ascending order and then the changed rows
+	struct FrameHeader
+	{
+		CpuState cpu;
+		uint64_t rows = 0;		// Display rows stored, one bit each, every plane's copy of the row
+		MemoryPages pages;		// Memory pages stored, one bit each
+	};
+
+	// Bytes a frame storing these pages and rows takes up in the arena
+	static size_t GetFrameSize(const MemoryPages& pages, uint64_t rows);
+	// Makes room for size contiguous bytes at the head, dropping the oldest frames it runs into
+	uint8_t* Allocate(size_t size);
+	// Drops the oldest frame, and any deltas left without the keyframe they build on
+	void DropOldest();
+	void Restore(CHIP& chip, size_t index);
+
+	std::unique_ptr<uint8_t[]> mArena;
+	size_t mArenaSize = 0;
+	size_t mHead = 0;			// Where the next frame goes
+	size_t mMaxFrames = 0;
+
+	std::deque<Frame> mFrames;	// Oldest first, the first one is always a keyframe
+	uint32_t mFramesSinceKeyframe = 0;
+};
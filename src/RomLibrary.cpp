@@ -0,0 +1,222 @@
+#include "RomLibrary.h"
+#include "Hash.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace {
+
+	bool IsRomFile(const std::filesystem::path& path)
+	{
+		const std::filesystem::path extension = path.extension();
+		return extension == ".ch8" || extension == ".sc8" || extension == ".xo8";
+	}
+
+	void StoreSettings(RomIndexEntry& entry, const RomSettings& settings)
+	{
+		entry.cyclesPerSecond = settings.cyclesPerSecond;
+		entry.quirkProfile = static_cast<uint8_t>(settings.quirks);
+		std::memcpy(entry.keymap, settings.keymap.data(), sizeof(entry.keymap));
+	}
+
+	// Written next to the index and renamed over it, so a failed write never loses the old index (or the settings in it)
+	bool WriteIndex(const char* indexPath, const std::vector<RomIndexEntry>& entries, const std::string& strings)
+	{
+		const std::string temporaryPath = std::string(indexPath) + ".tmp";
+		FILE* file = std::fopen(temporaryPath.c_str(), "wb");
+		if (file == nullptr)
+		{
+			return false;
+		}
+
+		RomIndexHeader header;
+		header.entrySize = sizeof(RomIndexEntry);
+		header.entryCount = static_cast<uint32_t>(entries.size());
+		header.stringsSize = static_cast<uint32_t>(strings.size());
+
+		bool written = std::fwrite(&header, sizeof(header), 1, file) == 1;
+		written &= std::fwrite(entries.data(), sizeof(RomIndexEntry), entries.size(), file) == entries.size();
+		written &= std::fwrite(strings.data(), 1, strings.size(), file) == strings.size();
+		if (std::fclose(file) != 0 || !written)
+		{
+			std::remove(temporaryPath.c_str());
+			return false;
+		}
+
+		std::error_code error;
+		std::filesystem::rename(temporaryPath, indexPath, error);
+		return !error;
+	}
+}
+
+bool ParseKeymap(const char* text, std::array<char, 16>& keymap)
+{
+	if (std::strlen(text) != keymap.size())
+	{
+		return false;
+	}
+
+	std::array<char, 16> parsed;
+	for (size_t key = 0; key < parsed.size(); ++key)
+	{
+		const unsigned char character = static_cast<unsigned char>(text[key]);
+		if (character < ' ' || character > '~')
+		{
+			return false;
+		}
+		parsed[key] = static_cast<char>(std::tolower(character));
+		if (std::find(parsed.begin(), parsed.begin() + key, parsed[key]) != parsed.begin() + key)
+		{
+			return false;
+		}
+	}
+
+	keymap = parsed;
+	return true;
+}
+
+RomLibrary::RomLibrary(const char* indexPath)
+	: mFile(indexPath)
+{
+	if (mFile.Size() < sizeof(RomIndexHeader))
+	{
+		return;
+	}
+
+	std::memcpy(&mHeader, mFile.Data(), sizeof(mHeader));
+
+	const RomIndexHeader expected;
+	const uint64_t size = sizeof(RomIndexHeader) + static_cast<uint64_t>(mHeader.entryCount) * sizeof(RomIndexEntry) + mHeader.stringsSize;
+	if (std::memcmp(mHeader.magic, expected.magic, sizeof(mHeader.magic)) != 0 || mHeader.version != expected.version
+		|| mHeader.entrySize != sizeof(RomIndexEntry) || mFile.Size() < size)
+	{
+		return;
+	}
+
+	// The header is a multiple of 8 bytes, so the entries are aligned in the mapping
+	mEntries = reinterpret_cast<const RomIndexEntry*>(mFile.Data() + sizeof(RomIndexHeader));
+	mStrings = reinterpret_cast<const char*>(mEntries + mHeader.entryCount);
+
+	for (uint32_t i = 0; i < mHeader.entryCount; ++i)
+	{
+		const RomIndexEntry& entry = mEntries[i];
+		if (static_cast<uint64_t>(entry.pathOffset) + entry.pathLength > mHeader.stringsSize || entry.cyclesPerSecond == 0
+			|| entry.quirkProfile >= static_cast<uint8_t>(QuirkProfile::Count) || (i > 0 && mEntries[i - 1].hash >= entry.hash))
+		{
+			return;
+		}
+	}
+
+	mIsValid = true;
+}
+
+const RomIndexEntry* RomLibrary::Find(uint64_t hash) const
+{
+	const RomIndexEntry* end = mEntries + GetCount();
+	const RomIndexEntry* entry = std::lower_bound(mEntries, end, hash, [](const RomIndexEntry& a, uint64_t b) { return a.hash < b; });
+	return entry != end && entry->hash == hash ? entry : nullptr;
+}
+
+RomSettings RomLibrary::GetSettings(const RomIndexEntry& entry)
+{
+	RomSettings settings;
+	settings.cyclesPerSecond = entry.cyclesPerSecond;
+	settings.quirks = static_cast<QuirkProfile>(entry.quirkProfile);
+	std::memcpy(settings.keymap.data(), entry.keymap, sizeof(entry.keymap));
+	return settings;
+}
+
+bool RomLibrary::Scan(const char* directory, const char* indexPath, size_t& romCount)
+{
+	// Settings have to be read out before the old index is replaced
+	std::unordered_map<uint64_t, RomSettings> knownSettings;
+	{
+		const RomLibrary previous(indexPath);
+		for (size_t i = 0; i < previous.GetCount(); ++i)
+		{
+			knownSettings.emplace(previous.GetEntry(i).hash, GetSettings(previous.GetEntry(i)));
+		}
+	}
+
+	struct ScannedRom
+	{
+		RomIndexEntry entry;
+		std::string path;
+	};
+	std::vector<ScannedRom> roms;
+
+	std::error_code error;
+	for (std::filesystem::recursive_directory_iterator it(directory, error), end; !error && it != end; it.increment(error))
+	{
+		if (!it->is_regular_file(error) || !IsRomFile(it->path()))
+		{
+			continue;
+		}
+
+		// Mapped so hashing a large collection doesn't copy every ROM through a read buffer
+		const std::string path = std::filesystem::absolute(it->path(), error).generic_string();
+		const MappedFile rom(path.c_str());
+		if (!rom.IsOpen() || rom.Size() > gMaxRomSize || path.size() > UINT16_MAX)
+		{
+			continue;
+		}
+
+		ScannedRom scanned;
+		scanned.entry.hash = HashBytes(rom.Data(), rom.Size());
+		scanned.entry.size = static_cast<uint32_t>(rom.Size());
+		scanned.path = path;
+		const auto known = knownSettings.find(scanned.entry.hash);
+		StoreSettings(scanned.entry, known != knownSettings.end() ? known->second : RomSettings());
+		roms.push_back(std::move(scanned));
+	}
+	if (error)
+	{
+		return false;
+	}
+
+	// Paths break ties so the same directory always gives the same index, whichever order the OS lists it in
+	std::sort(roms.begin(), roms.end(), [](const ScannedRom& a, const ScannedRom& b) {
+		return a.entry.hash != b.entry.hash ? a.entry.hash < b.entry.hash : a.path < b.path;
+	});
+	roms.erase(std::unique(roms.begin(), roms.end(), [](const ScannedRom& a, const ScannedRom& b) { return a.entry.hash == b.entry.hash; }), roms.end());
+
+	std::vector<RomIndexEntry> entries;
+	std::string strings;
+	entries.reserve(roms.size());
+	for (ScannedRom& rom : roms)
+	{
+		rom.entry.pathOffset = static_cast<uint32_t>(strings.size());
+		rom.entry.pathLength = static_cast<uint16_t>(rom.path.size());
+		strings += rom.path;
+		entries.push_back(rom.entry);
+	}
+
+	romCount = entries.size();
+	return WriteIndex(indexPath, entries, strings);
+}
+
+bool RomLibrary::SetSettings(const char* indexPath, uint64_t hash, const RomSettings& settings)
+{
+	std::vector<RomIndexEntry> entries;
+	std::string strings;
+	{
+		const RomLibrary library(indexPath);
+		const RomIndexEntry* entry = library.Find(hash);
+		if (entry == nullptr)
+		{
+			return false;
+		}
+
+		entries.assign(library.mEntries, library.mEntries + library.GetCount());
+		strings.assign(library.mStrings, library.mHeader.stringsSize);
+		StoreSettings(entries[entry - library.mEntries], settings);
+	}
+
+	return WriteIndex(indexPath, entries, strings);
+}
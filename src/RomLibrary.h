@@ -0,0 +1,80 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "Chip8.h"
+#include "MappedFile.h"
+
+// What the library remembers about a ROM, applied whenever it's loaded through the library
+struct RomSettings
+{
+	uint16_t cyclesPerSecond = 700;
+	QuirkProfile quirks = QuirkProfile::CosmacVip;
+	// Host key for each CHIP-8 key 0-F, as the lower-case character printed on it. The default is the usual QWERTY
+	// layout of the COSMAC VIP's 4x4 hex keypad.
+	std::array<char, 16> keymap = { 'x', '1', '2', '3', 'q', 'w', 'e', 'a', 's', 'd', 'z', 'c', '4', 'r', 'f', 'v' };
+};
+
+// Reads 16 distinct printable ASCII keys for CHIP-8 keys 0-F, folding upper case to lower case. False, leaving keymap
+// alone, if text isn't exactly that.
+bool ParseKeymap(const char* text, std::array<char, 16>& keymap);
+
+// Index files are this header, entryCount RomIndexEntries sorted by hash, then stringsSize bytes of ROM paths.
+// Built once by RomLibrary::Scan() so startup never has to touch the ROM directory, only map this file.
+struct RomIndexHeader
+{
+	char magic[4] = { 'C', '8', 'R', 'X' };
+	uint16_t version = 1;
+	uint16_t entrySize = 0;		// sizeof(RomIndexEntry), so a layout change can't be misread
+	uint32_t entryCount = 0;
+	uint32_t stringsSize = 0;
+};
+static_assert(sizeof(RomIndexHeader) == 16, "ROM index header layout is part of the file format");
+
+struct RomIndexEntry
+{
+	uint64_t hash = 0;			// HashBytes() of the ROM file, the key everything is looked up by
+	uint32_t size = 0;
+	uint32_t pathOffset = 0;	// Into the string table, paths aren't null-terminated
+	uint16_t pathLength = 0;
+	uint16_t cyclesPerSecond = 0;
+	uint8_t quirkProfile = 0;
+	uint8_t reserved[3] = {};
+	char keymap[16] = {};
+};
+static_assert(sizeof(RomIndexEntry) == 40, "ROM index entry layout is part of the file format");
+
+// A read-only view of an index file. Lookups are a binary search over the mapped entries, nothing is copied.
+class RomLibrary {
+public:
+	explicit RomLibrary(const char* indexPath);
+
+	// False if the file is missing, truncated or from another format version
+	inline bool IsValid() const { return mIsValid; }
+
+	inline size_t GetCount() const { return mIsValid ? mHeader.entryCount : 0; }
+	inline const RomIndexEntry& GetEntry(size_t index) const { return mEntries[index]; }
+	inline std::string_view GetPath(const RomIndexEntry& entry) const { return { mStrings + entry.pathOffset, entry.pathLength }; }
+
+	// nullptr if no indexed ROM has this HashBytes()
+	const RomIndexEntry* Find(uint64_t hash) const;
+
+	static RomSettings GetSettings(const RomIndexEntry& entry);
+
+	// Hashes every .ch8, .sc8 and .xo8 file under directory, recursively, into a new index at indexPath. ROMs the old
+	// index already knew keep their settings, identical ROMs are only indexed once. romCount is set to the number of
+	// ROMs indexed.
+	static bool Scan(const char* directory, const char* indexPath, size_t& romCount);
+	// Rewrites the index with new settings for one ROM, false if the index isn't valid or doesn't have it
+	static bool SetSettings(const char* indexPath, uint64_t hash, const RomSettings& settings);
+
+private:
+	MappedFile mFile;
+	RomIndexHeader mHeader;
+	const RomIndexEntry* mEntries = nullptr;
+	const char* mStrings = nullptr;
+	bool mIsValid = false;
+};
@@ -0,0 +1,139 @@
+#include "SaveState.h"
+
+#include <algorithm>
+#include <cstring>
+
+const MachineState* ValidateState(const uint8_t* data, size_t size)
+{
+	if (data == nullptr || size < sizeof(MachineState))
+	{
+		return nullptr;
+	}
+
+	const SaveStateHeader expected;
+	const SaveStateHeader& header = reinterpret_cast<const MachineState*>(data)->header;
+	if (std::memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0 || header.version != expected.version
+		|| header.headerSize != sizeof(SaveStateHeader) || header.stateSize != sizeof(MachineState))
+	{
+		return nullptr;
+	}
+
+	return reinterpret_cast<const MachineState*>(data);
+}
+
+bool WriteStateFile(const char* path, const MachineState& state)
+{
+	FILE* file = std::fopen(path, "wb");
+	if (file == nullptr)
+	{
+		return false;
+	}
+
+	const bool written = std::fwrite(&state, sizeof(state), 1, file) == 1;
+	return std::fclose(file) == 0 && written;
+}
+
+StateFile::StateFile(const char* path)
+	: mFile(path)
+{
+	// Mappings are page aligned, so the state can be used in place
+	mState = ValidateState(mFile.Data(), mFile.Size());
+}
+
+StatePackWriter::StatePackWriter(const char* path)
+{
+	mFile = std::fopen(path, "wb");
+	if (mFile == nullptr)
+	{
+		return;
+	}
+
+	// Rewritten with the count and index offset once everything is in
+	const StatePackHeader header;
+	std::fwrite(&header, sizeof(header), 1, mFile);
+	mOffset = sizeof(header);
+}
+
+StatePackWriter::~StatePackWriter()
+{
+	if (mFile == nullptr)
+	{
+		return;
+	}
+
+	std::stable_sort(mIndex.begin(), mIndex.end(), [](const StatePackEntry& a, const StatePackEntry& b) { return a.cycle < b.cycle; });
+	std::fwrite(mIndex.data(), sizeof(StatePackEntry), mIndex.size(), mFile);
+
+	StatePackHeader header;
+	header.entrySize = sizeof(StatePackEntry);
+	header.stateSize = sizeof(MachineState);
+	header.count = static_cast<uint32_t>(mIndex.size());
+	header.indexOffset = mOffset;
+	std::fseek(mFile, 0, SEEK_SET);
+	std::fwrite(&header, sizeof(header), 1, mFile);
+	std::fclose(mFile);
+}
+
+bool StatePackWriter::Add(const MachineState& state)
+{
+	if (mFile == nullptr || std::fwrite(&state, sizeof(state), 1, mFile) != 1)
+	{
+		return false;
+	}
+
+	StatePackEntry entry;
+	entry.cycle = state.cpu.cycleCount;
+	entry.frame = state.cpu.frameCount;
+	entry.offset = mOffset;
+	mIndex.push_back(entry);
+	mOffset += sizeof(state);
+	return true;
+}
+
+StatePackReader::StatePackReader(const char* path)
+	: mFile(path)
+{
+	if (mFile.Size() < sizeof(StatePackHeader))
+	{
+		return;
+	}
+
+	StatePackHeader header;
+	std::memcpy(&header, mFile.Data(), sizeof(header));
+
+	const StatePackHeader expected;
+	if (std::memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0 || header.version != expected.version
+		|| header.entrySize != sizeof(StatePackEntry) || header.stateSize != sizeof(MachineState)
+		|| header.indexOffset < sizeof(StatePackHeader) || header.indexOffset % 8 != 0
+		|| header.indexOffset > mFile.Size() || (mFile.Size() - header.indexOffset) / sizeof(StatePackEntry) < header.count)
+	{
+		return;
+	}
+
+	// Check every entry up front so Get() can stay a pointer offset
+	const StatePackEntry* index = reinterpret_cast<const StatePackEntry*>(mFile.Data() + header.indexOffset);
+	for (uint32_t i = 0; i < header.count; ++i)
+	{
+		const uint64_t offset = index[i].offset;
+		if (offset % 8 != 0 || offset > header.indexOffset || header.indexOffset - offset < sizeof(MachineState)
+			|| ValidateState(mFile.Data() + offset, sizeof(MachineState)) == nullptr)
+		{
+			return;
+		}
+	}
+
+	mIndex = index;
+	mCount = header.count;
+}
+
+const MachineState* StatePackReader::FindLatest(uint64_t cycle) const
+{
+	const StatePackEntry* end = mIndex + mCount;
+	const StatePackEntry* next = std::upper_bound(mIndex, end, cycle, [](uint64_t cycle, const StatePackEntry& entry) { return cycle < entry.cycle; });
+	if (next == mIndex)
+	{
+		return nullptr;
+	}
+
+	return Get(next - 1 - mIndex);
+}
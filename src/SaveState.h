@@ -0,0 +1,142 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <type_traits>
+#include <vector>
+
+#include "Chip8.h"
+#include "MappedFile.h"
+
+// Bumped whenever the layout of MachineState changes, files from other versions are rejected rather than misread
+constexpr uint16_t gSaveStateVersion = 3;
+
+struct SaveStateHeader
+{
+	char magic[4] = { 'C', '8', 'S', 'S' };
+	uint16_t version = gSaveStateVersion;
+	uint16_t headerSize = 16;
+	uint32_t stateSize = 0;		// sizeof(MachineState) of the build that wrote it
+	uint32_t reserved = 0;
+};
+static_assert(sizeof(SaveStateHeader) == 16, "Save state header layout is part of the file format");
+
+// Registers, timers, stack and the counters RunFrame() needs to carry on exactly where it left off
+struct CpuState
+{
+	std::array<uint8_t, 16> variableRegisters = {};
+	std::array<uint16_t, gStackDepth> addressStack = {};
+	uint16_t indexRegister = 0;
+	uint16_t programCounter = 0;
+	uint8_t delayTimer = 0;
+	uint8_t soundTimer = 0;
+	uint8_t stackSize = 0;
+	uint8_t quirkProfile = 0;		// QuirkProfile the ROM was loaded with
+	uint16_t keypad = 0;			// One bit per key
+	uint16_t cyclesPerSecond = 0;
+	uint32_t frameCycleRemainder = 0;
+	uint32_t romSize = 0;
+	uint8_t highResolution = 0;
+	uint8_t planeMask = 0;			// XO-CHIP planes selected by FN01
+	uint8_t pitch = 0;
+	uint8_t reserved1 = 0;
+	uint64_t cycleCount = 0;
+	uint64_t frameCount = 0;
+	std::array<uint8_t, 16> flagRegisters = {};
+	std::array<uint8_t, 16> audioPattern = {};
+	Random::State randomState = {};	// Where CXNN's generator is, so a restored run draws the same numbers
+};
+static_assert(sizeof(CpuState) == 152 && std::has_unique_object_representations_v<CpuState>, "CPU section layout is part of the file format");
+
+// Complete snapshot of a CHIP, a state file is exactly one of these. Fixed layout and no pointers, so restoring one
+// is a copy per section whether it comes from CHIP::SaveState() or straight out of a memory mapped file.
+struct MachineState
+{
+	SaveStateHeader header;
+	CpuState cpu;
+	std::array<uint8_t, gMemorySize> memory = {};
+	DisplayPlanes display = {};
+};
+static_assert(std::is_trivially_copyable_v<MachineState> && std::is_standard_layout_v<MachineState>, "Save states are copied as raw bytes");
+static_assert(sizeof(MachineState) % 8 == 0, "Packed states have to stay 8 byte aligned back to back");
+
+// Returns the state at data if it's a complete MachineState from this format version, nullptr otherwise
+const MachineState* ValidateState(const uint8_t* data, size_t size);
+
+bool WriteStateFile(const char* path, const MachineState& state);
+
+// Maps a single state file, the state is used in place without reading it in first
+class StateFile {
+public:
+	explicit StateFile(const char* path);
+
+	// nullptr if the file is missing or isn't a state from this format version
+	inline const MachineState* Get() const { return mState; }
+
+private:
+	MappedFile mFile;
+	const MachineState* mState = nullptr;
+};
+
+// Many states in one file: this header, the states back to back, then an index sorted by cycle
+struct StatePackHeader
+{
+	char magic[4] = { 'C', '8', 'S', 'P' };
+	uint16_t version = gSaveStateVersion;
+	uint16_t entrySize = 0;		// sizeof(StatePackEntry)
+	uint32_t stateSize = 0;		// sizeof(MachineState)
+	uint32_t count = 0;
+	uint64_t indexOffset = 0;	// 0 until the writer has finished, so an interrupted pack reads as invalid
+};
+static_assert(sizeof(StatePackHeader) == 24, "State pack header layout is part of the file format");
+
+struct StatePackEntry
+{
+	uint64_t cycle = 0;
+	uint64_t frame = 0;
+	uint64_t offset = 0;		// Of the state from the start of the file
+};
+static_assert(sizeof(StatePackEntry) == 24, "State pack index layout is part of the file format");
+
+// Appends states to a pack file as they come in, the index is written when the writer is destroyed
+class StatePackWriter {
+public:
+	explicit StatePackWriter(const char* path);
+	~StatePackWriter();
+
+	StatePackWriter(const StatePackWriter&) = delete;
+	StatePackWriter& operator=(const StatePackWriter&) = delete;
+
+	inline bool IsOpen() const { return mFile != nullptr; }
+	inline size_t GetCount() const { return mIndex.size(); }
+
+	bool Add(const MachineState& state);
+
+private:
+	FILE* mFile = nullptr;
+	std::vector<StatePackEntry> mIndex;
+	uint64_t mOffset = 0;
+};
+
+// Maps a pack file, Get() and FindLatest() hand out pointers into the mapping
+class StatePackReader {
+public:
+	explicit StatePackReader(const char* path);
+
+	// False if the file is missing, unfinished or from another format version
+	inline bool IsValid() const { return mIndex != nullptr; }
+	inline size_t GetCount() const { return mCount; }
+
+	inline const StatePackEntry& GetEntry(size_t index) const { return mIndex[index]; }
+	inline const MachineState* Get(size_t index) const { return reinterpret_cast<const MachineState*>(mFile.Data() + mIndex[index].offset); }
+
+	// Newest state taken at or before the given cycle, for warm-starting as close to it as possible.
+	// nullptr if every state in the pack is later than that.
+	const MachineState* FindLatest(uint64_t cycle) const;
+
+private:
+	MappedFile mFile;
+	const StatePackEntry* mIndex = nullptr;
+	size_t mCount = 0;
+};
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+// Lock-free FIFO of up to Capacity values from one producer thread to one consumer thread.
+// Each side only ever writes its own index, so pushing and popping never wait on each other.
+template<typename T, size_t Capacity>
+class SpscQueue {
+public:
+	static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity has to be a power of two");
+
+	// Producer side: returns false, dropping value, if the queue is full
+	inline bool Push(const T& value)
+	{
+		const uint64_t head = mHead.load(std::memory_order_relaxed);
+		if (head - mTail.load(std::memory_order_acquire) >= Capacity)
+		{
+			return false;
+		}
+
+		mSlots[head & (Capacity - 1)] = value;
+		mHead.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer side: returns false, leaving value alone, if the queue is empty
+	inline bool Pop(T& value)
+	{
+		const uint64_t tail = mTail.load(std::memory_order_relaxed);
+		if (tail == mHead.load(std::memory_order_acquire))
+		{
+			return false;
+		}
+
+		value = mSlots[tail & (Capacity - 1)];
+		mTail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+private:
+	std::array<T, Capacity> mSlots = {};
+	alignas(64) std::atomic<uint64_t> mHead = 0;	// Only the producer writes it
+	alignas(64) std::atomic<uint64_t> mTail = 0;	// Only the consumer writes it
+};
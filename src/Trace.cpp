@@ -0,0 +1,162 @@
+#include "Trace.h"
+
+#include <bit>
+#include <chrono>
+#include <cstring>
+
+namespace {
+
+	// Records the writer moves out of the ring per fwrite
+	constexpr size_t gWriteBatch = 4096;
+	// How long the writer sleeps when the ring is empty
+	constexpr auto gIdleSleep = std::chrono::milliseconds(1);
+}
+
+TraceRing::TraceRing(size_t capacity)
+{
+	const size_t size = std::bit_ceil(capacity < 2 ? size_t(2) : capacity);
+	mRecords.resize(size);
+	mMask = size - 1;
+}
+
+size_t TraceRing::Pop(TraceRecord* records, size_t maxCount)
+{
+	const uint64_t tail = mTail.load(std::memory_order_relaxed);
+	const uint64_t available = mHead.load(std::memory_order_acquire) - tail;
+	const size_t count = available < maxCount ? static_cast<size_t>(available) : maxCount;
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		records[i] = mRecords[(tail + i) & mMask];
+	}
+
+	mTail.store(tail + count, std::memory_order_release);
+	return count;
+}
+
+TraceWriter::TraceWriter(TraceRing& ring, const char* path)
+	: mRing(ring)
+	, mFile(std::fopen(path, "wb"))
+	, mBuffer(gWriteBatch)
+{
+	if (mFile != nullptr)
+	{
+		mThread = std::thread(&TraceWriter::Run, this);
+	}
+}
+
+TraceWriter::~TraceWriter()
+{
+	if (mFile == nullptr)
+	{
+		return;
+	}
+
+	mStopping.store(true, std::memory_order_release);
+	mThread.join();
+
+	// An empty trace still gets a header so readers can tell it apart from a broken file
+	if (!mHeaderWritten)
+	{
+		const TraceFileHeader header;
+		std::fwrite(&header, sizeof(header), 1, mFile);
+	}
+	std::fclose(mFile);
+}
+
+void TraceWriter::Run()
+{
+	while (!mStopping.load(std::memory_order_acquire))
+	{
+		if (Drain() == 0)
+		{
+			std::this_thread::sleep_for(gIdleSleep);
+		}
+	}
+
+	// The producer has stopped by now, take whatever it left behind
+	while (Drain() > 0)
+	{
+	}
+}
+
+size_t TraceWriter::Drain()
+{
+	const size_t count = mRing.Pop(mBuffer.data(), mBuffer.size());
+	Write(mBuffer.data(), count);
+	return count;
+}
+
+void TraceWriter::Write(const TraceRecord* records, size_t count)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	if (!mHeaderWritten)
+	{
+		TraceFileHeader header;
+		header.firstCycle = records[0].cycle;
+		std::fwrite(&header, sizeof(header), 1, mFile);
+		mHeaderWritten = true;
+		mNextCycle = header.firstCycle;
+	}
+
+	size_t start = 0;
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (records[i].cycle == mNextCycle)
+		{
+			++mNextCycle;
+			continue;
+		}
+
+		// The ring dropped records before this one, pad the gap so record N stays at cycle firstCycle + N
+		std::fwrite(records + start, sizeof(TraceRecord), i - start, mFile);
+		start = i;
+
+		TraceRecord missing;
+		missing.reg = gTraceMissing;
+		for (; mNextCycle < records[i].cycle; ++mNextCycle)
+		{
+			missing.cycle = mNextCycle;
+			std::fwrite(&missing, sizeof(missing), 1, mFile);
+		}
+		++mNextCycle;
+	}
+	std::fwrite(records + start, sizeof(TraceRecord), count - start, mFile);
+}
+
+TraceReader::TraceReader(const char* path)
+	: mFile(path)
+{
+	if (mFile.Size() < sizeof(TraceFileHeader))
+	{
+		return;
+	}
+
+	TraceFileHeader header;
+	std::memcpy(&header, mFile.Data(), sizeof(header));
+
+	const TraceFileHeader expected;
+	if (std::memcmp(header.magic, expected.magic, sizeof(header.magic)) != 0 || header.version != expected.version || header.recordSize != sizeof(TraceRecord))
+	{
+		return;
+	}
+
+	// The header keeps the records 8 byte aligned in the mapping, and a partly written last record is ignored
+	mRecords = reinterpret_cast<const TraceRecord*>(mFile.Data() + sizeof(TraceFileHeader));
+	mRecordCount = (mFile.Size() - sizeof(TraceFileHeader)) / sizeof(TraceRecord);
+	mFirstCycle = header.firstCycle;
+}
+
+const TraceRecord* TraceReader::Seek(uint64_t cycle) const
+{
+	if (mRecords == nullptr || cycle < mFirstCycle || cycle - mFirstCycle >= mRecordCount)
+	{
+		return nullptr;
+	}
+
+	return mRecords + (cycle - mFirstCycle);
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+#include "MappedFile.h"
+
+// Set through the CHIP8_ENABLE_TRACE CMake option. When it's 0 the core has no trace hooks at all, the ring, writer
+// and reader below are still available for tools.
+#ifndef CHIP8_TRACE
+#define CHIP8_TRACE 0
+#endif
+
+// TraceRecord::reg when the instruction left every variable register unchanged
+constexpr uint8_t gTraceNoRegister = 0xFF;
+// TraceRecord::reg for filler records standing in for ones the ring had to drop, keeps the file indexable by cycle
+constexpr uint8_t gTraceMissing = 0xFE;
+
+// One executed instruction, as stored in the ring and in trace files
+struct TraceRecord
+{
+	uint64_t cycle = 0;			// Value of CHIP::GetCycleCount() before the instruction ran
+	uint16_t pc = 0;			// Address the instruction was fetched from
+	uint16_t instruction = 0;
+	uint16_t index = 0;			// Index register after the instruction
+	uint8_t reg = gTraceNoRegister;	// Lowest variable register the instruction changed
+	uint8_t value = 0;			// New value of that register
+};
+static_assert(sizeof(TraceRecord) == 16, "Trace files are read as a flat array of 16 byte records");
+
+// Trace files are this header followed by one record per cycle from firstCycle onwards, so any cycle's record
+// is at a fixed offset
+struct TraceFileHeader
+{
+	char magic[4] = { 'C', '8', 'T', 'R' };
+	uint16_t version = 1;
+	uint16_t recordSize = sizeof(TraceRecord);
+	uint64_t firstCycle = 0;
+};
+static_assert(sizeof(TraceFileHeader) == 16, "Trace file header layout is part of the file format");
+
+// Single producer, single consumer ring of trace records. The emulation thread pushes and never blocks:
+// when the consumer falls behind, records are dropped and counted instead.
+class TraceRing {
+public:
+	// Capacity is rounded up to a power of two
+	explicit TraceRing(size_t capacity);
+
+	inline void Push(const TraceRecord& record)
+	{
+		const uint64_t head = mHead.load(std::memory_order_relaxed);
+		if (head - mTail.load(std::memory_order_acquire) > mMask)
+		{
+			mDropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+
+		mRecords[head & mMask] = record;
+		mHead.store(head + 1, std::memory_order_release);
+	}
+
+	// Copies up to maxCount of the oldest records into records, returns how many it copied
+	size_t Pop(TraceRecord* records, size_t maxCount);
+
+	inline uint64_t GetDropped() const { return mDropped.load(std::memory_order_relaxed); }
+
+private:
+	std::vector<TraceRecord> mRecords;
+	size_t mMask = 0;
+
+	// Each index lives on its own cache line so the producer and consumer don't keep stealing it from each other
+	alignas(64) std::atomic<uint64_t> mHead = 0;	// Next slot to write, only the producer stores it
+	alignas(64) std::atomic<uint64_t> mTail = 0;	// Next slot to read, only the consumer stores it
+	alignas(64) std::atomic<uint64_t> mDropped = 0;
+};
+
+// Drains a TraceRing into a trace file on its own thread until destroyed
+class TraceWriter {
+public:
+	TraceWriter(TraceRing& ring, const char* path);
+	~TraceWriter();
+
+	TraceWriter(const TraceWriter&) = delete;
+	TraceWriter& operator=(const TraceWriter&) = delete;
+
+	inline bool IsOpen() const { return mFile != nullptr; }
+
+private:
+	void Run();
+	// Returns the number of records taken from the ring
+	size_t Drain();
+	void Write(const TraceRecord* records, size_t count);
+
+	TraceRing& mRing;
+	FILE* mFile = nullptr;
+	std::thread mThread;
+	std::atomic<bool> mStopping = false;
+
+	std::vector<TraceRecord> mBuffer;
+	bool mHeaderWritten = false;
+	uint64_t mNextCycle = 0;
+};
+
+// Maps a trace file for offline analysis, Seek() is a bounds check and a pointer offset
+class TraceReader {
+public:
+	explicit TraceReader(const char* path);
+
+	// False if the file is missing or its header doesn't match this build's format
+	inline bool IsValid() const { return mRecords != nullptr; }
+
+	inline uint64_t GetFirstCycle() const { return mFirstCycle; }
+	inline uint64_t GetRecordCount() const { return mRecordCount; }
+
+	// Record for the given cycle, nullptr if the trace doesn't cover it.
+	// Check reg against gTraceMissing, records the ring dropped are kept as placeholders.
+	const TraceRecord* Seek(uint64_t cycle) const;
+
+private:
+	MappedFile mFile;
+	const TraceRecord* mRecords = nullptr;
+	uint64_t mFirstCycle = 0;
+	uint64_t mRecordCount = 0;
+};
@@ -0,0 +1,98 @@
+#include "Trace.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+// Prints a range of a trace file written by chip8-headless --trace, jumping straight to the requested cycle
+
+namespace {
+
+	constexpr uint64_t gDefaultCount = 32;
+
+	void PrintUsage()
+	{
+		std::fprintf(stderr,
+			"usage: chip8-trace <trace> [--cycle N] [--count N]\n"
+			"  --cycle  first cycle to print (default the start of the trace)\n"
+			"  --count  number of records to print (default %llu)\n",
+			static_cast<unsigned long long>(gDefaultCount));
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const char* path = nullptr;
+	uint64_t cycle = 0;
+	bool hasCycle = false;
+	uint64_t count = gDefaultCount;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const bool hasValue = i + 1 < argc;
+		if (std::strcmp(argv[i], "--cycle") == 0 && hasValue)
+		{
+			cycle = std::strtoull(argv[++i], nullptr, 10);
+			hasCycle = true;
+		}
+		else if (std::strcmp(argv[i], "--count") == 0 && hasValue)
+		{
+			count = std::strtoull(argv[++i], nullptr, 10);
+		}
+		else if (argv[i][0] != '-' && path == nullptr)
+		{
+			path = argv[i];
+		}
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	if (path == nullptr)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	const TraceReader trace(path);
+	if (!trace.IsValid())
+	{
+		std::fprintf(stderr, "chip8-trace: %s is not a trace file\n", path);
+		return 1;
+	}
+
+	std::printf("cycles %llu to %llu\n",
+		static_cast<unsigned long long>(trace.GetFirstCycle()),
+		static_cast<unsigned long long>(trace.GetFirstCycle() + trace.GetRecordCount()));
+
+	if (!hasCycle)
+	{
+		cycle = trace.GetFirstCycle();
+	}
+
+	for (uint64_t i = 0; i < count; ++i)
+	{
+		const TraceRecord* record = trace.Seek(cycle + i);
+		if (record == nullptr)
+		{
+			break;
+		}
+
+		if (record->reg == gTraceMissing)
+		{
+			std::printf("%10llu  (dropped)\n", static_cast<unsigned long long>(record->cycle));
+			continue;
+		}
+
+		std::printf("%10llu  %03X  %04X  I=%03X", static_cast<unsigned long long>(record->cycle), record->pc, record->instruction, record->index);
+		if (record->reg != gTraceNoRegister)
+		{
+			std::printf("  V%X=%02X", record->reg, record->value);
+		}
+		std::printf("\n");
+	}
+
+	return 0;
+}
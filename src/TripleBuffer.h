@@ -0,0 +1,51 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Lock-free handoff of the newest value from one producer thread to one consumer thread.
+// Of the three slots the producer fills one, the consumer reads another, and the third holds the latest published
+// value. Publishing and acquiring each swap their own slot with that one in a single atomic exchange, so neither side
+// ever waits on the other and the consumer always gets the newest value, skipping any it was too slow to see.
+template<typename T>
+class TripleBuffer {
+public:
+	// Producer side: the slot to fill in before Publish()
+	inline T& GetBack() { return mSlots[mBack]; }
+
+	// Producer side: makes the back slot the newest value and takes over the one it replaces. Returns false if the
+	// consumer never saw that one, its contents are then what GetBack() holds until it's overwritten.
+	inline bool Publish()
+	{
+		const uint8_t replaced = mMiddle.exchange(mBack | gFresh, std::memory_order_acq_rel);
+		mBack = replaced & gIndexMask;
+		return (replaced & gFresh) == 0;
+	}
+
+	// Consumer side: swaps the newest value in as the front slot. Returns false, keeping the current front, if nothing
+	// has been published since the last call.
+	inline bool Acquire()
+	{
+		if ((mMiddle.load(std::memory_order_relaxed) & gFresh) == 0)
+		{
+			return false;
+		}
+
+		mFront = mMiddle.exchange(mFront, std::memory_order_acq_rel) & gIndexMask;
+		return true;
+	}
+
+	// Consumer side: the value from the last successful Acquire()
+	inline const T& GetFront() const { return mSlots[mFront]; }
+
+private:
+	// The middle index carries this bit from a Publish() until the consumer takes it
+	static constexpr uint8_t gFresh = 4;
+	static constexpr uint8_t gIndexMask = 3;
+
+	std::array<T, 3> mSlots = {};
+	uint8_t mBack = 0;		// Only the producer touches it
+	alignas(64) std::atomic<uint8_t> mMiddle = 1;
+	alignas(64) uint8_t mFront = 2;	// Only the consumer touches it
+};
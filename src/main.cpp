@@ -1,84 +1,473 @@
+#include "AudioDevice.h"
 #include "Chip8.h"
 #include "Display.h"
+#include "FrameScheduler.h"
+#include "Hash.h"
+#include "Movie.h"
+#include "RomLibrary.h"
+#include "SpscQueue.h"
+#include "TripleBuffer.h"
 #include <SDL3/SDL.h>
 
-static bool gDone;
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// Everything the render thread tells the emulation thread goes through these atomics
+static std::atomic<bool> gDone;
+// Held down to run the emulator as fast as the host allows
+static std::atomic<bool> gTurbo;
+// Held down to run the emulator backwards
+static std::atomic<bool> gRewind;
+// CHIP-8 keys held down, one bit per key. Only read by the emulation thread to resync after gKeyEvents overflowed.
+static std::atomic<uint16_t> gKeypad;
+static std::atomic<bool> gKeyEventsDropped;
+
+// A CHIP-8 key going down or up, stamped with SDL's event time (SDL_GetTicksNS() clock)
+struct KeyInput
+{
+	uint64_t timestamp = 0;
+	uint8_t key = 0;
+	bool pressed = false;
+};
+// Every key change in the order it happened, for the emulation thread to place on the emulated timeline
+static SpscQueue<KeyInput, 64> gKeyEvents;
+// How far back holding Backspace can go
+constexpr uint32_t gRewindSeconds = 10;
+// Run when no ROM is given on the command line
+constexpr const char* gDefaultRomPath = "roms/6-keypad.ch8";
 // CHIP-8 has a 2:1 aspect ratio
 const int WINDOW_WIDTH = 1920;
 const int WINDOW_HEIGHT = WINDOW_WIDTH / 2;
 
-constexpr std::array<uint8_t, 16> gKeymap = {
-	SDLK_X,
-	SDLK_1,
-	SDLK_2,
-	SDLK_3,
-	SDLK_Q,
-	SDLK_W,
-	SDLK_E,
-	SDLK_A,
-	SDLK_S,
-	SDLK_D,
-	SDLK_Z,
-	SDLK_C,
-	SDLK_4,
-	SDLK_R,
-	SDLK_F,
-	SDLK_V,
+// CHIP-8 key for each host keycode below 128, -1 if it isn't mapped. Filled from the ROM's library settings, SDL's
+// keycodes for letters and digits are the lower-case characters themselves.
+static std::array<int8_t, 128> gKeymap;
+
+void PrintUsage()
+{
+	std::fprintf(stderr,
+		"usage: CHIP8 [ROM] [--library INDEX] [--record FILE] [--capture FILE] [--phosphor FRAMES] [--scale N] [--palette COLOURS]\n"
+		"  ROM        program to run (default %s)\n"
+		"  --library  chip8-library index to take the ROM's speed, quirks and keymap from\n"
+		"  --record   save the session as a movie for chip8-headless --replay\n"
+		"  --capture  record the display to FILE for review, export it with chip8-capture\n"
+		"  --phosphor frames a pixel takes to fade out after it goes off, 0 for none (default %u)\n"
+		"  --scale    upscale the display by N on the CPU before it's uploaded, 1 to %u (default 1)\n"
+		"  --palette  off,on,second plane,both planes as RRGGBB, e.g. 000000,ffffff,ff6600,662200\n",
+		gDefaultRomPath, PhosphorSettings().persistence, gMaxPhosphorScale);
+}
+
+// What the emulation thread hands the render thread after each frame
+struct PresentedFrame
+{
+	DisplayPlanes planes = {};
+	uint8_t width = DISPLAY_WIDTH;
+	uint8_t height = DISPLAY_HEIGHT;
+	uint64_t dirtyRows = 0;		// Every row changed since the last frame the render thread actually took
+	uint64_t inputTimestamp = 0;	// Earliest KeyInput applied since then, 0 if none
 };
 
-void HandleInput(const SDL_Event& e, bool* keys)
+// Time from a key event to the first frame presented after it was applied
+struct InputLatency
 {
-	// Exit app on pressing ESC
-	if (e.type == SDL_EVENT_QUIT || (e.type == SDL_EVENT_KEY_UP && e.key.key == SDLK_ESCAPE))
+	uint64_t count = 0;
+	uint64_t totalNs = 0;
+	uint64_t maxNs = 0;
+
+	void Add(uint64_t ns)
+	{
+		++count;
+		totalNs += ns;
+		maxNs = std::max(maxNs, ns);
+	}
+};
+
+#ifdef DEBUG
+// DrawDebug() reads the CHIP and drives its pause, step and rewind controls from the render thread, so debug builds
+// only emulate a frame while the debug window isn't being built. Release builds have no DrawDebug() and no lock.
+static std::mutex gDebugMutex;
+#endif
+
+void HandleInput(const SDL_Event& e)
+{
+	if (e.type == SDL_EVENT_QUIT)
 	{
 		gDone = true;
+		return;
 	}
 
-	// process input if its in our designated keymap
-	for (int i = 0; i < gKeymap.size(); ++i)
+	// Everything past here is about keys
+	if (e.type != SDL_EVENT_KEY_DOWN && e.type != SDL_EVENT_KEY_UP)
 	{
-		const bool isKeyDown = e.type == SDL_EVENT_KEY_DOWN ? 1 : 0;
-		if (e.key.key == gKeymap[i])
+		return;
+	}
+
+	const bool pressed = e.type == SDL_EVENT_KEY_DOWN;
+	switch (e.key.key)
+	{
+	// Exit app on pressing ESC
+	case SDLK_ESCAPE:
+		if (!pressed)
 		{
-			keys[i] = isKeyDown;
+			gDone = true;
 		}
+		return;
+	case SDLK_TAB:
+		gTurbo = pressed;
+		return;
+	case SDLK_BACKSPACE:
+		gRewind = pressed;
+		return;
+	default:
+		break;
+	}
+
+	// process input if its in our designated keymap. Held keys repeat, but that's no change to the keypad.
+	const int8_t key = e.key.key < gKeymap.size() ? gKeymap[e.key.key] : -1;
+	if (key < 0 || e.key.repeat)
+	{
+		return;
+	}
+
+	const uint16_t bit = static_cast<uint16_t>(1 << key);
+	if (pressed)
+	{
+		gKeypad.fetch_or(bit, std::memory_order_relaxed);
+	}
+	else
+	{
+		gKeypad.fetch_and(static_cast<uint16_t>(~bit), std::memory_order_relaxed);
+	}
+
+	if (!gKeyEvents.Push({ e.key.timestamp, static_cast<uint8_t>(key), pressed }))
+	{
+		gKeyEventsDropped = true;
 	}
 }
 
-int main()
+// Queues the key changes since the last frame on the CHIP, each at the cycle matching its offset into the frame it
+// happened in: a fixed frame behind, rather than all of them landing on the next frame's first instruction.
+// Returns the earliest timestamp queued, 0 if there were none.
+uint64_t QueueKeyEvents(CHIP& emu, MovieRecorder* recorder, uint64_t previousFrameStart)
 {
-	Display* display = new Display();
+	// Some changes never made it into the queue, so what's left in it is stale and the mask is the truth
+	if (gKeyEventsDropped.exchange(false))
+	{
+		KeyInput dropped;
+		while (gKeyEvents.Pop(dropped))
+		{
+		}
+		emu.SetKeypad(gKeypad.load(std::memory_order_relaxed));
+		return 0;
+	}
+
+	uint64_t earliest = 0;
+	KeyInput input;
+	while (gKeyEvents.Pop(input))
+	{
+		const uint64_t offset = input.timestamp > previousFrameStart ? input.timestamp - previousFrameStart : 0;
+		const uint64_t cycle = emu.GetCycleCount() + offset * emu.GetCyclesPerSecond() / 1'000'000'000;
+		if (recorder)
+		{
+			recorder->QueueKeyEvent(cycle, input.key, input.pressed);
+		}
+		else
+		{
+			emu.QueueKeyEvent(cycle, input.key, input.pressed);
+		}
+		earliest = earliest == 0 ? input.timestamp : std::min(earliest, input.timestamp);
+	}
+	return earliest;
+}
+
+// Runs the emulator on its own thread, paced by its own scheduler, so vsync or a driver stall in the present never
+// costs emulation time. Finished frames go to the render thread through frames, only the newest one gets drawn.
+void RunEmulation(CHIP& emu, MovieRecorder* recorder, TripleBuffer<PresentedFrame>& frames)
+{
+	FrameScheduler scheduler(gFrameRate);
+	// Rows of published frames the render thread skipped over, they still have to be uploaded with the next one
+	uint64_t skippedRows = 0;
+	// Earliest input not yet part of a frame the render thread took
+	uint64_t inputTimestamp = 0;
+	uint64_t frameStart = SDL_GetTicksNS();
+
+	while (!gDone.load(std::memory_order_relaxed))
+	{
+		scheduler.SetTurbo(gTurbo.load(std::memory_order_relaxed));
+		const uint64_t previousFrameStart = frameStart;
+		frameStart = SDL_GetTicksNS();
+		bool published = false;
+		{
+#ifdef DEBUG
+			const std::lock_guard<std::mutex> lock(gDebugMutex);
+#endif
+			emu.SetRewinding(gRewind.load(std::memory_order_relaxed));
+
+			// Frames spent paused never ran, so they aren't part of the movie either
+			const bool recordFrame = recorder && !emu.IsPaused();
+			if (recordFrame)
+			{
+				recorder->BeginFrame();
+			}
+			if (const uint64_t queued = QueueKeyEvents(emu, recordFrame ? recorder : nullptr, previousFrameStart))
+			{
+				inputTimestamp = inputTimestamp == 0 ? queued : std::min(inputTimestamp, queued);
+			}
+			emu.RunFrame();
+			if (recordFrame)
+			{
+				recorder->EndFrame();
+			}
+
+			// In turbo only as often as the display could show them, the dirty rows keep piling up in the CHIP meanwhile
+			if (scheduler.ShouldRender())
+			{
+				PresentedFrame& frame = frames.GetBack();
+				frame.dirtyRows = emu.TakeDirtyRows() | skippedRows;
+				frame.inputTimestamp = inputTimestamp;
+				if (frame.dirtyRows != 0)
+				{
+					std::copy_n(emu.GetDisplayPlane(0), frame.planes[0].size(), frame.planes[0].begin());
+					std::copy_n(emu.GetDisplayPlane(1), frame.planes[1].size(), frame.planes[1].begin());
+					frame.width = emu.GetDisplayWidth();
+					frame.height = emu.GetDisplayHeight();
+					published = true;
+				}
+			}
+		}
+
+		if (published)
+		{
+			const bool seen = frames.Publish();
+			skippedRows = seen ? 0 : frames.GetBack().dirtyRows;
+			inputTimestamp = seen ? 0 : frames.GetBack().inputTimestamp;
+		}
+		scheduler.WaitForNextFrame();
+	}
+}
+
+int main(int argc, char** argv)
+{
+	const char* romPath = gDefaultRomPath;
+	const char* libraryPath = nullptr;
+	const char* moviePath = nullptr;
+	const char* capturePath = nullptr;
+	PhosphorSettings phosphor;
+	bool hasRomPath = false;
+	for (int i = 1; i < argc; ++i)
+	{
+		const bool hasValue = i + 1 < argc;
+		if (std::strcmp(argv[i], "--library") == 0 && hasValue)
+		{
+			libraryPath = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--record") == 0 && hasValue)
+		{
+			moviePath = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--capture") == 0 && hasValue)
+		{
+			capturePath = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "--phosphor") == 0 && hasValue)
+		{
+			phosphor.persistence = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+		}
+		else if (std::strcmp(argv[i], "--scale") == 0 && hasValue)
+		{
+			phosphor.scale = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+			if (phosphor.scale < 1 || phosphor.scale > gMaxPhosphorScale)
+			{
+				PrintUsage();
+				return 1;
+			}
+		}
+		else if (std::strcmp(argv[i], "--palette") == 0 && hasValue)
+		{
+			if (!ParsePalette(argv[++i], phosphor.palette))
+			{
+				PrintUsage();
+				return 1;
+			}
+		}
+		else if (argv[i][0] != '-' && !hasRomPath)
+		{
+			romPath = argv[i];
+			hasRomPath = true;
+		}
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	// The ROM is mapped once, both to look it up in the library and to load it
+	const MappedFile rom(romPath);
+	RomSettings settings;
+	if (libraryPath != nullptr)
+	{
+		const RomLibrary library(libraryPath);
+		if (!library.IsValid())
+		{
+			std::fprintf(stderr, "CHIP8: %s isn't a ROM index from this version\n", libraryPath);
+			return 1;
+		}
+		if (const RomIndexEntry* entry = rom.IsOpen() ? library.Find(HashBytes(rom.Data(), rom.Size())) : nullptr)
+		{
+			settings = RomLibrary::GetSettings(*entry);
+		}
+	}
+	gKeymap.fill(-1);
+	for (int8_t key = 0; key < static_cast<int8_t>(settings.keymap.size()); ++key)
+	{
+		// Only ASCII keys can be looked up, anything else an older index holds leaves that CHIP-8 key unmapped
+		const uint8_t hostKey = static_cast<uint8_t>(settings.keymap[key]);
+		if (hostKey < gKeymap.size())
+		{
+			gKeymap[hostKey] = key;
+		}
+	}
+
 	CHIP* emu = new CHIP();
+	if (!rom.IsOpen() || !emu->LoadROM(rom.Data(), rom.Size(), settings.cyclesPerSecond, settings.quirks))
+	{
+		std::fprintf(stderr, "CHIP8: can't load %s\n", romPath);
+		delete emu;
+		return 1;
+	}
 
+	Display* display = new Display();
 	display->Startup(WINDOW_WIDTH, WINDOW_HEIGHT, emu->GetDisplayWidth(), emu->GetDisplayHeight());
+	display->SetPhosphor(phosphor);
+
+	// A frame of samples is pushed at a time, on top of which the ring holds at most gAudioLatencyMilliseconds
+	AudioRing audioRing(gAudioFrameSamples + gAudioSampleRate * gAudioLatencyMilliseconds / 1000);
+	AudioDevice audio;
+	const bool hasAudio = audio.Startup(audioRing);
+	if (hasAudio)
+	{
+		emu->SetAudioOutput(&audioRing);
+	}
+	else
+	{
+		std::fprintf(stderr, "CHIP8: no audio device, running silent (%s)\n", SDL_GetError());
+	}
+
+	// Rewinding would rewrite history the movie has already recorded, so it's only available when not recording
+	std::unique_ptr<MovieRecorder> recorder;
+	if (moviePath != nullptr)
+	{
+		recorder = std::make_unique<MovieRecorder>(*emu, romPath, true);
+	}
+	else
+	{
+		emu->EnableRewind(gRewindSeconds);
+	}
 
-	// hardcoded path and speed for testing
-	emu->LoadROM("roms\\6-keypad.ch8", 700);
+	// Encoded on its own thread, frames it can't keep up with are dropped rather than holding up the emulation thread
+	std::unique_ptr<CaptureWriter> capture;
+	if (capturePath != nullptr)
+	{
+		capture = std::make_unique<CaptureWriter>(capturePath);
+		if (!capture->IsOpen())
+		{
+			std::fprintf(stderr, "CHIP8: can't write %s\n", capturePath);
+			capture.reset();
+		}
+		emu->SetCapture(capture.get());
+	}
+
+#if CHIP8_PROFILE
+	// Shown next to the ROM Viewer in debug builds
+	Profiler profiler;
+	emu->SetProfiler(&profiler);
+#endif
 
 	gDone = false;
-	uint64_t lastCounter = SDL_GetPerformanceCounter();
-	const double frequency = static_cast<double>(SDL_GetPerformanceFrequency());
-	
+	gTurbo = false;
+	gRewind = false;
+	gKeypad = 0;
+	gKeyEventsDropped = false;
+
+	// From here on the emulation thread owns the CHIP, apart from DrawDebug() under gDebugMutex
+	TripleBuffer<PresentedFrame> frames;
+	std::thread emulation(RunEmulation, std::ref(*emu), recorder.get(), std::ref(frames));
+
+	// The render thread is the main one, SDL wants events and rendering there. One iteration per 60 Hz frame: take
+	// every pending event, present the newest emulated frame, then wait for events until the next one so each is
+	// handed to the emulation thread as it arrives rather than a frame later.
+	FrameScheduler scheduler(gFrameRate);
+	InputLatency latency;
 	while (!gDone)
 	{
-		const uint64_t newCounter = SDL_GetPerformanceCounter();
-		const double deltaTime = (newCounter - lastCounter) / frequency;
-		lastCounter = newCounter;
-
 		SDL_Event e;
-		if (SDL_PollEvent(&e))
+		while (SDL_PollEvent(&e))
 		{
 			display->Update(&e);
-			HandleInput(e, emu->GetKeypad());
+			HandleInput(e);
 		}
 
-		emu->Update(deltaTime);
-
+		const bool hasNewFrame = frames.Acquire();
+		const PresentedFrame& frame = frames.GetFront();
 		display->RenderBegin();
 #ifdef DEBUG
-		emu->DrawDebug();
+		{
+			const std::lock_guard<std::mutex> lock(gDebugMutex);
+			emu->DrawDebug();
+		}
 #endif
-		display->RenderEnd(emu->GetDisplay(), emu->GetDisplayWidth());
+		display->RenderEnd(frame.planes[0].data(), frame.planes[1].data(), frame.width, frame.height, hasNewFrame ? frame.dirtyRows : 0);
+		if (hasNewFrame && frame.inputTimestamp != 0)
+		{
+			latency.Add(SDL_GetTicksNS() - frame.inputTimestamp);
+		}
+
+		// Whole milliseconds in SDL's wait, WaitForNextFrame() sleeps off the rest
+		for (int64_t wait; !gDone && (wait = std::chrono::duration_cast<std::chrono::milliseconds>(scheduler.GetTimeUntilNextFrame()).count()) > 0;)
+		{
+			if (SDL_WaitEventTimeout(&e, static_cast<int32_t>(wait)))
+			{
+				display->Update(&e);
+				HandleInput(e);
+			}
+		}
+		scheduler.WaitForNextFrame();
+	}
+
+	emulation.join();
+
+	if (recorder && !recorder->Save(moviePath))
+	{
+		std::fprintf(stderr, "CHIP8: can't write %s\n", moviePath);
+	}
+
+	emu->SetAudioOutput(nullptr);
+	audio.Shutdown();
+	if (hasAudio)
+	{
+		std::printf("audio: %llu underruns, %llu overruns\n", static_cast<unsigned long long>(audioRing.GetUnderruns()),
+			static_cast<unsigned long long>(audioRing.GetOverruns()));
+	}
+
+	if (capture)
+	{
+		emu->SetCapture(nullptr);
+		std::printf("capture: %llu frames dropped\n", static_cast<unsigned long long>(capture->GetDropped()));
+		capture.reset();
+	}
+
+	if (latency.count > 0)
+	{
+		std::printf("input latency: %llu key events, %.1f ms average, %.1f ms worst\n", static_cast<unsigned long long>(latency.count),
+			latency.totalNs / 1e6 / latency.count, latency.maxNs / 1e6);
 	}
 
 	display->Shutdown();